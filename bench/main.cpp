@@ -0,0 +1,294 @@
+// bench generates a synthetic style file and times loading it.
+//
+//   bench [--palettes N] [--tiles N] [--sprites N] [--deltas N] [--cars N]
+//         [--seed N] [--iterations N] [--threads 1,2,4] [--files N]
+//         [--keep file.sty] [-o results.json]
+//
+// Results are written as JSON. Every configuration is timed with a cold
+// file cache (where the platform lets us drop it) and a warm one, stage
+// times come from the trace instrumentation.
+
+#include "synthetic_style.h"
+#include "hash.h"
+#include "json.h"
+#include "style_loader.h"
+#include "styles.h"
+#include "thread_pool.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+struct BenchArgs {
+  SyntheticStyleParams params;
+  uint32_t iterations = 10;
+  std::vector<size_t> threads = {1, 2, 4, 8};
+  uint32_t files = 4;
+  std::string keep;
+  std::string output;
+};
+
+static bool parse_threads(const char* list, std::vector<size_t>& threads) {
+  threads.clear();
+  for (const char* p = list; *p;) {
+    char* end;
+    unsigned long n = strtoul(p, &end, 10);
+    if (end == p || n == 0) return false;
+    threads.push_back(size_t(n));
+    p = *end == ',' ? end + 1 : end;
+  }
+  return !threads.empty();
+}
+
+static bool parse_args(int argc, char** argv, BenchArgs& args) {
+  for (int i = 1; i < argc; ++i) {
+    auto number = [&](auto& out) {
+      if (i + 1 >= argc) return false;
+      out = static_cast<std::remove_reference_t<decltype(out)>>(strtoull(argv[++i], nullptr, 10));
+      return true;
+    };
+
+    bool ok = true;
+    if (strcmp(argv[i], "--palettes") == 0) ok = number(args.params.palettes);
+    else if (strcmp(argv[i], "--tiles") == 0) ok = number(args.params.tiles);
+    else if (strcmp(argv[i], "--sprites") == 0) ok = number(args.params.sprites);
+    else if (strcmp(argv[i], "--deltas") == 0) ok = number(args.params.deltas);
+    else if (strcmp(argv[i], "--cars") == 0) ok = number(args.params.cars);
+    else if (strcmp(argv[i], "--seed") == 0) ok = number(args.params.seed);
+    else if (strcmp(argv[i], "--iterations") == 0) ok = number(args.iterations);
+    else if (strcmp(argv[i], "--files") == 0) ok = number(args.files);
+    else if (strcmp(argv[i], "--threads") == 0) ok = i + 1 < argc && parse_threads(argv[++i], args.threads);
+    else if (strcmp(argv[i], "--keep") == 0 && i + 1 < argc) args.keep = argv[++i];
+    else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) args.output = argv[++i];
+    else ok = false;
+
+    if (!ok) {
+      fprintf(stderr, "bench: bad argument %s\n", argv[i]);
+      return false;
+    }
+  }
+
+  args.iterations = std::max(args.iterations, 1u);
+  args.files = std::max(args.files, 1u);
+  return true;
+}
+
+// drop_file_cache evicts path from the OS file cache, returns false if the
+// platform doesn't support it.
+static bool drop_file_cache(const char* path) {
+#if defined(__linux__)
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+  fdatasync(fd);
+  bool ok = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+  close(fd);
+  return ok;
+#else
+  (void)path;
+  return false;
+#endif
+}
+
+static double elapsed_ms(std::chrono::steady_clock::time_point begin) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+struct Result {
+  std::string name;
+  bool cold = false;
+  size_t threads = 1;
+  std::vector<double> times;        // ms per iteration
+  std::map<std::string, double> stages; // mean ms per iteration, summed over threads
+  bool ok = true;
+};
+
+// run times fn for every iteration, then runs it as many times again with
+// tracing on to break the time down by stage.
+template <typename F>
+static Result run(const char* name, bool cold, size_t threads, const BenchArgs& args, const std::vector<std::string>& paths, F&& fn) {
+  Result result = {.name = name, .cold = cold, .threads = threads};
+
+  auto prepare = [&] {
+    if (cold) {
+      for (auto& path : paths) drop_file_cache(path.c_str());
+    }
+  };
+
+  // Warm runs start from a populated cache.
+  if (!cold) {
+    result.ok &= fn();
+  }
+
+  for (uint32_t i = 0; i < args.iterations; ++i) {
+    prepare();
+    auto begin = std::chrono::steady_clock::now();
+    result.ok &= fn();
+    result.times.push_back(elapsed_ms(begin));
+  }
+
+  // Dropping the cache isn't instrumented, it doesn't show up in the trace.
+  trace_start();
+  for (uint32_t i = 0; i < args.iterations; ++i) {
+    prepare();
+    result.ok &= fn();
+  }
+  trace_stop();
+
+  for (auto& event : trace_events()) {
+    if (event.counter) continue;
+    std::string stage = event.name;
+    if (event.detail[0]) {
+      stage += ":";
+      stage += event.detail;
+    }
+    result.stages[stage] += double(event.end - event.begin) / 1e6 / args.iterations;
+  }
+
+  return result;
+}
+
+static void write_result(JsonWriter& json, Result& result) {
+  auto times = result.times;
+  std::sort(times.begin(), times.end());
+
+  double sum = 0.0;
+  for (auto t : times) sum += t;
+
+  json.begin_object();
+  json.field("name", result.name);
+  json.field("cache", result.cold ? "cold" : "warm");
+  json.field("threads", uint64_t(result.threads));
+  json.field("ok", result.ok);
+  json.field("iterations", uint64_t(times.size()));
+  json.field("min_ms", times.front());
+  json.field("median_ms", times[times.size() / 2]);
+  json.field("mean_ms", sum / double(times.size()));
+  json.field("max_ms", times.back());
+
+  json.key("stages_ms");
+  json.begin_object();
+  for (auto& [stage, ms] : result.stages) {
+    json.field(stage.c_str(), ms);
+  }
+  json.end_object();
+
+  json.end_object();
+}
+
+int main(int argc, char** argv) {
+  BenchArgs args;
+  if (!parse_args(argc, argv, args)) {
+    return 1;
+  }
+
+  auto data = generate_style(args.params);
+
+  // One copy per file so concurrent loads don't read the same file.
+  auto dir = std::filesystem::temp_directory_path();
+  std::vector<std::string> paths;
+  for (uint32_t i = 0; i < args.files; ++i) {
+    auto path = i == 0 && !args.keep.empty() ? std::filesystem::path(args.keep) : dir / ("fta2_bench_" + std::to_string(args.params.seed) + "_" + std::to_string(i) + ".sty");
+    FILE* f = fopen(path.string().c_str(), "wb");
+    if (!f || fwrite(data.data(), data.size(), 1, f) != 1) {
+      fprintf(stderr, "bench: can't write %s\n", path.string().c_str());
+      if (f) fclose(f);
+      return 1;
+    }
+    fclose(f);
+    paths.push_back(path.string());
+  }
+
+  const bool cold_supported = drop_file_cache(paths[0].c_str());
+
+  std::vector<Result> results;
+
+  for (bool cold : {true, false}) {
+    if (cold && !cold_supported) continue;
+
+    results.push_back(run("load", cold, 1, args, paths, [&] {
+      Styles styles;
+      return styles.load(paths[0].c_str(), StyleLoadOptions{}) == StyleLoadStatus::Ok;
+    }));
+
+    for (size_t threads : args.threads) {
+      ThreadPool pool(threads);
+
+      results.push_back(run("load_trim_masks_mipmaps", cold, threads, args, paths, [&] {
+        StyleLoadOptions options;
+        options.import.trim = true;
+        options.import.collision_masks = true;
+        options.import.mipmaps = true;
+        options.pool = &pool;
+
+        Styles styles;
+        return styles.load(paths[0].c_str(), options) == StyleLoadStatus::Ok;
+      }));
+
+      results.push_back(run("load_styles", cold, threads, args, paths, [&] {
+        bool ok = true;
+        for (auto& result : load_styles(paths, pool)) {
+          ok &= result.status == StyleLoadStatus::Ok;
+        }
+        return ok;
+      }));
+    }
+  }
+
+  JsonWriter json;
+  json.begin_object();
+
+  json.key("params");
+  json.begin_object();
+  json.field("palettes", args.params.palettes);
+  json.field("tiles", args.params.tiles);
+  json.field("sprites", args.params.sprites);
+  json.field("deltas", args.params.deltas);
+  json.field("cars", args.params.cars);
+  json.field("seed", uint64_t(args.params.seed));
+  json.field("iterations", args.iterations);
+  json.field("files", args.files);
+  json.end_object();
+
+  json.field("file_bytes", uint64_t(data.size()));
+  json.field("file_hash", hash64(data.data(), data.size()));
+  json.field("cold_cache_supported", cold_supported);
+
+  json.key("results");
+  json.begin_array();
+  for (auto& result : results) {
+    write_result(json, result);
+  }
+  json.end_array();
+
+  json.end_object();
+
+  for (size_t i = args.keep.empty() ? 0 : 1; i < paths.size(); ++i) {
+    std::error_code ec;
+    std::filesystem::remove(paths[i], ec);
+  }
+
+  if (args.output.empty()) {
+    printf("%s\n", json.str().c_str());
+    return 0;
+  }
+
+  FILE* f = fopen(args.output.c_str(), "wb");
+  if (!f) {
+    fprintf(stderr, "bench: can't write %s\n", args.output.c_str());
+    return 1;
+  }
+  fwrite(json.str().data(), json.str().size(), 1, f);
+  fclose(f);
+  return 0;
+}
@@ -0,0 +1,222 @@
+#include "synthetic_style.h"
+#include "styles.h"
+#include <string.h>
+#include <algorithm>
+
+constexpr size_t kPalettesPerPage = 64;
+constexpr size_t kTilesPerPage = 64;
+constexpr uint32_t kSpritePageDim = 256;
+constexpr uint32_t kMaxSpriteDim = 64;
+
+// SplitMix64, the standard library distributions are not the same
+// across implementations.
+struct Random {
+  uint64_t state;
+
+  uint64_t next() {
+    uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+  }
+
+  // range returns a value in [lo, hi].
+  uint32_t range(uint32_t lo, uint32_t hi) {
+    return lo + uint32_t(next() % (uint64_t(hi) - lo + 1));
+  }
+
+  // index returns a palette index, zero (transparent) with probability
+  // about 1 / zero_odds.
+  uint8_t index(uint32_t zero_odds) {
+    uint64_t r = next();
+    return r % zero_odds == 0 ? 0 : uint8_t(1 + (r >> 32) % 255);
+  }
+};
+
+static ChunkType chunk_type(const char* name) {
+  ChunkType type;
+  memcpy(type.name, name, sizeof(type.name));
+  return type;
+}
+
+static void generate_palettes(StyleSource& s, Random& rng, uint32_t count) {
+  s.palettes.resize((count + kPalettesPerPage - 1) / kPalettesPerPage * kPalettesPerPage);
+  for (auto& palette : s.palettes) {
+    for (auto& c : palette.colors) {
+      uint64_t r = rng.next();
+      c = Color{uint8_t(r), uint8_t(r >> 8), uint8_t(r >> 16), 0xff};
+    }
+  }
+}
+
+static void generate_tiles(StyleSource& s, Random& rng, uint32_t count) {
+  s.tiles.resize((count + kTilesPerPage - 1) / kTilesPerPage * kTilesPerPage);
+  for (auto& tile : s.tiles) {
+    // Roughly one tile in four has transparent pixels.
+    uint32_t zero_odds = rng.range(0, 3) == 0 ? 4 : 1u << 30;
+    for (auto& index : tile.colors) {
+      index = rng.index(zero_odds);
+    }
+  }
+}
+
+static void generate_sprites(StyleSource& s, Random& rng, uint32_t count) {
+  // Shelf packing into 256x256 pages.
+  uint32_t x = 0, y = 0, shelf = 0;
+  s.sprites.resize(count);
+
+  for (auto& sprite : s.sprites) {
+    uint32_t w = rng.range(8, kMaxSpriteDim);
+    uint32_t h = rng.range(8, kMaxSpriteDim);
+
+    if (x + w > kSpritePageDim) {
+      x = 0;
+      y += shelf;
+      shelf = 0;
+    }
+    if ((y % kSpritePageDim) + h > kSpritePageDim) {
+      y = (y / kSpritePageDim + 1) * kSpritePageDim;
+    }
+
+    sprite = GTASprite{.offset = x + y * kSpritePageDim, .width = uint8_t(w), .height = uint8_t(h)};
+    x += w;
+    shelf = std::max(shelf, h);
+  }
+
+  uint32_t pages = (y + shelf + kSpritePageDim - 1) / kSpritePageDim;
+  s.sprite_store.assign(size_t(std::max(pages, 1u)) * kSpritePageDim * kSpritePageDim, 0);
+
+  for (auto& sprite : s.sprites) {
+    // Transparent margins so that trimming has something to do.
+    uint32_t margin_x = rng.range(0, sprite.width / 4);
+    uint32_t margin_y = rng.range(0, sprite.height / 4);
+
+    for (uint32_t py = margin_y; py < sprite.height - margin_y; ++py) {
+      for (uint32_t px = margin_x; px < sprite.width - margin_x; ++px) {
+        s.sprite_store[sprite.offset + px + py * kSpritePageDim] = rng.index(8);
+      }
+    }
+  }
+}
+
+static void generate_deltas(StyleSource& s, Random& rng, uint32_t count) {
+  if (s.sprites.empty()) return;
+
+  while (count > 0) {
+    DeltaSet set;
+    set.sprite = uint16_t(rng.range(0, uint32_t(std::min<size_t>(s.sprites.size(), 0xffff)) - 1));
+    auto& sprite = s.sprites[set.sprite];
+
+    uint32_t deltas = std::min(count, rng.range(1, 4));
+    for (uint32_t d = 0; d < deltas; ++d) {
+      size_t start = s.delta_store.size();
+      uint32_t position = 0;
+
+      // Runs on increasing rows, positions are relative to the end of the
+      // previous run in 256 pixel rows.
+      uint32_t row = 0;
+      uint32_t runs = rng.range(1, 6);
+      for (uint32_t r = 0; r < runs && row < sprite.height; ++r) {
+        row = rng.range(row, sprite.height - 1);
+        uint32_t length = rng.range(1, std::min(sprite.width, uint8_t(32)));
+        uint32_t x = rng.range(0, sprite.width - length);
+        uint32_t target = x + row * kSpritePageDim;
+
+        uint16_t offset = uint16_t(target - position);
+        uint8_t len = uint8_t(length);
+        s.delta_store.insert(s.delta_store.end(), {uint8_t(offset), uint8_t(offset >> 8), len});
+        for (uint32_t i = 0; i < length; ++i) {
+          s.delta_store.push_back(rng.index(16));
+        }
+
+        position = target + length;
+        ++row;
+      }
+
+      set.sizes.push_back(uint16_t(s.delta_store.size() - start));
+    }
+
+    count -= deltas;
+    s.deltas.push_back(std::move(set));
+  }
+}
+
+static void generate_cars(StyleSource& s, Random& rng, uint32_t count, uint32_t car_sprites) {
+  s.cars.resize(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    auto& car = s.cars[i];
+    car.model = uint8_t(i);
+    car.sprite = uint8_t(car_sprites ? i % car_sprites : 0);
+    car.width = uint8_t(rng.range(16, 40));
+    car.height = uint8_t(rng.range(32, 64));
+    car.passengers = uint8_t(rng.range(1, 4));
+    car.wreck = uint8_t(rng.range(0, 8));
+    car.rating = uint8_t(rng.range(1, 15));
+    car.front_wheel_offset = int8_t(rng.range(5, 20));
+    car.rear_wheel_offset = int8_t(-int(rng.range(5, 20)));
+    car.front_window_offset = int8_t(rng.range(0, 10));
+    car.rear_window_offset = int8_t(-int(rng.range(0, 10)));
+    car.info_flags = uint8_t(rng.next());
+    car.info_flags2 = uint8_t(rng.next() & 0x3);
+
+    car.remap.resize(rng.range(0, 6));
+    for (auto& remap : car.remap) remap = uint8_t(rng.range(0, 20));
+    car.num_remaps = uint8_t(car.remap.size());
+
+    car.doors.resize(rng.range(0, 2));
+    for (auto& door : car.doors) door = Door{int8_t(rng.range(0, 12)), int8_t(rng.range(0, 20))};
+    car.num_doors = uint8_t(car.doors.size());
+  }
+}
+
+std::vector<uint8_t> generate_style(const SyntheticStyleParams& params) {
+  Random rng = {params.seed};
+  StyleSource s;
+  s.version = 700;
+
+  generate_palettes(s, rng, std::max(params.palettes, 1u));
+  generate_tiles(s, rng, params.tiles);
+
+  // Tiles and sprites share the 16384 entry virtual palette table.
+  generate_sprites(s, rng, std::min(params.sprites, uint32_t(kVirtualPaletteTableSize - std::min(s.tiles.size(), kVirtualPaletteTableSize))));
+  generate_deltas(s, rng, params.deltas);
+
+  // Sprites are split evenly between the kinds, fonts get the rest.
+  uint16_t per_kind = uint16_t(s.sprites.size() / 6);
+  uint16_t offset = 0;
+  for (auto base : {&s.sprite_bases.car, &s.sprite_bases.ped, &s.sprite_bases.code, &s.sprite_bases.map, &s.sprite_bases.user}) {
+    *base = SpriteBase{offset, per_kind};
+    offset += per_kind;
+  }
+  s.sprite_bases.font = SpriteBase{offset, uint16_t(s.sprites.size() - offset)};
+  s.font_bases = {FontBase{0, uint16_t(s.sprite_bases.font.count / 2)}, FontBase{uint16_t(s.sprite_bases.font.count / 2), uint16_t(s.sprite_bases.font.count - s.sprite_bases.font.count / 2)}};
+
+  generate_cars(s, rng, params.cars, s.sprite_bases.car.count);
+
+  // Every tile and sprite gets its own virtual palette.
+  size_t virtual_palettes = std::min(s.tiles.size() + s.sprites.size(), kVirtualPaletteTableSize);
+  for (size_t i = 0; i < virtual_palettes; ++i) {
+    s.vtable.map[i] = uint16_t(rng.range(0, uint32_t(s.palettes.size()) - 1));
+  }
+  s.palette_bases.tile = PaletteBase{0, uint16_t(s.tiles.size())};
+  s.palette_bases.sprite = PaletteBase{uint16_t(s.tiles.size()), uint16_t(virtual_palettes - s.tiles.size())};
+
+  for (uint32_t i = 0; i < 40; ++i) {
+    s.map_objects.push_back(MapObject{uint8_t(i), uint8_t(rng.range(1, 3))});
+  }
+  for (uint32_t i = 0; i < std::min(params.cars, 10u); ++i) {
+    s.recyclable_cars.push_back(CarModelNumber(i));
+  }
+  s.surfaces.resize(SurfaceType_Count);
+  for (auto& surface : s.surfaces) {
+    for (uint32_t i = 0; i < 8 && !s.tiles.empty(); ++i) {
+      surface.push_back(uint16_t(rng.range(1, uint32_t(s.tiles.size()) - 1)));
+    }
+  }
+
+  for (auto name : {"PALX", "PPAL", "PALB", "TILE", "SPRG", "SPRX", "SPRB", "DELS", "DELX", "FONB", "CARI", "OBJI", "RECY", "SPEC"}) {
+    s.chunks.push_back({.type = chunk_type(name), .offset = 0, .size = 0, .hash = 0});
+  }
+
+  return encode_styles(s);
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+// SyntheticStyleParams sizes a generated style file. Counts that the
+// format stores in whole pages (palettes, tiles) are rounded up.
+struct SyntheticStyleParams {
+  uint32_t palettes = 256;
+  uint32_t tiles = 992;
+  uint32_t sprites = 2500;
+  uint32_t deltas = 600;
+  uint32_t cars = 80;
+  uint64_t seed = 1;
+};
+
+// generate_style builds a format-valid style file with random contents.
+// The same params produce the same bytes on every platform.
+std::vector<uint8_t> generate_style(const SyntheticStyleParams& params);
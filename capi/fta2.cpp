@@ -0,0 +1,201 @@
+#include "fta2.h"
+#include "styles.h"
+#include <new>
+
+// fta2_style is never written after open, which is what makes concurrent
+// readers safe.
+struct fta2_style {
+  Styles styles;
+};
+
+static_assert(int(SpriteKind::Count) == FTA2_SPRITE_NONE);
+
+static fta2_status to_status(StyleLoadStatus status) {
+  switch (status) {
+    case StyleLoadStatus::Ok: return FTA2_OK;
+    case StyleLoadStatus::FileNotFound: return FTA2_FILE_NOT_FOUND;
+    case StyleLoadStatus::ReadError: return FTA2_READ_ERROR;
+    case StyleLoadStatus::InvalidFormat: return FTA2_INVALID_FORMAT;
+    case StyleLoadStatus::Cancelled: break;
+  }
+  return FTA2_INVALID_FORMAT;
+}
+
+static StyleLoadOptions load_options(uint32_t flags) {
+  StyleLoadOptions options;
+  options.import.trim = (flags & FTA2_TRIM) != 0;
+  options.import.transparent_tiles = (flags & FTA2_TRANSPARENT_TILES) != 0;
+  options.import.premultiplied_alpha = (flags & FTA2_PREMULTIPLIED_ALPHA) != 0;
+  options.import.mipmaps = (flags & FTA2_MIPMAPS) != 0;
+  return options;
+}
+
+// open_style loads a style with load(styles), no C++ exception leaves the API.
+template <typename F>
+static fta2_status open_style(fta2_style** style, F&& load) {
+  if (!style) {
+    return FTA2_INVALID_ARGUMENT;
+  }
+  *style = nullptr;
+
+  try {
+    auto result = new fta2_style;
+    auto status = to_status(load(result->styles));
+    if (status != FTA2_OK) {
+      delete result;
+      return status;
+    }
+    *style = result;
+    return FTA2_OK;
+  } catch (const std::bad_alloc&) {
+    return FTA2_OUT_OF_MEMORY;
+  }
+}
+
+uint32_t fta2_api_version(void) {
+  return FTA2_API_VERSION;
+}
+
+const char* fta2_status_string(fta2_status status) {
+  switch (status) {
+    case FTA2_OK: return "ok";
+    case FTA2_FILE_NOT_FOUND: return "file not found";
+    case FTA2_READ_ERROR: return "read error";
+    case FTA2_INVALID_FORMAT: return "invalid format";
+    case FTA2_INVALID_ARGUMENT: return "invalid argument";
+    case FTA2_OUT_OF_MEMORY: return "out of memory";
+  }
+  return "unknown";
+}
+
+fta2_status fta2_open_file(const char* path, uint32_t flags, fta2_style** style) {
+  if (!path) {
+    return FTA2_INVALID_ARGUMENT;
+  }
+  return open_style(style, [&](Styles& styles) {
+    return styles.load(path, load_options(flags));
+  });
+}
+
+fta2_status fta2_open_memory(const void* data, size_t size, uint32_t flags, fta2_style** style) {
+  if (!data && size > 0) {
+    return FTA2_INVALID_ARGUMENT;
+  }
+  return open_style(style, [&](Styles& styles) {
+    return styles.load_from_memory(static_cast<const uint8_t*>(data), size, load_options(flags));
+  });
+}
+
+void fta2_close(fta2_style* style) {
+  delete style;
+}
+
+size_t fta2_count(const fta2_style* style, fta2_image_kind kind) {
+  if (!style) {
+    return 0;
+  }
+
+  auto& styles = style->styles;
+  switch (kind) {
+    case FTA2_SPRITES: return styles.sprites.size();
+    case FTA2_TILES: return styles.tiles.size();
+    case FTA2_DELTAS: return styles.deltas.size();
+    case FTA2_PALETTES: return styles.source.palettes.size();
+  }
+  return 0;
+}
+
+fta2_status fta2_get_image(const fta2_style* style, fta2_image_kind kind, size_t index, uint32_t level, fta2_image* image) {
+  if (!style || !image || index >= fta2_count(style, kind)) {
+    return FTA2_INVALID_ARGUMENT;
+  }
+
+  auto& styles = style->styles;
+  const Sprite* sprite = nullptr;
+  switch (kind) {
+    case FTA2_SPRITES: sprite = &styles.sprite(index, level); break;
+    case FTA2_TILES: sprite = &styles.tile(index, level); break;
+    case FTA2_DELTAS: sprite = &styles.deltas[index]; break;
+    case FTA2_PALETTES: return FTA2_INVALID_ARGUMENT;
+  }
+
+  image->pixels = reinterpret_cast<const uint8_t*>(sprite->pixels.data());
+  image->width = sprite->width;
+  image->height = sprite->height;
+  image->stride = sprite->width * uint32_t(sizeof(Color));
+  image->x = sprite->x;
+  image->y = sprite->y;
+  return FTA2_OK;
+}
+
+fta2_status fta2_get_sprite_info(const fta2_style* style, size_t index, fta2_sprite_info* info) {
+  if (!style || !info || index >= style->styles.source.sprites.size()) {
+    return FTA2_INVALID_ARGUMENT;
+  }
+
+  auto& styles = style->styles;
+  auto& src = styles.source.sprites[index];
+
+  SpriteRef ref;
+  if (styles.sprite_catalog.find(index, ref)) {
+    info->kind = fta2_sprite_kind(ref.kind);
+    info->kind_index = ref.index;
+  } else {
+    info->kind = FTA2_SPRITE_NONE;
+    info->kind_index = 0;
+  }
+  info->page_offset = src.offset;
+  info->width = src.width;
+  info->height = src.height;
+  return FTA2_OK;
+}
+
+fta2_status fta2_get_sprite_range(const fta2_style* style, fta2_sprite_kind kind, uint32_t* first, uint32_t* count) {
+  if (!style || !first || !count || unsigned(kind) >= unsigned(SpriteKind::Count)) {
+    return FTA2_INVALID_ARGUMENT;
+  }
+
+  auto& range = style->styles.sprite_catalog[SpriteKind(kind)];
+  *first = range.first;
+  *count = range.count;
+  return FTA2_OK;
+}
+
+fta2_status fta2_get_map_object(const fta2_style* style, uint8_t model, uint32_t* first, uint32_t* count) {
+  if (!style || !first || !count) {
+    return FTA2_INVALID_ARGUMENT;
+  }
+
+  auto& range = style->styles.map_objects[model];
+  *first = range.first;
+  *count = range.count;
+  return FTA2_OK;
+}
+
+fta2_status fta2_get_delta_sprite(const fta2_style* style, size_t index, uint32_t* sprite) {
+  if (!style || !sprite || index >= style->styles.delta_sprites.size()) {
+    return FTA2_INVALID_ARGUMENT;
+  }
+
+  *sprite = style->styles.delta_sprites[index];
+  return FTA2_OK;
+}
+
+fta2_status fta2_get_palette(const fta2_style* style, size_t index, const uint8_t** colors) {
+  if (!style || !colors || index >= style->styles.source.palettes.size()) {
+    return FTA2_INVALID_ARGUMENT;
+  }
+
+  *colors = reinterpret_cast<const uint8_t*>(style->styles.source.palettes[index].colors);
+  return FTA2_OK;
+}
+
+fta2_status fta2_get_virtual_palettes(const fta2_style* style, const uint16_t** table, size_t* count) {
+  if (!style || !table || !count) {
+    return FTA2_INVALID_ARGUMENT;
+  }
+
+  *table = style->styles.source.vtable.map;
+  *count = kVirtualPaletteTableSize;
+  return FTA2_OK;
+}
@@ -0,0 +1,129 @@
+#ifndef FTA2_H
+#define FTA2_H
+
+/*
+ * C API of the fta2 style decoder.
+ *
+ * A style is opened once and is then read-only: every query on an open
+ * style may run concurrently on any number of threads. fta2_close must not
+ * race with other calls on the same style. Pointers returned by queries
+ * point into the style and stay valid until it is closed, nothing is
+ * copied.
+ *
+ * Structs are only ever extended at the end and enum values are never
+ * renumbered, FTA2_API_VERSION is bumped when either happens.
+ *
+ * Link against the static library with FTA2_STATIC defined.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(FTA2_STATIC)
+#define FTA2_API
+#elif defined(_WIN32)
+#ifdef FTA2_BUILD_DLL
+#define FTA2_API __declspec(dllexport)
+#else
+#define FTA2_API __declspec(dllimport)
+#endif
+#else
+#define FTA2_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FTA2_API_VERSION 1
+
+typedef struct fta2_style fta2_style;
+
+typedef enum fta2_status {
+  FTA2_OK = 0,
+  FTA2_FILE_NOT_FOUND = 1,
+  FTA2_READ_ERROR = 2,
+  FTA2_INVALID_FORMAT = 3,
+  FTA2_INVALID_ARGUMENT = 4, /* null pointer or index out of range */
+  FTA2_OUT_OF_MEMORY = 5,
+} fta2_status;
+
+/* Flags of fta2_open_file and fta2_open_memory. */
+enum {
+  FTA2_TRIM = 1 << 0,                /* crop sprites to their opaque pixels */
+  FTA2_TRANSPARENT_TILES = 1 << 1,   /* palette index 0 is transparent in tiles */
+  FTA2_PREMULTIPLIED_ALPHA = 1 << 2,
+  FTA2_MIPMAPS = 1 << 3,             /* build mip levels of sprites and tiles */
+};
+
+typedef enum fta2_image_kind {
+  FTA2_SPRITES = 0,
+  FTA2_TILES = 1,
+  FTA2_DELTAS = 2,
+  FTA2_PALETTES = 3, /* fta2_count only */
+} fta2_image_kind;
+
+/* Sprite bases, in SPRB order. */
+typedef enum fta2_sprite_kind {
+  FTA2_SPRITE_CAR = 0,
+  FTA2_SPRITE_PED = 1,
+  FTA2_SPRITE_CODE = 2, /* code object */
+  FTA2_SPRITE_MAP = 3,  /* map object */
+  FTA2_SPRITE_USER = 4,
+  FTA2_SPRITE_FONT = 5,
+  FTA2_SPRITE_NONE = 6, /* sprite outside of every base */
+} fta2_sprite_kind;
+
+/* fta2_image is a view of RGBA pixels, 4 bytes per pixel. */
+typedef struct fta2_image {
+  const uint8_t* pixels;
+  uint32_t width;
+  uint32_t height;
+  uint32_t stride; /* bytes per row */
+  uint32_t x;      /* position within the untrimmed sprite */
+  uint32_t y;
+} fta2_image;
+
+typedef struct fta2_sprite_info {
+  fta2_sprite_kind kind;
+  uint32_t kind_index;   /* index within the sprites of kind */
+  uint32_t page_offset;  /* SPRG offset of the untrimmed sprite */
+  uint32_t width;        /* untrimmed size */
+  uint32_t height;
+} fta2_sprite_info;
+
+FTA2_API uint32_t fta2_api_version(void);
+FTA2_API const char* fta2_status_string(fta2_status status);
+
+FTA2_API fta2_status fta2_open_file(const char* path, uint32_t flags, fta2_style** style);
+FTA2_API fta2_status fta2_open_memory(const void* data, size_t size, uint32_t flags, fta2_style** style);
+FTA2_API void fta2_close(fta2_style* style);
+
+FTA2_API size_t fta2_count(const fta2_style* style, fta2_image_kind kind);
+
+/* fta2_get_image returns a sprite, tile or delta. level selects a mip
+ * level when the style was opened with FTA2_MIPMAPS, levels past the end of
+ * the chain return the smallest one. */
+FTA2_API fta2_status fta2_get_image(const fta2_style* style, fta2_image_kind kind, size_t index, uint32_t level, fta2_image* image);
+
+FTA2_API fta2_status fta2_get_sprite_info(const fta2_style* style, size_t index, fta2_sprite_info* info);
+FTA2_API fta2_status fta2_get_sprite_range(const fta2_style* style, fta2_sprite_kind kind, uint32_t* first, uint32_t* count);
+
+/* fta2_get_map_object returns the sprites of a map object model, count is
+ * 0 for models the style doesn't have. */
+FTA2_API fta2_status fta2_get_map_object(const fta2_style* style, uint8_t model, uint32_t* first, uint32_t* count);
+
+/* fta2_get_delta_sprite returns the sprite a delta applies to. */
+FTA2_API fta2_status fta2_get_delta_sprite(const fta2_style* style, size_t index, uint32_t* sprite);
+
+/* fta2_get_palette returns the 256 RGBA colors of a physical palette. */
+FTA2_API fta2_status fta2_get_palette(const fta2_style* style, size_t index, const uint8_t** colors);
+
+/* fta2_get_virtual_palettes returns the 16384 entry virtual palette table. */
+FTA2_API fta2_status fta2_get_virtual_palettes(const fta2_style* style, const uint16_t** table, size_t* count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FTA2_H */
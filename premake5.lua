@@ -29,3 +29,72 @@ project "fta2"
   editandcontinue "Off"
   staticruntime "On"
   flags { "NoIncrementalLink", "NoPCH" }
+
+project "sty"
+  location "project/"
+  kind "ConsoleApp"
+  targetdir "project/bin/%{cfg.platform}/%{cfg.buildcfg}"
+  files {"src/**.h", "src/**.cpp", "tools/sty/**.cpp"}
+  removefiles {"src/main.cpp"}
+  includedirs { "src" }
+  staticruntime "On"
+  flags { "NoPCH" }
+
+project "bench"
+  location "project/"
+  kind "ConsoleApp"
+  targetdir "project/bin/%{cfg.platform}/%{cfg.buildcfg}"
+  files {"src/**.h", "src/**.cpp", "bench/**.h", "bench/**.cpp"}
+  removefiles {"src/main.cpp"}
+  includedirs { "src", "bench" }
+  staticruntime "On"
+  flags { "NoPCH" }
+
+-- The C API, see capi/fta2.h.
+project "libfta2"
+  location "project/"
+  kind "SharedLib"
+  targetname "fta2"
+  targetdir "project/bin/%{cfg.platform}/%{cfg.buildcfg}"
+  files {"src/**.h", "src/**.cpp", "capi/**.h", "capi/**.cpp"}
+  removefiles {"src/main.cpp"}
+  includedirs { "src", "capi" }
+  defines { "FTA2_BUILD_DLL" }
+  visibility "Hidden"
+  staticruntime "On"
+  flags { "NoPCH" }
+
+project "libfta2_static"
+  location "project/"
+  kind "StaticLib"
+  targetname "fta2_static"
+  targetdir "project/bin/%{cfg.platform}/%{cfg.buildcfg}"
+  files {"src/**.h", "src/**.cpp", "capi/**.h", "capi/**.cpp"}
+  removefiles {"src/main.cpp"}
+  includedirs { "src", "capi" }
+  defines { "FTA2_STATIC" }
+  staticruntime "On"
+  flags { "NoPCH" }
+
+-- The asset server uses epoll and Unix domain sockets.
+if os.istarget("linux") then
+  project "styd"
+    location "project/"
+    kind "ConsoleApp"
+    targetdir "project/bin/%{cfg.platform}/%{cfg.buildcfg}"
+    files {"src/**.h", "src/**.cpp", "tools/styd/**.h", "tools/styd/**.cpp"}
+    removefiles {"src/main.cpp"}
+    includedirs { "src", "tools/styd" }
+    links { "pthread" }
+    flags { "NoPCH" }
+end
+
+project "tests"
+  location "project/"
+  kind "ConsoleApp"
+  targetdir "project/bin/%{cfg.platform}/%{cfg.buildcfg}"
+  files {"src/**.h", "src/**.cpp", "bench/synthetic_style.h", "bench/synthetic_style.cpp", "tests/**.cpp"}
+  removefiles {"src/main.cpp"}
+  includedirs { "src", "bench" }
+  staticruntime "On"
+  flags { "NoPCH" }
@@ -0,0 +1,409 @@
+// fta2 Python module, style files as zero-copy buffers.
+//
+//   import fta2, numpy as np
+//   styles = fta2.load("data/wil.sty", trim=True)
+//   palettes = np.asarray(styles.palettes)     # (palettes, 256, 4) uint8
+//   sprite = np.asarray(styles.sprite(12))     # (height, width, 4) uint8
+//
+// Every array is a read-only view into the loaded styles, which stay alive
+// as long as any view does. Nothing depends on NumPy, the views implement
+// the buffer protocol so memoryview and other array libraries work too.
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "styles.h"
+#include <string.h>
+
+constexpr size_t kSpritePageSize = 256;
+
+// View is a read-only strided buffer into a Styles object.
+struct View {
+  PyObject_HEAD
+  PyObject* owner;
+  const void* data;
+  const char* format;
+  Py_ssize_t itemsize;
+  int ndim;
+  Py_ssize_t shape[3];
+  Py_ssize_t strides[3];
+};
+
+struct PyStyles {
+  PyObject_HEAD
+  Styles* styles;
+};
+
+static PyTypeObject* g_view_type;
+static PyTypeObject* g_styles_type;
+
+static PyObject* make_view(PyObject* owner, const void* data, const char* format, Py_ssize_t itemsize, std::initializer_list<Py_ssize_t> shape) {
+  auto view = PyObject_New(View, g_view_type);
+  if (!view) return nullptr;
+
+  Py_INCREF(owner);
+  view->owner = owner;
+  view->data = data;
+  view->format = format;
+  view->itemsize = itemsize;
+  view->ndim = int(shape.size());
+
+  // C-contiguous strides.
+  Py_ssize_t stride = itemsize;
+  for (int i = view->ndim - 1; i >= 0; --i) {
+    view->shape[i] = shape.begin()[i];
+    view->strides[i] = stride;
+    stride *= view->shape[i];
+  }
+
+  return reinterpret_cast<PyObject*>(view);
+}
+
+static PyObject* image_view(PyObject* owner, const Sprite& image) {
+  return make_view(owner, image.pixels.data(), "B", 1, {Py_ssize_t(image.height), Py_ssize_t(image.width), 4});
+}
+
+static int view_getbuffer(PyObject* self, Py_buffer* buffer, int flags) {
+  auto view = reinterpret_cast<View*>(self);
+
+  if (flags & PyBUF_WRITABLE) {
+    PyErr_SetString(PyExc_BufferError, "fta2 views are read-only");
+    return -1;
+  }
+
+  Py_ssize_t len = view->itemsize;
+  for (int i = 0; i < view->ndim; ++i) {
+    len *= view->shape[i];
+  }
+
+  buffer->buf = const_cast<void*>(view->data);
+  buffer->obj = Py_NewRef(self);
+  buffer->len = len;
+  buffer->readonly = 1;
+  buffer->itemsize = view->itemsize;
+  buffer->format = (flags & PyBUF_FORMAT) ? const_cast<char*>(view->format) : nullptr;
+  buffer->ndim = view->ndim;
+  buffer->shape = (flags & PyBUF_ND) == PyBUF_ND ? view->shape : nullptr;
+  buffer->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? view->strides : nullptr;
+  buffer->suboffsets = nullptr;
+  buffer->internal = nullptr;
+  return 0;
+}
+
+static void view_dealloc(PyObject* self) {
+  auto view = reinterpret_cast<View*>(self);
+  PyTypeObject* type = Py_TYPE(self);
+  Py_XDECREF(view->owner);
+  PyObject_Free(self);
+  Py_DECREF(type);
+}
+
+static PyObject* view_get_shape(PyObject* self, void*) {
+  auto view = reinterpret_cast<View*>(self);
+  PyObject* shape = PyTuple_New(view->ndim);
+  if (!shape) return nullptr;
+  for (int i = 0; i < view->ndim; ++i) {
+    PyTuple_SET_ITEM(shape, i, PyLong_FromSsize_t(view->shape[i]));
+  }
+  return shape;
+}
+
+static PyGetSetDef g_view_getset[] = {
+  {"shape", view_get_shape, nullptr, "Shape of the view.", nullptr},
+  {nullptr},
+};
+
+static PyType_Slot g_view_slots[] = {
+  {Py_bf_getbuffer, reinterpret_cast<void*>(view_getbuffer)},
+  {Py_tp_dealloc, reinterpret_cast<void*>(view_dealloc)},
+  {Py_tp_getset, g_view_getset},
+  {Py_tp_doc, const_cast<char*>("Read-only view into loaded styles, pass it to numpy.asarray or memoryview.")},
+  {0, nullptr},
+};
+
+static PyType_Spec g_view_spec = {
+  .name = "fta2.View",
+  .basicsize = sizeof(View),
+  .flags = Py_TPFLAGS_DEFAULT,
+  .slots = g_view_slots,
+};
+
+// Styles
+
+static Styles& styles_of(PyObject* self) {
+  return *reinterpret_cast<PyStyles*>(self)->styles;
+}
+
+static void styles_dealloc(PyObject* self) {
+  PyTypeObject* type = Py_TYPE(self);
+  delete reinterpret_cast<PyStyles*>(self)->styles;
+  PyObject_Free(self);
+  Py_DECREF(type);
+}
+
+// index_arg parses an index, and an optional mip level if level is set,
+// and checks the index against count.
+static bool index_arg(PyObject* args, size_t count, Py_ssize_t& index, unsigned* level = nullptr) {
+  bool parsed = level ? PyArg_ParseTuple(args, "n|I", &index, level) : PyArg_ParseTuple(args, "n", &index);
+  if (!parsed) {
+    return false;
+  }
+  if (index < 0 || size_t(index) >= count) {
+    PyErr_Format(PyExc_IndexError, "index %zd out of range, there are %zu", index, count);
+    return false;
+  }
+  return true;
+}
+
+static PyObject* styles_sprite(PyObject* self, PyObject* args) {
+  auto& styles = styles_of(self);
+  Py_ssize_t index;
+  unsigned level = 0;
+  if (!index_arg(args, styles.sprites.size(), index, &level)) return nullptr;
+  return image_view(self, styles.sprite(size_t(index), level));
+}
+
+static PyObject* styles_tile(PyObject* self, PyObject* args) {
+  auto& styles = styles_of(self);
+  Py_ssize_t index;
+  unsigned level = 0;
+  if (!index_arg(args, styles.tiles.size(), index, &level)) return nullptr;
+  return image_view(self, styles.tile(size_t(index), level));
+}
+
+static PyObject* styles_delta(PyObject* self, PyObject* args) {
+  auto& styles = styles_of(self);
+  Py_ssize_t index;
+  if (!index_arg(args, styles.deltas.size(), index)) return nullptr;
+  return image_view(self, styles.deltas[size_t(index)]);
+}
+
+// sprite_info returns (x, y, width, height, kind, local index) of a sprite,
+// x and y being the offset of the trimmed image in the untrimmed sprite.
+static PyObject* styles_sprite_info(PyObject* self, PyObject* args) {
+  auto& styles = styles_of(self);
+  Py_ssize_t index;
+  unsigned level = 0;
+  if (!index_arg(args, styles.sprites.size(), index, &level)) return nullptr;
+
+  auto& sprite = styles.sprite(size_t(index), level);
+
+  SpriteRef ref;
+  if (!styles.sprite_catalog.find(size_t(index), ref)) {
+    return Py_BuildValue("(IIIIOO)", sprite.x, sprite.y, sprite.width, sprite.height, Py_None, Py_None);
+  }
+  return Py_BuildValue("(IIIIsI)", sprite.x, sprite.y, sprite.width, sprite.height, to_string(ref.kind), unsigned(ref.index));
+}
+
+static PyObject* styles_delta_sprite(PyObject* self, PyObject* args) {
+  auto& styles = styles_of(self);
+  Py_ssize_t index;
+  if (!index_arg(args, styles.delta_sprites.size(), index)) return nullptr;
+  return PyLong_FromUnsignedLong(styles.delta_sprites[size_t(index)]);
+}
+
+// sprite_range returns (first, count) of the sprites of a kind by name.
+static PyObject* styles_sprite_range(PyObject* self, PyObject* args) {
+  const char* name;
+  if (!PyArg_ParseTuple(args, "s", &name)) return nullptr;
+
+  for (size_t k = 0; k < size_t(SpriteKind::Count); ++k) {
+    if (strcmp(name, to_string(SpriteKind(k))) == 0) {
+      auto& range = styles_of(self).sprite_catalog[SpriteKind(k)];
+      return Py_BuildValue("(II)", unsigned(range.first), unsigned(range.count));
+    }
+  }
+
+  PyErr_Format(PyExc_KeyError, "unknown sprite kind %s", name);
+  return nullptr;
+}
+
+static PyMethodDef g_styles_methods[] = {
+  {"sprite", styles_sprite, METH_VARARGS, "sprite(index, level=0) -> View of (height, width, 4) RGBA pixels."},
+  {"tile", styles_tile, METH_VARARGS, "tile(index, level=0) -> View of (64, 64, 4) RGBA pixels."},
+  {"delta", styles_delta, METH_VARARGS, "delta(index) -> View of (height, width, 4) RGBA pixels."},
+  {"sprite_info", styles_sprite_info, METH_VARARGS, "sprite_info(index, level=0) -> (x, y, width, height, kind, kind index)."},
+  {"delta_sprite", styles_delta_sprite, METH_VARARGS, "delta_sprite(index) -> index of the sprite the delta applies to."},
+  {"sprite_range", styles_sprite_range, METH_VARARGS, "sprite_range(kind) -> (first, count) of 'car', 'ped', 'code', 'map', 'user' or 'font' sprites."},
+  {nullptr},
+};
+
+static PyObject* styles_get_palettes(PyObject* self, void*) {
+  auto& source = styles_of(self).source;
+  return make_view(self, source.palettes.data(), "B", 1, {Py_ssize_t(source.palettes.size()), Py_ssize_t(kPhysicalPaletteSize), 4});
+}
+
+static PyObject* styles_get_virtual_palettes(PyObject* self, void*) {
+  auto& source = styles_of(self).source;
+  return make_view(self, source.vtable.map, "H", sizeof(uint16_t), {Py_ssize_t(kVirtualPaletteTableSize)});
+}
+
+static PyObject* styles_get_sprite_pages(PyObject* self, void*) {
+  auto& source = styles_of(self).source;
+  Py_ssize_t pages = Py_ssize_t(source.sprite_store.size() / (kSpritePageSize * kSpritePageSize));
+  return make_view(self, source.sprite_store.data(), "B", 1, {pages, Py_ssize_t(kSpritePageSize), Py_ssize_t(kSpritePageSize)});
+}
+
+static PyObject* styles_get_tile_indices(PyObject* self, void*) {
+  auto& source = styles_of(self).source;
+  return make_view(self, source.tiles.data(), "B", 1, {Py_ssize_t(source.tiles.size()), Py_ssize_t(kTileDim), Py_ssize_t(kTileDim)});
+}
+
+static PyObject* styles_get_sprite_count(PyObject* self, void*) {
+  return PyLong_FromSize_t(styles_of(self).sprites.size());
+}
+
+static PyObject* styles_get_tile_count(PyObject* self, void*) {
+  return PyLong_FromSize_t(styles_of(self).tiles.size());
+}
+
+static PyObject* styles_get_delta_count(PyObject* self, void*) {
+  return PyLong_FromSize_t(styles_of(self).deltas.size());
+}
+
+static PyGetSetDef g_styles_getset[] = {
+  {"palettes", styles_get_palettes, nullptr, "PPAL palettes, (palettes, 256, 4) uint8 RGBA.", nullptr},
+  {"virtual_palettes", styles_get_virtual_palettes, nullptr, "PALX virtual palette table, (16384,) uint16 palette numbers.", nullptr},
+  {"sprite_pages", styles_get_sprite_pages, nullptr, "SPRG sprite pages, (pages, 256, 256) uint8 palette indices.", nullptr},
+  {"tile_indices", styles_get_tile_indices, nullptr, "TILE tiles, (tiles, 64, 64) uint8 palette indices.", nullptr},
+  {"sprite_count", styles_get_sprite_count, nullptr, "Number of sprites.", nullptr},
+  {"tile_count", styles_get_tile_count, nullptr, "Number of tiles.", nullptr},
+  {"delta_count", styles_get_delta_count, nullptr, "Number of deltas.", nullptr},
+  {nullptr},
+};
+
+static PyType_Slot g_styles_slots[] = {
+  {Py_tp_dealloc, reinterpret_cast<void*>(styles_dealloc)},
+  {Py_tp_methods, g_styles_methods},
+  {Py_tp_getset, g_styles_getset},
+  {Py_tp_doc, const_cast<char*>("Loaded style file, see fta2.load.")},
+  {0, nullptr},
+};
+
+static PyType_Spec g_styles_spec = {
+  .name = "fta2.Styles",
+  .basicsize = sizeof(PyStyles),
+  .flags = Py_TPFLAGS_DEFAULT,
+  .slots = g_styles_slots,
+};
+
+// Module
+
+static const char* g_load_keywords[] = {"", "trim", "transparent_tiles", "premultiplied_alpha", "mipmaps", nullptr};
+
+static PyObject* load_error(StyleLoadStatus status, const char* filename) {
+  PyObject* type = PyExc_ValueError;
+  if (status == StyleLoadStatus::FileNotFound) type = PyExc_FileNotFoundError;
+  if (status == StyleLoadStatus::ReadError) type = PyExc_OSError;
+  PyErr_Format(type, "%s: %s", filename, to_string(status));
+  return nullptr;
+}
+
+static PyObject* wrap_styles(Styles* styles) {
+  auto result = PyObject_New(PyStyles, g_styles_type);
+  if (!result) {
+    delete styles;
+    return nullptr;
+  }
+  result->styles = styles;
+  return reinterpret_cast<PyObject*>(result);
+}
+
+static void import_options(int trim, int transparent_tiles, int premultiplied_alpha, int mipmaps, StyleLoadOptions& options) {
+  options.import.trim = trim != 0;
+  options.import.transparent_tiles = transparent_tiles != 0;
+  options.import.premultiplied_alpha = premultiplied_alpha != 0;
+  options.import.mipmaps = mipmaps != 0;
+}
+
+static PyObject* fta2_load(PyObject*, PyObject* args, PyObject* kwargs) {
+  PyObject* path = nullptr;
+  int trim = 0, transparent_tiles = 0, premultiplied_alpha = 0, mipmaps = 0;
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O&|$pppp", const_cast<char**>(g_load_keywords), PyUnicode_FSConverter, &path, &trim, &transparent_tiles, &premultiplied_alpha, &mipmaps)) {
+    return nullptr;
+  }
+
+  StyleLoadOptions options;
+  import_options(trim, transparent_tiles, premultiplied_alpha, mipmaps, options);
+
+  auto styles = new Styles;
+  StyleLoadStatus status;
+
+  Py_BEGIN_ALLOW_THREADS
+  status = styles->load(PyBytes_AS_STRING(path), options);
+  Py_END_ALLOW_THREADS
+
+  if (status != StyleLoadStatus::Ok) {
+    delete styles;
+    load_error(status, PyBytes_AS_STRING(path));
+    Py_DECREF(path);
+    return nullptr;
+  }
+
+  Py_DECREF(path);
+  return wrap_styles(styles);
+}
+
+static PyObject* fta2_load_bytes(PyObject*, PyObject* args, PyObject* kwargs) {
+  Py_buffer data;
+  int trim = 0, transparent_tiles = 0, premultiplied_alpha = 0, mipmaps = 0;
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "y*|$pppp", const_cast<char**>(g_load_keywords), &data, &trim, &transparent_tiles, &premultiplied_alpha, &mipmaps)) {
+    return nullptr;
+  }
+
+  StyleLoadOptions options;
+  import_options(trim, transparent_tiles, premultiplied_alpha, mipmaps, options);
+
+  auto styles = new Styles;
+  StyleLoadStatus status;
+
+  // The exported buffer can't be resized while the GIL is released.
+  Py_BEGIN_ALLOW_THREADS
+  status = styles->load_from_memory(static_cast<const uint8_t*>(data.buf), size_t(data.len), options);
+  Py_END_ALLOW_THREADS
+
+  PyBuffer_Release(&data);
+
+  if (status != StyleLoadStatus::Ok) {
+    delete styles;
+    return load_error(status, "<bytes>");
+  }
+  return wrap_styles(styles);
+}
+
+static PyMethodDef g_module_methods[] = {
+  {"load", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)(void)>(fta2_load)), METH_VARARGS | METH_KEYWORDS,
+    "load(path, *, trim=False, transparent_tiles=False, premultiplied_alpha=False, mipmaps=False) -> Styles\n\nLoads a style file, the GIL is released while loading."},
+  {"load_bytes", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)(void)>(fta2_load_bytes)), METH_VARARGS | METH_KEYWORDS,
+    "load_bytes(data, *, trim=False, transparent_tiles=False, premultiplied_alpha=False, mipmaps=False) -> Styles\n\nLoads a style file held in a bytes-like object."},
+  {nullptr},
+};
+
+static PyModuleDef g_module = {
+  .m_base = PyModuleDef_HEAD_INIT,
+  .m_name = "fta2",
+  .m_doc = "GTA2 style files as zero-copy buffers.",
+  .m_size = -1,
+  .m_methods = g_module_methods,
+};
+
+PyMODINIT_FUNC PyInit_fta2() {
+  g_view_type = reinterpret_cast<PyTypeObject*>(PyType_FromSpec(&g_view_spec));
+  g_styles_type = reinterpret_cast<PyTypeObject*>(PyType_FromSpec(&g_styles_spec));
+  if (!g_view_type || !g_styles_type) {
+    return nullptr;
+  }
+
+  PyObject* module = PyModule_Create(&g_module);
+  if (!module) {
+    return nullptr;
+  }
+
+  if (PyModule_AddObjectRef(module, "View", reinterpret_cast<PyObject*>(g_view_type)) < 0 ||
+      PyModule_AddObjectRef(module, "Styles", reinterpret_cast<PyObject*>(g_styles_type)) < 0) {
+    Py_DECREF(module);
+    return nullptr;
+  }
+
+  return module;
+}
@@ -0,0 +1,37 @@
+# Builds the fta2 Python module from the C++ sources, no other dependencies:
+#
+#   cd python && python setup.py build_ext --inplace
+
+import os
+import sys
+
+from setuptools import Extension, setup
+
+root = os.path.dirname(os.path.abspath(__file__))
+src = os.path.join(root, "..", "src")
+
+sources = ["fta2module.cpp"]
+sources += [os.path.relpath(os.path.join(src, name), root) for name in sorted(os.listdir(src)) if name.endswith(".cpp") and name != "main.cpp"]
+
+if sys.platform == "win32":
+    compile_args = ["/std:c++20", "/EHsc"]
+    define_macros = [("WIN32_LEAN_AND_MEAN", None), ("NOMINMAX", None), ("_CRT_SECURE_NO_WARNINGS", None)]
+else:
+    compile_args = ["-std=c++20", "-O2"]
+    define_macros = []
+
+setup(
+    name="fta2",
+    version="0.1.0",
+    description="GTA2 style files as zero-copy buffers",
+    ext_modules=[
+        Extension(
+            "fta2",
+            sources=sources,
+            include_dirs=[os.path.relpath(src, root)],
+            define_macros=define_macros,
+            extra_compile_args=compile_args,
+            language="c++",
+        ),
+    ],
+)
@@ -0,0 +1,111 @@
+#include "collision.h"
+#include "styles.h"
+#include <algorithm>
+
+static CollisionMask make_mask(uint32_t width, uint32_t height) {
+  CollisionMask mask;
+  mask.width = width;
+  mask.height = height;
+  mask.stride = (width + 63) / 64;
+  mask.bits.resize(size_t(mask.stride) * height);
+  return mask;
+}
+
+CollisionMask build_collision_mask(const uint8_t* indices, size_t pitch, uint32_t width, uint32_t height) {
+  auto mask = make_mask(width, height);
+
+  for (uint32_t y = 0; y < height; ++y) {
+    const uint8_t* row = indices + y * pitch;
+    uint64_t* dest = mask.bits.data() + y * mask.stride;
+
+    for (uint32_t x = 0; x < width; ++x) {
+      dest[x / 64] |= uint64_t(row[x] != 0) << (x % 64);
+    }
+  }
+
+  return mask;
+}
+
+CollisionMask build_collision_mask(const Sprite& sprite) {
+  auto mask = make_mask(sprite.width, sprite.height);
+
+  for (uint32_t y = 0; y < sprite.height; ++y) {
+    const Color* row = sprite.pixels.data() + y * sprite.width;
+    uint64_t* dest = mask.bits.data() + y * mask.stride;
+
+    for (uint32_t x = 0; x < sprite.width; ++x) {
+      dest[x / 64] |= uint64_t(row[x].a != 0) << (x % 64);
+    }
+  }
+
+  return mask;
+}
+
+// load_bits returns the 64 bits of row starting at bit offset, bits
+// outside of the row read as zero.
+static uint64_t load_bits(const uint64_t* row, uint32_t stride, int offset) {
+  auto word = [&](int index) -> uint64_t {
+    return (index >= 0 && uint32_t(index) < stride) ? row[index] : 0;
+  };
+
+  int index = offset >> 6; // floor division, offset may be negative
+  int shift = offset & 63;
+
+  if (shift == 0) {
+    return word(index);
+  }
+  return (word(index) >> shift) | (word(index + 1) << (64 - shift));
+}
+
+CollisionMask crop_collision_mask(const CollisionMask& mask, uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
+  if (x == 0 && y == 0 && width == mask.width && height == mask.height) {
+    return mask;
+  }
+
+  auto result = make_mask(width, height);
+
+  for (uint32_t row = 0; row < height; ++row) {
+    const uint64_t* src = mask.bits.data() + size_t(y + row) * mask.stride;
+    uint64_t* dest = result.bits.data() + size_t(row) * result.stride;
+
+    for (uint32_t w = 0; w < result.stride; ++w) {
+      dest[w] = load_bits(src, mask.stride, int(x + w * 64));
+    }
+
+    // Clear the bits past the new width that came from the source row.
+    if (width % 64 != 0) {
+      dest[result.stride - 1] &= (uint64_t(1) << (width % 64)) - 1;
+    }
+  }
+
+  return result;
+}
+
+bool masks_overlap(const CollisionMask& a, const CollisionMask& b, int dx, int dy) {
+  // Overlapping rectangle in a's space.
+  int x0 = std::max(0, dx);
+  int y0 = std::max(0, dy);
+  int x1 = std::min(int(a.width), dx + int(b.width));
+  int y1 = std::min(int(a.height), dy + int(b.height));
+
+  if (x0 >= x1 || y0 >= y1) {
+    return false;
+  }
+
+  int first_word = x0 / 64;
+  int last_word = (x1 - 1) / 64;
+
+  for (int y = y0; y < y1; ++y) {
+    const uint64_t* row_a = a.bits.data() + size_t(y) * a.stride;
+    const uint64_t* row_b = b.bits.data() + size_t(y - dy) * b.stride;
+
+    for (int w = first_word; w <= last_word; ++w) {
+      // Bits of b are zero outside of b, so no masking of the edges is needed.
+      if (row_a[w] & load_bits(row_b, b.stride, w * 64 - dx)) {
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
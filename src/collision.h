@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+struct Sprite;
+
+// CollisionMask is a one bit per pixel opacity mask. Pixel x of a row is
+// bit x % 64 of word x / 64, rows are stride words apart.
+struct CollisionMask {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint32_t stride = 0;
+  std::vector<uint64_t> bits;
+
+  bool test(int x, int y) const {
+    if (x < 0 || y < 0 || uint32_t(x) >= width || uint32_t(y) >= height) {
+      return false;
+    }
+    return (bits[y * stride + x / 64] >> (x % 64)) & 1;
+  }
+};
+
+// build_collision_mask builds a mask from palette indices, index 0 is transparent.
+CollisionMask build_collision_mask(const uint8_t* indices, size_t pitch, uint32_t width, uint32_t height);
+
+// build_collision_mask builds a mask from RGBA pixels, alpha 0 is transparent.
+CollisionMask build_collision_mask(const Sprite& sprite);
+
+// crop_collision_mask returns the width x height part of mask starting at (x, y).
+CollisionMask crop_collision_mask(const CollisionMask& mask, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+
+// masks_overlap returns true if a and b share an opaque pixel when b's
+// origin is placed at (dx, dy) relative to a's origin.
+bool masks_overlap(const CollisionMask& a, const CollisionMask& b, int dx, int dy);
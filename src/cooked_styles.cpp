@@ -0,0 +1,342 @@
+#include "cooked_styles.h"
+#include "hash.h"
+#include "trace.h"
+#include <stdio.h>
+#include <string.h>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <unordered_map>
+
+constexpr char kCookedMagic[8] = {'F', 'T', 'A', '2', 'C', 'O', 'O', 'K'};
+constexpr size_t kCookedAlignment = 16;
+
+static const size_t kSectionElementSize[CookedSection_Count] = {
+  sizeof(CookedImage),
+  sizeof(CookedImage),
+  sizeof(CookedImage),
+  sizeof(uint16_t),
+  sizeof(SpriteBases),
+  sizeof(FontBase),
+  sizeof(CookedCar),
+  sizeof(uint8_t),
+  sizeof(Door),
+  sizeof(PhysicalPalette),
+  sizeof(uint16_t),
+  sizeof(Color),
+};
+
+static uint32_t import_flags(const StyleImportOptions& import) {
+  return uint32_t(import.trim) | uint32_t(import.transparent_tiles) << 1 | uint32_t(import.premultiplied_alpha) << 2;
+}
+
+struct CookWriter {
+  std::vector<uint8_t> out;
+  CookedHeader header = { };
+
+  void align() {
+    out.resize((out.size() + kCookedAlignment - 1) / kCookedAlignment * kCookedAlignment);
+  }
+
+  template <typename T>
+  void section(CookedSection id, const T* values, size_t count) {
+    align();
+    header.sections[id] = {.offset = out.size(), .count = count};
+    auto bytes = reinterpret_cast<const uint8_t*>(values);
+    out.insert(out.end(), bytes, bytes + count * sizeof(T));
+  }
+};
+
+// PixelLayout assigns every distinct pixel buffer its offset in the
+// pixel section.
+struct PixelLayout {
+  std::unordered_map<const void*, uint64_t> offsets;
+  std::vector<const Pixels*> buffers;
+  uint64_t size = 0;
+
+  uint64_t add(const Pixels& pixels) {
+    auto [it, inserted] = offsets.try_emplace(pixels.data(), size);
+    if (inserted) {
+      buffers.push_back(&pixels);
+      size += pixels.size() * sizeof(Color);
+    }
+    return it->second;
+  }
+};
+
+static std::vector<CookedImage> cook_images(const std::vector<Sprite>& images, PixelLayout& layout) {
+  std::vector<CookedImage> result(images.size());
+
+  for (size_t i = 0; i < images.size(); ++i) {
+    auto& image = images[i];
+    result[i] = {
+      .pixels = image.pixels.empty() ? 0 : layout.add(image.pixels),
+      .width = uint16_t(image.width),
+      .height = uint16_t(image.height),
+      .x = uint16_t(image.x),
+      .y = uint16_t(image.y),
+      .opacity = image.opacity,
+    };
+  }
+
+  return result;
+}
+
+std::vector<uint8_t> cook_styles(const Styles& styles, const CookedSourceInfo& source) {
+  TRACE_SCOPE("cook_styles");
+
+  PixelLayout layout;
+  auto sprites = cook_images(styles.sprites, layout);
+  auto tiles = cook_images(styles.tiles, layout);
+  auto deltas = cook_images(styles.deltas, layout);
+
+  std::vector<CookedCar> cars;
+  std::vector<uint8_t> remaps;
+  std::vector<Door> doors;
+  for (auto& car : styles.source.cars) {
+    cars.push_back({
+      .model = car.model,
+      .sprite = car.sprite,
+      .width = car.width,
+      .height = car.height,
+      .passengers = car.passengers,
+      .wreck = car.wreck,
+      .rating = car.rating,
+      .front_wheel_offset = car.front_wheel_offset,
+      .rear_wheel_offset = car.rear_wheel_offset,
+      .front_window_offset = car.front_window_offset,
+      .rear_window_offset = car.rear_window_offset,
+      .info_flags = car.info_flags,
+      .info_flags2 = car.info_flags2,
+      .num_remaps = uint8_t(car.remap.size()),
+      .num_doors = uint8_t(car.doors.size()),
+      .remaps = uint32_t(remaps.size()),
+      .doors = uint32_t(doors.size()),
+    });
+    remaps.insert(remaps.end(), car.remap.begin(), car.remap.end());
+    doors.insert(doors.end(), car.doors.begin(), car.doors.end());
+  }
+
+  CookWriter w;
+  w.out.resize(sizeof(CookedHeader));
+  w.section(CookedSection_Sprites, sprites.data(), sprites.size());
+  w.section(CookedSection_Tiles, tiles.data(), tiles.size());
+  w.section(CookedSection_Deltas, deltas.data(), deltas.size());
+  w.section(CookedSection_DeltaSprites, styles.delta_sprites.data(), styles.delta_sprites.size());
+  w.section(CookedSection_SpriteBases, &styles.source.sprite_bases, 1);
+  w.section(CookedSection_FontBases, styles.source.font_bases.data(), styles.source.font_bases.size());
+  w.section(CookedSection_Cars, cars.data(), cars.size());
+  w.section(CookedSection_CarRemaps, remaps.data(), remaps.size());
+  w.section(CookedSection_CarDoors, doors.data(), doors.size());
+  w.section(CookedSection_Palettes, styles.source.palettes.data(), styles.source.palettes.size());
+  w.section(CookedSection_VirtualPalettes, styles.source.vtable.map, kVirtualPaletteTableSize);
+
+  // Image pixel offsets were assigned relative to the pixel section.
+  w.align();
+  uint64_t pixel_base = w.out.size();
+  w.header.sections[CookedSection_Pixels] = {.offset = pixel_base, .count = layout.size / sizeof(Color)};
+  for (auto pixels : layout.buffers) {
+    w.out.insert(w.out.end(), reinterpret_cast<const uint8_t*>(pixels->begin()), reinterpret_cast<const uint8_t*>(pixels->end()));
+  }
+
+  for (auto id : {CookedSection_Sprites, CookedSection_Tiles, CookedSection_Deltas}) {
+    auto& range = w.header.sections[id];
+    auto images = reinterpret_cast<CookedImage*>(w.out.data() + range.offset);
+    for (size_t i = 0; i < range.count; ++i) {
+      images[i].pixels += pixel_base;
+    }
+  }
+
+  memcpy(w.header.magic, kCookedMagic, sizeof(kCookedMagic));
+  w.header.version = kCookedVersion;
+  w.header.import_flags = import_flags(styles.import_options);
+  w.header.source_hash = source.hash;
+  w.header.source_size = source.size;
+  w.header.source_mtime = source.mtime;
+  w.header.file_size = w.out.size();
+  memcpy(w.out.data(), &w.header, sizeof(CookedHeader));
+
+  return w.out;
+}
+
+static bool valid_images(std::span<const CookedImage> images, const CookedRange& pixels) {
+  uint64_t pixels_end = pixels.offset + pixels.count * sizeof(Color);
+
+  for (auto& image : images) {
+    uint64_t bytes = uint64_t(image.width) * image.height * sizeof(Color);
+    if (bytes == 0) continue;
+    if (image.pixels < pixels.offset || image.pixels > pixels_end || pixels_end - image.pixels < bytes || image.pixels % alignof(Color) != 0) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool CookedStyles::open(const char* filename) {
+  TRACE_SCOPE("open_cooked");
+
+  close();
+
+  if (!m_file.open(filename)) {
+    return false;
+  }
+  return use(m_file.data(), m_file.size());
+}
+
+bool CookedStyles::view(const uint8_t* data, size_t size) {
+  close();
+  return use(data, size);
+}
+
+// use checks the cooked data and points the view at it.
+bool CookedStyles::use(const uint8_t* data, size_t size) {
+  if (size < sizeof(CookedHeader) || reinterpret_cast<uintptr_t>(data) % kCookedAlignment != 0) {
+    close();
+    return false;
+  }
+
+  auto header = reinterpret_cast<const CookedHeader*>(data);
+  if (memcmp(header->magic, kCookedMagic, sizeof(kCookedMagic)) != 0 || header->version != kCookedVersion || header->file_size != size) {
+    close();
+    return false;
+  }
+
+  for (uint32_t id = 0; id < CookedSection_Count; ++id) {
+    auto& range = header->sections[id];
+    bool ok = range.offset % kCookedAlignment == 0 &&
+      range.offset <= size &&
+      range.count <= (size - range.offset) / kSectionElementSize[id];
+    if (!ok) {
+      close();
+      return false;
+    }
+  }
+
+  m_data = data;
+  m_size = size;
+  m_header = header;
+
+  bool ok = header->sections[CookedSection_SpriteBases].count == 1 &&
+    header->sections[CookedSection_VirtualPalettes].count == kVirtualPaletteTableSize &&
+    valid_images(sprites(), header->sections[CookedSection_Pixels]) &&
+    valid_images(tiles(), header->sections[CookedSection_Pixels]) &&
+    valid_images(deltas(), header->sections[CookedSection_Pixels]);
+
+  for (auto& car : cars()) {
+    ok = ok &&
+      uint64_t(car.remaps) + car.num_remaps <= header->sections[CookedSection_CarRemaps].count &&
+      uint64_t(car.doors) + car.num_doors <= header->sections[CookedSection_CarDoors].count;
+  }
+
+  if (!ok) {
+    close();
+    return false;
+  }
+
+  return true;
+}
+
+void CookedStyles::close() {
+  m_header = nullptr;
+  m_data = nullptr;
+  m_size = 0;
+  m_file.close();
+}
+
+static int64_t modification_time(const char* filename) {
+  std::error_code ec;
+  auto time = std::filesystem::last_write_time(filename, ec);
+  return ec ? 0 : int64_t(time.time_since_epoch().count());
+}
+
+// patch_source_mtime updates the modification time recorded in a cache
+// whose source was touched without changing, so the next start doesn't
+// hash it again.
+static void patch_source_mtime(const char* cache_filename, int64_t mtime) {
+  FILE* f = fopen(cache_filename, "r+b");
+  if (!f) {
+    return;
+  }
+
+  if (fseek(f, offsetof(CookedHeader, source_mtime), SEEK_SET) == 0) {
+    fwrite(&mtime, sizeof(mtime), 1, f);
+  }
+  fclose(f);
+}
+
+// write_cache writes data next to cache_filename and renames it into place,
+// so processes starting concurrently never map a partially written file.
+static bool write_cache(const char* cache_filename, const std::vector<uint8_t>& data) {
+  std::string temp = std::string(cache_filename) + ".tmp" + std::to_string(std::random_device{}());
+
+  FILE* f = fopen(temp.c_str(), "wb");
+  if (!f) {
+    return false;
+  }
+
+  bool ok = fwrite(data.data(), data.size(), 1, f) == 1;
+  ok = fclose(f) == 0 && ok;
+
+  std::error_code ec;
+  if (ok) {
+    std::filesystem::rename(temp, cache_filename, ec);
+  }
+  if (!ok || ec) {
+    std::filesystem::remove(temp, ec);
+    return false;
+  }
+
+  return true;
+}
+
+StyleLoadStatus load_cooked_styles(const char* filename, const char* cache_filename, CookedStyles& cooked, const StyleImportOptions& import) {
+  std::error_code ec;
+  uint64_t size = std::filesystem::file_size(filename, ec);
+  if (ec) {
+    return StyleLoadStatus::FileNotFound;
+  }
+  int64_t mtime = modification_time(filename);
+
+  bool have_cache = cooked.open(cache_filename) && cooked.header().import_flags == import_flags(import);
+  if (have_cache && cooked.header().source_size == size && cooked.header().source_mtime == mtime) {
+    return StyleLoadStatus::Ok;
+  }
+
+  std::vector<uint8_t> buf;
+  StyleLoadOptions options;
+  options.import = import;
+  options.import.collision_masks = false;
+  options.import.mipmaps = false;
+
+  auto status = read_style_file(filename, buf, options);
+  if (status != StyleLoadStatus::Ok) {
+    cooked.close();
+    return status;
+  }
+
+  CookedSourceInfo source = {
+    .hash = hash64(buf.data(), buf.size()),
+    .size = buf.size(),
+    .mtime = mtime,
+  };
+
+  if (have_cache && cooked.header().source_hash == source.hash && cooked.header().source_size == source.size) {
+    cooked.close();
+    patch_source_mtime(cache_filename, mtime);
+    return cooked.open(cache_filename) ? StyleLoadStatus::Ok : StyleLoadStatus::ReadError;
+  }
+  cooked.close();
+
+  Styles styles;
+  status = styles.load_from_memory(buf.data(), buf.size(), options);
+  if (status != StyleLoadStatus::Ok) {
+    return status;
+  }
+
+  if (!write_cache(cache_filename, cook_styles(styles, source)) || !cooked.open(cache_filename)) {
+    return StyleLoadStatus::ReadError;
+  }
+
+  return StyleLoadStatus::Ok;
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include "styles.h"
+#include "io.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <span>
+#include <vector>
+
+// Cooked styles are the imported images and tables of a style file, laid
+// out so the file can be mapped and used as is. Every reference within the
+// file is an offset from its start, nothing needs to be fixed up or parsed.
+//
+//   CookedHeader
+//   sections, each 16 byte aligned, see CookedSection
+//   RGBA pixels of every image, images sharing pixels are stored once
+
+constexpr uint32_t kCookedVersion = 3;
+
+enum CookedSection : uint32_t {
+  CookedSection_Sprites,          // CookedImage
+  CookedSection_Tiles,            // CookedImage
+  CookedSection_Deltas,           // CookedImage
+  CookedSection_DeltaSprites,     // uint16_t, sprite each delta applies to
+  CookedSection_SpriteBases,      // SpriteBases
+  CookedSection_FontBases,        // FontBase
+  CookedSection_Cars,             // CookedCar
+  CookedSection_CarRemaps,        // uint8_t
+  CookedSection_CarDoors,         // Door
+  CookedSection_Palettes,         // PhysicalPalette
+  CookedSection_VirtualPalettes,  // uint16_t, see VirtualPaletteTable
+  CookedSection_Pixels,           // Color
+
+  CookedSection_Count
+};
+
+struct CookedRange {
+  uint64_t offset; // from the start of the file
+  uint64_t count;  // number of elements
+};
+
+struct CookedHeader {
+  char magic[8];         // "FTA2COOK"
+  uint32_t version;      // kCookedVersion
+  uint32_t import_flags; // import options the images were cooked with
+  uint64_t source_hash;  // hash64 of the style file
+  uint64_t source_size;
+  int64_t source_mtime;  // modification time of the style file when cooked
+  uint64_t file_size;
+  CookedRange sections[CookedSection_Count];
+};
+
+struct CookedImage {
+  uint64_t pixels; // offset of width * height RGBA pixels
+  uint16_t width;
+  uint16_t height;
+  uint16_t x;      // see Sprite::x
+  uint16_t y;
+  Opacity opacity;
+  uint8_t pad[7];
+};
+static_assert(sizeof(CookedImage) == 24);
+
+struct CookedCar {
+  uint8_t model;
+  uint8_t sprite;
+  uint8_t width;
+  uint8_t height;
+  uint8_t passengers;
+  uint8_t wreck;
+  uint8_t rating;
+  int8_t front_wheel_offset;
+  int8_t rear_wheel_offset;
+  int8_t front_window_offset;
+  int8_t rear_window_offset;
+  uint8_t info_flags;
+  uint8_t info_flags2;
+  uint8_t num_remaps;
+  uint8_t num_doors;
+  uint8_t pad;
+  uint32_t remaps; // index of the first remap in CookedSection_CarRemaps
+  uint32_t doors;  // index of the first door in CookedSection_CarDoors
+};
+static_assert(sizeof(CookedCar) == 24);
+
+struct CookedSourceInfo {
+  uint64_t hash;
+  uint64_t size;
+  int64_t mtime;
+};
+
+// cook_styles writes the imported images and tables of styles into the
+// cooked format. Mip levels and collision masks are not cooked.
+std::vector<uint8_t> cook_styles(const Styles& styles, const CookedSourceInfo& source);
+
+// CookedStyles is a read-only view of a mapped cooked style file.
+class CookedStyles {
+  private:
+    MappedFile m_file;
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+    const CookedHeader* m_header = nullptr;
+
+    template <typename T>
+    std::span<const T> section(CookedSection id) const {
+      if (!m_header) return { };
+      auto& range = m_header->sections[id];
+      return {reinterpret_cast<const T*>(m_data + range.offset), size_t(range.count)};
+    }
+
+    bool use(const uint8_t* data, size_t size);
+
+  public:
+    // open maps filename and checks that it is a well formed cooked file of
+    // the current version.
+    bool open(const char* filename);
+
+    // view checks and uses cooked data that is already in memory, e.g. in
+    // shared memory. data must be 16 byte aligned and outlive the view.
+    bool view(const uint8_t* data, size_t size);
+
+    void close();
+
+    bool valid() const { return m_header != nullptr; }
+    const CookedHeader& header() const { return *m_header; }
+
+    std::span<const CookedImage> sprites() const { return section<CookedImage>(CookedSection_Sprites); }
+    std::span<const CookedImage> tiles() const { return section<CookedImage>(CookedSection_Tiles); }
+    std::span<const CookedImage> deltas() const { return section<CookedImage>(CookedSection_Deltas); }
+    std::span<const uint16_t> delta_sprites() const { return section<uint16_t>(CookedSection_DeltaSprites); }
+    std::span<const FontBase> font_bases() const { return section<FontBase>(CookedSection_FontBases); }
+    std::span<const CookedCar> cars() const { return section<CookedCar>(CookedSection_Cars); }
+    std::span<const PhysicalPalette> palettes() const { return section<PhysicalPalette>(CookedSection_Palettes); }
+    std::span<const uint16_t> virtual_palettes() const { return section<uint16_t>(CookedSection_VirtualPalettes); }
+
+    const SpriteBases& sprite_bases() const { return section<SpriteBases>(CookedSection_SpriteBases)[0]; }
+
+    const Color* pixels(const CookedImage& image) const {
+      return reinterpret_cast<const Color*>(m_data + image.pixels);
+    }
+
+    std::span<const uint8_t> remaps(const CookedCar& car) const {
+      return section<uint8_t>(CookedSection_CarRemaps).subspan(car.remaps, car.num_remaps);
+    }
+
+    std::span<const Door> doors(const CookedCar& car) const {
+      return section<Door>(CookedSection_CarDoors).subspan(car.doors, car.num_doors);
+    }
+};
+
+// load_cooked_styles maps the cooked cache of a style file, cooking the
+// style file into cache_filename first if the cache is missing, was cooked
+// with other import options or is stale. The cache is considered fresh if
+// the style file's size and modification time match, or else if its hash
+// does.
+StyleLoadStatus load_cooked_styles(const char* filename, const char* cache_filename, CookedStyles& cooked, const StyleImportOptions& import = {});
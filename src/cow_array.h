@@ -0,0 +1,97 @@
+#pragma once
+
+#include <assert.h>
+#include <stddef.h>
+#include <algorithm>
+#include <memory>
+#include <span>
+#include <vector>
+
+// CowArray is a fixed size array stored in pages that copies share. Copying
+// an array is O(1). Editing copies the page table and the edited page first
+// if another array still references them, so every copy only pays for the
+// pages it changes.
+template <typename T, size_t PageItems>
+class CowArray {
+  private:
+    using Page = std::vector<T>;
+    using PageTable = std::vector<std::shared_ptr<const Page>>;
+
+    std::shared_ptr<const PageTable> m_pages;
+    size_t m_size = 0;
+
+    T* mutable_page(size_t page) {
+      if (m_pages.use_count() > 1) {
+        m_pages = std::make_shared<PageTable>(*m_pages);
+      }
+
+      // Like Pixels::mutable_data, the table and pages were allocated
+      // non-const here and nothing else references them.
+      auto& pages = const_cast<PageTable&>(*m_pages);
+      if (pages[page].use_count() > 1) {
+        pages[page] = std::make_shared<Page>(*pages[page]);
+      }
+      return const_cast<T*>(pages[page]->data());
+    }
+
+  public:
+    static constexpr size_t kPageItems = PageItems;
+
+    CowArray() = default;
+
+    explicit CowArray(std::span<const T> items) : m_size(items.size()) {
+      auto pages = std::make_shared<PageTable>();
+      pages->reserve(page_count());
+      for (size_t first = 0; first < items.size(); first += PageItems) {
+        auto page = items.subspan(first, std::min(PageItems, items.size() - first));
+        pages->push_back(std::make_shared<Page>(page.begin(), page.end()));
+      }
+      m_pages = std::move(pages);
+    }
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    size_t page_count() const { return (m_size + PageItems - 1) / PageItems; }
+
+    const T& operator[](size_t index) const {
+      assert(index < m_size);
+      return (*(*m_pages)[index / PageItems])[index % PageItems];
+    }
+
+    // page returns the items of page, the last page may be short.
+    std::span<const T> page(size_t page) const {
+      return *(*m_pages)[page];
+    }
+
+    // edit returns item index for writing.
+    T& edit(size_t index) {
+      assert(index < m_size);
+      return mutable_page(index / PageItems)[index % PageItems];
+    }
+
+    // edit returns count items from first for writing. They must be on the
+    // same page.
+    std::span<T> edit(size_t first, size_t count) {
+      assert(first + count <= m_size && (count == 0 || first / PageItems == (first + count - 1) / PageItems));
+      return {mutable_page(first / PageItems) + first % PageItems, count};
+    }
+
+    // same_page is true when both arrays share page, i.e. neither changed it
+    // since one was copied from the other.
+    bool same_page(const CowArray& other, size_t page) const {
+      return m_pages == other.m_pages || (*m_pages)[page] == (*other.m_pages)[page];
+    }
+
+    bool same(const CowArray& other) const { return m_pages == other.m_pages; }
+
+    // page_id identifies the storage of page, arrays sharing it return the
+    // same id.
+    const void* page_id(size_t page) const { return (*m_pages)[page].get(); }
+
+    void copy_to(T* dest) const {
+      for (size_t i = 0; i < page_count(); ++i) {
+        auto items = page(i);
+        std::copy(items.begin(), items.end(), dest + i * PageItems);
+      }
+    }
+};
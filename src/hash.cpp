@@ -0,0 +1,187 @@
+#include "hash.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <nmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#define FTA2_CRC32C_X64 1
+#elif defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define FTA2_CRC32C_ARM 1
+#endif
+
+constexpr uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t kPrime4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t kPrime5 = 0x27D4EB2F165667C5ULL;
+
+static inline uint64_t rotl(uint64_t x, int r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t load64(const uint8_t* p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint32_t load32(const uint8_t* p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint64_t mix_round(uint64_t acc, uint64_t input) {
+  acc += input * kPrime2;
+  acc = rotl(acc, 31);
+  return acc * kPrime1;
+}
+
+static inline uint64_t merge_round(uint64_t acc, uint64_t val) {
+  acc ^= mix_round(0, val);
+  return acc * kPrime1 + kPrime4;
+}
+
+uint64_t hash64(const void* data, size_t size, uint64_t seed) {
+  const uint8_t* p = static_cast<const uint8_t*>(data);
+  const uint8_t* end = p + size;
+  uint64_t h;
+
+  if (size >= 32) {
+    uint64_t v1 = seed + kPrime1 + kPrime2;
+    uint64_t v2 = seed + kPrime2;
+    uint64_t v3 = seed;
+    uint64_t v4 = seed - kPrime1;
+
+    const uint8_t* limit = end - 32;
+    do {
+      v1 = mix_round(v1, load64(p));
+      v2 = mix_round(v2, load64(p + 8));
+      v3 = mix_round(v3, load64(p + 16));
+      v4 = mix_round(v4, load64(p + 24));
+      p += 32;
+    } while (p <= limit);
+
+    h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+    h = merge_round(h, v1);
+    h = merge_round(h, v2);
+    h = merge_round(h, v3);
+    h = merge_round(h, v4);
+  } else {
+    h = seed + kPrime5;
+  }
+
+  h += static_cast<uint64_t>(size);
+
+  while (p + 8 <= end) {
+    h ^= mix_round(0, load64(p));
+    h = rotl(h, 27) * kPrime1 + kPrime4;
+    p += 8;
+  }
+
+  if (p + 4 <= end) {
+    h ^= static_cast<uint64_t>(load32(p)) * kPrime1;
+    h = rotl(h, 23) * kPrime2 + kPrime3;
+    p += 4;
+  }
+
+  while (p < end) {
+    h ^= (*p) * kPrime5;
+    h = rotl(h, 11) * kPrime1;
+    ++p;
+  }
+
+  h ^= h >> 33;
+  h *= kPrime2;
+  h ^= h >> 29;
+  h *= kPrime3;
+  h ^= h >> 32;
+  return h;
+}
+
+// CRC-32C, reflected polynomial 0x1EDC6F41.
+constexpr uint32_t kCrc32cPoly = 0x82F63B78;
+
+struct Crc32cTable {
+  uint32_t entries[256];
+
+  constexpr Crc32cTable() : entries() {
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t crc = i;
+      for (int bit = 0; bit < 8; ++bit) {
+        crc = (crc >> 1) ^ (kCrc32cPoly & (0u - (crc & 1)));
+      }
+      entries[i] = crc;
+    }
+  }
+};
+
+static constexpr Crc32cTable kCrc32cTable;
+
+static uint32_t crc32c_software(const uint8_t* p, size_t size, uint32_t crc) {
+  for (size_t i = 0; i < size; ++i) {
+    crc = kCrc32cTable.entries[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+  }
+  return crc;
+}
+
+#if FTA2_CRC32C_X64
+
+#ifdef _MSC_VER
+static bool has_sse42() {
+  int info[4];
+  __cpuid(info, 1);
+  return (info[2] & (1 << 20)) != 0;
+}
+#define FTA2_TARGET_SSE42
+#else
+static bool has_sse42() {
+  return __builtin_cpu_supports("sse4.2");
+}
+#define FTA2_TARGET_SSE42 __attribute__((target("sse4.2")))
+#endif
+
+FTA2_TARGET_SSE42 static uint32_t crc32c_hardware(const uint8_t* p, size_t size, uint32_t crc) {
+  uint64_t crc64 = crc;
+  for (; size >= 8; p += 8, size -= 8) {
+    crc64 = _mm_crc32_u64(crc64, load64(p));
+  }
+  crc = uint32_t(crc64);
+  for (; size > 0; ++p, --size) {
+    crc = _mm_crc32_u8(crc, *p);
+  }
+  return crc;
+}
+
+#elif FTA2_CRC32C_ARM
+
+static uint32_t crc32c_hardware(const uint8_t* p, size_t size, uint32_t crc) {
+  for (; size >= 8; p += 8, size -= 8) {
+    crc = __crc32cd(crc, load64(p));
+  }
+  for (; size > 0; ++p, --size) {
+    crc = __crc32cb(crc, *p);
+  }
+  return crc;
+}
+
+#endif
+
+uint32_t crc32c(const void* data, size_t size, uint32_t crc) {
+  auto p = static_cast<const uint8_t*>(data);
+  crc = ~crc;
+
+#if FTA2_CRC32C_X64
+  static const bool hardware = has_sse42();
+  crc = hardware ? crc32c_hardware(p, size, crc) : crc32c_software(p, size, crc);
+#elif FTA2_CRC32C_ARM
+  crc = crc32c_hardware(p, size, crc);
+#else
+  crc = crc32c_software(p, size, crc);
+#endif
+
+  return ~crc;
+}
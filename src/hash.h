@@ -0,0 +1,12 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// hash64 is a fast non-cryptographic 64-bit hash (XXH64) used to detect
+// changed chunks and items.
+uint64_t hash64(const void* data, size_t size, uint64_t seed = 0);
+
+// crc32c is the CRC-32C (Castagnoli) checksum of data, continuing from crc.
+// It uses the SSE4.2 or ARMv8 CRC instructions when the CPU has them.
+uint32_t crc32c(const void* data, size_t size, uint32_t crc = 0);
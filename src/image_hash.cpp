@@ -0,0 +1,225 @@
+#include "image_hash.h"
+#include "styles.h"
+#include "thread_pool.h"
+#include "trace.h"
+#include <algorithm>
+
+// The hash compares kHashColumns averages per row of kHashRows rows.
+constexpr uint32_t kHashColumns = 9;
+constexpr uint32_t kHashRows = 8;
+
+uint64_t perceptual_hash(const Sprite& image, bool premultiplied) {
+  if (image.width == 0 || image.height == 0) {
+    return 0;
+  }
+
+  // Cells cover the pixels [x0, x1) x [y0, y1), images smaller than the
+  // grid repeat pixels in neighbouring cells.
+  auto cell_start = [](uint32_t i, uint32_t cells, uint32_t size) {
+    return std::min(i * size / cells, size - 1);
+  };
+  auto cell_end = [](uint32_t i, uint32_t cells, uint32_t size, uint32_t start) {
+    return std::max((i + 1) * size / cells, start + 1);
+  };
+
+  // Averages in 1/256 steps so that close cells still compare apart.
+  uint32_t luma[kHashRows][kHashColumns];
+  const Color* pixels = image.pixels.data();
+
+  for (uint32_t cy = 0; cy < kHashRows; ++cy) {
+    uint32_t y0 = cell_start(cy, kHashRows, image.height);
+    uint32_t y1 = cell_end(cy, kHashRows, image.height, y0);
+
+    for (uint32_t cx = 0; cx < kHashColumns; ++cx) {
+      uint32_t x0 = cell_start(cx, kHashColumns, image.width);
+      uint32_t x1 = cell_end(cx, kHashColumns, image.width, x0);
+
+      uint64_t sum = 0;
+      for (uint32_t y = y0; y < y1; ++y) {
+        const Color* row = pixels + size_t(y) * image.width;
+        for (uint32_t x = x0; x < x1; ++x) {
+          auto& c = row[x];
+          uint32_t l = 77 * c.r + 150 * c.g + 29 * c.b; // Rec. 601, 8.8 fixed point
+          sum += premultiplied ? l : l * c.a / 255;
+        }
+      }
+      luma[cy][cx] = uint32_t(sum / (uint64_t(x1 - x0) * (y1 - y0)));
+    }
+  }
+
+  uint32_t darkest = UINT32_MAX, brightest = 0;
+  for (auto& row : luma) {
+    for (auto l : row) {
+      darkest = std::min(darkest, l);
+      brightest = std::max(brightest, l);
+    }
+  }
+  if (brightest - darkest < kMinHashLumaRange) {
+    return 0;
+  }
+
+  uint64_t hash = 0;
+  for (uint32_t cy = 0; cy < kHashRows; ++cy) {
+    for (uint32_t cx = 0; cx + 1 < kHashColumns; ++cx) {
+      if (luma[cy][cx] < luma[cy][cx + 1]) {
+        hash |= uint64_t(1) << (cy * (kHashColumns - 1) + cx);
+      }
+    }
+  }
+  return hash;
+}
+
+std::vector<uint64_t> perceptual_hashes(const std::vector<Sprite>& images, bool premultiplied, ThreadPool* pool) {
+  std::vector<uint64_t> result(images.size());
+
+  constexpr size_t kGrain = 256;
+  parallel_for(pool, images.size(), kGrain, [&](size_t begin, size_t end) {
+    TRACE_SCOPE("perceptual_hashes");
+    for (size_t i = begin; i < end; ++i) {
+      result[i] = perceptual_hash(images[i], premultiplied);
+    }
+  });
+
+  return result;
+}
+
+const char* to_string(ImageKind kind) {
+  switch (kind) {
+    case ImageKind::Sprite: return "sprite";
+    case ImageKind::Tile:   return "tile";
+  }
+  return "unknown";
+}
+
+void SimilarityIndex::add(uint64_t hash, const ImageRef& ref) {
+  if (hash == 0) {
+    return;
+  }
+
+  m_hashes.push_back(hash);
+  m_refs.push_back(ref);
+}
+
+void SimilarityIndex::add(const Styles& styles, uint32_t style) {
+  auto add_images = [&](const std::vector<Sprite>& images, const std::vector<uint64_t>& hashes, ImageKind kind) {
+    for (size_t i = 0; i < images.size() && i < hashes.size(); ++i) {
+      add(hashes[i], {.style = style, .item = uint32_t(i), .kind = kind});
+    }
+  };
+
+  add_images(styles.sprites, styles.sprite_hashes, ImageKind::Sprite);
+  add_images(styles.tiles, styles.tile_hashes, ImageKind::Tile);
+}
+
+static uint32_t block_value(uint64_t hash, uint32_t block, uint32_t bits) {
+  return uint32_t(hash >> (block * bits)) & ((1u << bits) - 1);
+}
+
+void SimilarityIndex::build() {
+  TRACE_SCOPE("build_similarity_index");
+
+  // A counting sort of the entries by each block.
+  for (uint32_t block = 0; block < kBlocks; ++block) {
+    auto& offsets = m_offsets[block];
+    auto& entries = m_entries[block];
+
+    offsets.assign((size_t(1) << kBlockBits) + 1, 0);
+    for (auto hash : m_hashes) {
+      offsets[block_value(hash, block, kBlockBits) + 1]++;
+    }
+    for (size_t v = 1; v < offsets.size(); ++v) {
+      offsets[v] += offsets[v - 1];
+    }
+
+    std::vector<uint32_t> next(offsets.begin(), offsets.end() - 1);
+    entries.resize(m_hashes.size());
+    for (uint32_t entry = 0; entry < m_hashes.size(); ++entry) {
+      entries[next[block_value(m_hashes[entry], block, kBlockBits)]++] = entry;
+    }
+  }
+}
+
+void SimilarityIndex::clear() {
+  m_hashes.clear();
+  m_refs.clear();
+  for (uint32_t block = 0; block < kBlocks; ++block) {
+    m_offsets[block].clear();
+    m_entries[block].clear();
+  }
+}
+
+// for_each_neighbour calls fn with every value that differs from value in
+// at most radius of the bits [first_bit, bits), each value once.
+template <typename F>
+static void for_each_neighbour(uint32_t value, uint32_t radius, uint32_t first_bit, uint32_t bits, F&& fn) {
+  fn(value);
+  if (radius == 0) return;
+
+  for (uint32_t bit = first_bit; bit < bits; ++bit) {
+    for_each_neighbour(value ^ (1u << bit), radius - 1, bit + 1, bits, fn);
+  }
+}
+
+void SimilarityIndex::find(uint64_t hash, uint32_t distance, std::vector<SimilarImage>& out) const {
+  if (m_offsets[0].empty()) {
+    return;
+  }
+
+  uint32_t radius = std::min(distance / kBlocks, kBlockBits);
+
+  for (uint32_t block = 0; block < kBlocks; ++block) {
+    auto& offsets = m_offsets[block];
+    auto& entries = m_entries[block];
+
+    for_each_neighbour(block_value(hash, block, kBlockBits), radius, 0, kBlockBits, [&](uint32_t value) {
+      for (uint32_t k = offsets[value]; k < offsets[value + 1]; ++k) {
+        uint32_t entry = entries[k];
+        uint64_t other = m_hashes[entry];
+        uint32_t d = hash_distance(hash, other);
+        if (d > distance) continue;
+
+        // An entry that is as close in an earlier block was found there.
+        bool found = false;
+        for (uint32_t earlier = 0; earlier < block && !found; ++earlier) {
+          found = hash_distance(block_value(hash, earlier, kBlockBits), block_value(other, earlier, kBlockBits)) <= radius;
+        }
+        if (!found) {
+          out.push_back({.entry = entry, .distance = d});
+        }
+      }
+    });
+  }
+}
+
+std::vector<SimilarPair> SimilarityIndex::find_pairs(uint32_t distance, ThreadPool* pool) const {
+  TRACE_SCOPE("find_similar_pairs");
+
+  // Only entries already indexed take part, each range collects its own
+  // pairs in order.
+  size_t count = m_offsets[0].empty() ? 0 : m_entries[0].size();
+  constexpr size_t kGrain = 1024;
+  std::vector<std::vector<SimilarPair>> ranges((count + kGrain - 1) / kGrain);
+
+  parallel_for(pool, count, kGrain, [&](size_t begin, size_t end) {
+    std::vector<SimilarImage> similar;
+    auto& pairs = ranges[begin / kGrain];
+
+    for (size_t a = begin; a < end; ++a) {
+      similar.clear();
+      find(m_hashes[a], distance, similar);
+      std::sort(similar.begin(), similar.end(), [](const SimilarImage& x, const SimilarImage& y) { return x.entry < y.entry; });
+
+      for (auto& match : similar) {
+        if (match.entry > a) {
+          pairs.push_back({.a = uint32_t(a), .b = match.entry, .distance = match.distance});
+        }
+      }
+    }
+  });
+
+  std::vector<SimilarPair> result;
+  for (auto& pairs : ranges) {
+    result.insert(result.end(), pairs.begin(), pairs.end());
+  }
+  return result;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <bit>
+#include <vector>
+
+struct Sprite;
+struct Styles;
+class ThreadPool;
+
+// kMinHashLumaRange is the smallest difference between the brightest and
+// darkest averages of an image that perceptual_hash hashes, in 1/256 luma
+// steps. Below it the bits are set by noise, not by the picture.
+constexpr uint32_t kMinHashLumaRange = 8 * 256;
+
+// Perceptual hashes are 64-bit difference hashes (dHash): the image is
+// shrunk to 9x8 luma averages and bit y * 8 + x is set when average x of
+// row y is darker than average x + 1. Unlike hash64 of the pixels they
+// survive small edits, rescaling and most recolors, similar images differ
+// in a few bits.
+//
+// Luma is weighted by alpha, so the outline of a sprite counts as an edge.
+// Images with too little detail to tell apart hash to 0: fully transparent
+// ones and those whose averages span less than kMinHashLumaRange.
+uint64_t perceptual_hash(const Sprite& image, bool premultiplied = false);
+
+// perceptual_hashes hashes every image in parallel on pool, or on the
+// calling thread if pool is null.
+std::vector<uint64_t> perceptual_hashes(const std::vector<Sprite>& images, bool premultiplied, ThreadPool* pool);
+
+// hash_distance is the Hamming distance between two perceptual hashes.
+inline uint32_t hash_distance(uint64_t a, uint64_t b) {
+  return uint32_t(std::popcount(a ^ b));
+}
+
+enum class ImageKind : uint8_t {
+  Sprite,
+  Tile,
+};
+
+const char* to_string(ImageKind kind);
+
+// ImageRef names a sprite or tile of one of the styles in an index.
+struct ImageRef {
+  uint32_t style; // the number the style was added with
+  uint32_t item;  // sprite or tile index
+  ImageKind kind;
+};
+
+struct SimilarImage {
+  uint32_t entry; // into SimilarityIndex
+  uint32_t distance;
+};
+
+struct SimilarPair {
+  uint32_t a; // entries, a < b
+  uint32_t b;
+  uint32_t distance;
+};
+
+// SimilarityIndex finds the perceptual hashes within a Hamming distance of
+// a hash, over any number of styles. It is a multi-index hash: the 64 bits
+// are split into 4 blocks of 16 and every block has a table of the entries
+// by block value. Hashes within distance d agree to within d / 4 bits in
+// at least one block, so a search only looks at the table buckets that
+// close to the hash instead of at every entry.
+//
+//   SimilarityIndex index;
+//   for (uint32_t i = 0; i < styles.size(); ++i) index.add(styles[i], i);
+//   index.build();
+//   auto pairs = index.find_pairs(4, &pool);
+class SimilarityIndex {
+  private:
+    static constexpr uint32_t kBlocks = 4;
+    static constexpr uint32_t kBlockBits = 64 / kBlocks;
+
+    std::vector<uint64_t> m_hashes;
+    std::vector<ImageRef> m_refs;
+
+    // Entries sorted by the value of each block, those with value v are
+    // m_entries[block][m_offsets[block][v] .. m_offsets[block][v + 1]].
+    std::vector<uint32_t> m_offsets[kBlocks];
+    std::vector<uint32_t> m_entries[kBlocks];
+
+  public:
+    // add adds an entry, it can only be found once build has been called.
+    // Hash 0 is skipped: flat and low-detail images all hash to it and
+    // would match each other, and crowd the buckets every search looks at.
+    void add(uint64_t hash, const ImageRef& ref);
+
+    // add adds every sprite and tile of styles, which must have perceptual
+    // hashes, see Styles::build_perceptual_hashes.
+    void add(const Styles& styles, uint32_t style);
+
+    // build indexes every entry added so far.
+    void build();
+
+    void clear();
+
+    size_t size() const { return m_hashes.size(); }
+    uint64_t hash(size_t entry) const { return m_hashes[entry]; }
+    const ImageRef& ref(size_t entry) const { return m_refs[entry]; }
+
+    // find appends every entry within distance of hash to out, in no
+    // particular order.
+    void find(uint64_t hash, uint32_t distance, std::vector<SimilarImage>& out) const;
+
+    // find_pairs returns every pair of entries within distance of each
+    // other, sorted by entry, searching in parallel on pool if one is given.
+    std::vector<SimilarPair> find_pairs(uint32_t distance, ThreadPool* pool = nullptr) const;
+};
@@ -0,0 +1,342 @@
+#include "indexed_import.h"
+#include "thread_pool.h"
+#include "trace.h"
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <memory>
+
+// Pixels with alpha below this are transparent when importing with
+// IndexedImportOptions::transparent.
+constexpr uint8_t kAlphaThreshold = 128;
+
+// kOrderedSpread is how far, per channel, ordered dithering moves colors.
+constexpr int kOrderedSpread = 32;
+
+static const uint8_t kBayer8[8][8] = {
+  { 0, 32,  8, 40,  2, 34, 10, 42},
+  {48, 16, 56, 24, 50, 18, 58, 26},
+  {12, 44,  4, 36, 14, 46,  6, 38},
+  {60, 28, 52, 20, 62, 30, 54, 22},
+  { 3, 35, 11, 43,  1, 33,  9, 41},
+  {51, 19, 59, 27, 49, 17, 57, 25},
+  {15, 47,  7, 39, 13, 45,  5, 37},
+  {63, 31, 55, 23, 61, 29, 53, 21},
+};
+
+static uint32_t squared_distance(int r, int g, int b, const Color& c) {
+  int dr = r - c.r;
+  int dg = g - c.g;
+  int db = b - c.b;
+  return uint32_t(dr * dr + dg * dg + db * db);
+}
+
+PaletteLookup::PaletteLookup(const PhysicalPalette& palette, bool transparent) {
+  memcpy(m_colors, palette.colors, sizeof(m_colors));
+
+  // A color that repeats an earlier one is never the lowest nearest index.
+  std::vector<uint8_t> usable;
+  for (size_t i = transparent ? 1 : 0; i < kPhysicalPaletteSize; ++i) {
+    auto& c = m_colors[i];
+    bool repeated = false;
+    for (auto j : usable) {
+      repeated |= m_colors[j].r == c.r && m_colors[j].g == c.g && m_colors[j].b == c.b;
+    }
+    if (!repeated) usable.push_back(uint8_t(i));
+  }
+
+  // Squared distances from a channel value to the nearest and farthest
+  // value of each cell along an axis.
+  constexpr int kCellSize = 256 / kCellsPerAxis;
+  static const auto kAxisDistances = [] {
+    struct Distances {
+      uint32_t nearest[kCellsPerAxis][256];
+      uint32_t farthest[kCellsPerAxis][256];
+    };
+    auto d = std::make_unique<Distances>();
+    for (int cell = 0; cell < int(kCellsPerAxis); ++cell) {
+      int lo = cell * kCellSize, hi = lo + kCellSize - 1;
+      for (int v = 0; v < 256; ++v) {
+        int nearest = v < lo ? lo - v : v > hi ? v - hi : 0;
+        int farthest = std::max(std::abs(v - lo), std::abs(v - hi));
+        d->nearest[cell][v] = uint32_t(nearest * nearest);
+        d->farthest[cell][v] = uint32_t(farthest * farthest);
+      }
+    }
+    return d;
+  }();
+
+  size_t n = usable.size();
+  std::vector<uint32_t> nearest_rg(n), farthest_rg(n), nearest(n);
+
+  // Colors whose nearest point in a cell is farther than the farthest point
+  // of another color can't be nearest anywhere in the cell.
+  for (uint32_t r = 0; r < kCellsPerAxis; ++r) {
+    for (uint32_t g = 0; g < kCellsPerAxis; ++g) {
+      for (size_t k = 0; k < n; ++k) {
+        auto& c = m_colors[usable[k]];
+        nearest_rg[k] = kAxisDistances->nearest[r][c.r] + kAxisDistances->nearest[g][c.g];
+        farthest_rg[k] = kAxisDistances->farthest[r][c.r] + kAxisDistances->farthest[g][c.g];
+      }
+
+      for (uint32_t b = 0; b < kCellsPerAxis; ++b) {
+        uint32_t bound = UINT32_MAX;
+        for (size_t k = 0; k < n; ++k) {
+          auto& c = m_colors[usable[k]];
+          nearest[k] = nearest_rg[k] + kAxisDistances->nearest[b][c.b];
+          bound = std::min(bound, farthest_rg[k] + kAxisDistances->farthest[b][c.b]);
+        }
+
+        auto& cell = m_cells[r << (2 * kCellBits) | g << kCellBits | b];
+        cell.first = uint32_t(m_candidates.size());
+        for (size_t k = 0; k < n; ++k) {
+          if (nearest[k] <= bound) m_candidates.push_back(usable[k]);
+        }
+        cell.count = uint32_t(m_candidates.size()) - cell.first;
+      }
+    }
+  }
+}
+
+uint8_t PaletteLookup::nearest(int r, int g, int b, uint32_t* distance) const {
+  r = std::clamp(r, 0, 255);
+  g = std::clamp(g, 0, 255);
+  b = std::clamp(b, 0, 255);
+
+  auto& cell = m_cells[uint32_t(r >> (8 - kCellBits)) << (2 * kCellBits) | uint32_t(g >> (8 - kCellBits)) << kCellBits | uint32_t(b >> (8 - kCellBits))];
+
+  uint32_t best = UINT32_MAX;
+  uint8_t index = 0;
+  for (uint32_t k = 0; k < cell.count; ++k) {
+    uint8_t candidate = m_candidates[cell.first + k];
+    uint32_t d = squared_distance(r, g, b, m_colors[candidate]);
+    if (d < best) {
+      best = d;
+      index = candidate;
+    }
+  }
+
+  if (distance) *distance = best;
+  return index;
+}
+
+void convert_to_indexed(const RgbaImage& image, const PaletteLookup& lookup, const IndexedImportOptions& options, IndexedImage& out) {
+  out.width = image.width;
+  out.height = image.height;
+  out.indices.assign(size_t(image.width) * image.height, 0);
+  out.error = 0;
+
+  // Floyd-Steinberg carries the error of this row and the next, per channel,
+  // with a pixel of padding on both sides.
+  std::vector<int> errors;
+  int* row_errors = nullptr;
+  int* next_errors = nullptr;
+  if (options.dither == Dither::FloydSteinberg) {
+    errors.assign(2 * (image.width + 2) * 3, 0);
+    row_errors = errors.data();
+    next_errors = errors.data() + (image.width + 2) * 3;
+  }
+
+  for (uint32_t y = 0; y < image.height; ++y) {
+    for (uint32_t x = 0; x < image.width; ++x) {
+      size_t p = size_t(y) * image.width + x;
+      const Color& c = image.pixels[p];
+      if (options.transparent && c.a < kAlphaThreshold) {
+        continue;
+      }
+
+      int r = c.r, g = c.g, b = c.b;
+      if (options.dither == Dither::Ordered) {
+        int offset = (int(kBayer8[y % 8][x % 8]) * 2 - 63) * kOrderedSpread / 128;
+        r += offset;
+        g += offset;
+        b += offset;
+      } else if (row_errors) {
+        int* e = row_errors + (x + 1) * 3;
+        r = std::clamp(r + e[0], 0, 255);
+        g = std::clamp(g + e[1], 0, 255);
+        b = std::clamp(b + e[2], 0, 255);
+      }
+
+      uint8_t index = lookup.nearest(r, g, b);
+      out.indices[p] = index;
+
+      const Color& chosen = lookup.color(index);
+      out.error += squared_distance(c.r, c.g, c.b, chosen);
+
+      if (row_errors) {
+        const int diff[3] = {r - chosen.r, g - chosen.g, b - chosen.b};
+        for (int ch = 0; ch < 3; ++ch) {
+          row_errors[(x + 2) * 3 + ch] += diff[ch] * 7 / 16;
+          next_errors[(x + 0) * 3 + ch] += diff[ch] * 3 / 16;
+          next_errors[(x + 1) * 3 + ch] += diff[ch] * 5 / 16;
+          next_errors[(x + 2) * 3 + ch] += diff[ch] * 1 / 16;
+        }
+      }
+    }
+
+    if (row_errors) {
+      std::swap(row_errors, next_errors);
+      std::fill(next_errors, next_errors + (image.width + 2) * 3, 0);
+    }
+  }
+}
+
+std::vector<IndexedImage> import_indexed(std::span<const IndexedImportJob> jobs, std::span<const PhysicalPalette* const> palettes, const IndexedImportOptions& options) {
+  TRACE_SCOPE("import_indexed");
+
+  std::vector<uint8_t> used(palettes.size());
+  for (auto& job : jobs) {
+    for (auto palette : job.palettes) {
+      if (palette < palettes.size()) used[palette] = 1;
+    }
+  }
+
+  std::vector<uint16_t> used_palettes;
+  for (size_t i = 0; i < used.size(); ++i) {
+    if (used[i]) used_palettes.push_back(uint16_t(i));
+  }
+
+  std::vector<std::unique_ptr<PaletteLookup>> lookups(palettes.size());
+  parallel_for(options.pool, used_palettes.size(), 1, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      auto palette = used_palettes[i];
+      lookups[palette] = std::make_unique<PaletteLookup>(*palettes[palette], options.transparent);
+    }
+  });
+
+  IndexedImportOptions undithered = options;
+  undithered.dither = Dither::None;
+
+  std::vector<IndexedImage> results(jobs.size());
+  parallel_for(options.pool, jobs.size(), 8, [&](size_t begin, size_t end) {
+    IndexedImage candidate;
+
+    for (size_t i = begin; i < end; ++i) {
+      auto& job = jobs[i];
+      auto& result = results[i];
+      bool found = false;
+
+      // The best palette is the one with the least error without dithering,
+      // dithering would only blur the difference.
+      for (auto palette : job.palettes) {
+        if (palette >= palettes.size()) continue;
+
+        convert_to_indexed(job.image, *lookups[palette], undithered, candidate);
+        if (!found || candidate.error < result.error) {
+          std::swap(result, candidate);
+          result.palette = palette;
+          found = true;
+        }
+      }
+
+      if (found && options.dither != Dither::None) {
+        uint16_t palette = result.palette;
+        convert_to_indexed(job.image, *lookups[palette], options, result);
+        result.palette = palette;
+      }
+    }
+  });
+
+  return results;
+}
+
+static size_t import_items(StyleSnapshot& snapshot, std::span<const RgbaImport> imports, const IndexedImportOptions& options, bool tiles) {
+  std::vector<const PhysicalPalette*> palettes(snapshot.palettes.size());
+  for (size_t i = 0; i < palettes.size(); ++i) {
+    palettes[i] = &snapshot.palettes[i];
+  }
+
+  size_t item_count = tiles ? snapshot.tiles.size() : snapshot.sprites.size();
+  size_t palette_base = tiles ? snapshot.base->palette_bases.tile.offset : snapshot.base->palette_bases.sprite.offset;
+
+  // Items that can't be replaced get no palette and aren't converted.
+  std::vector<IndexedImportJob> jobs(imports.size());
+  for (size_t i = 0; i < imports.size(); ++i) {
+    auto& import = imports[i];
+    bool ok = import.item < item_count && palette_base + import.item < kVirtualPaletteTableSize && (tiles ?
+      import.image.width == kTileDim && import.image.height == kTileDim :
+      import.image.width <= UINT8_MAX && import.image.height <= UINT8_MAX);
+    if (!ok) continue;
+
+    jobs[i].image = import.image;
+    jobs[i].palettes = import.palettes;
+    if (jobs[i].palettes.empty()) {
+      jobs[i].palettes.push_back(snapshot.virtual_palettes[palette_base + import.item]);
+    }
+  }
+
+  auto results = import_indexed(jobs, palettes, options);
+
+  std::vector<uint8_t> accepted(imports.size());
+  for (size_t i = 0; i < imports.size(); ++i) {
+    auto& result = results[i];
+    accepted[i] = result.width == imports[i].image.width && result.height == imports[i].image.height && !jobs[i].palettes.empty();
+  }
+
+  // Sprites get their new sizes in one batch, so the store is repacked at
+  // most once however many of them grow. Sprites that deltas apply to keep
+  // their size, and the last import of a sprite wins.
+  if (!tiles) {
+    std::vector<uint8_t> fixed_size(item_count);
+    for (auto& set : snapshot.base->deltas) {
+      if (set.sprite < item_count) fixed_size[set.sprite] = 1;
+    }
+
+    std::vector<size_t> latest(item_count, SIZE_MAX);
+    for (size_t i = 0; i < imports.size(); ++i) {
+      if (!accepted[i]) continue;
+      auto& sprite = snapshot.sprites[imports[i].item];
+      if (fixed_size[imports[i].item] && (results[i].width != sprite.width || results[i].height != sprite.height)) {
+        accepted[i] = 0;
+        continue;
+      }
+      if (latest[imports[i].item] != SIZE_MAX) {
+        accepted[latest[imports[i].item]] = 0;
+      }
+      latest[imports[i].item] = i;
+    }
+
+    std::vector<SpriteResize> resizes;
+    for (size_t i = 0; i < imports.size(); ++i) {
+      if (!accepted[i]) continue;
+      resizes.push_back({.sprite = imports[i].item, .width = uint8_t(results[i].width), .height = uint8_t(results[i].height)});
+    }
+    if (!snapshot.resize_sprites(resizes)) {
+      return 0;
+    }
+  }
+
+  size_t replaced = 0;
+  for (size_t i = 0; i < imports.size(); ++i) {
+    auto& import = imports[i];
+    auto& result = results[i];
+    if (!accepted[i]) {
+      continue;
+    }
+
+    if (tiles) {
+      memcpy(snapshot.tiles.edit(import.item).colors, result.indices.data(), sizeof(Tile::colors));
+    } else {
+      snapshot.write_sprite(import.item, result.indices.data());
+    }
+
+    size_t virtual_palette = palette_base + import.item;
+    if (snapshot.virtual_palettes[virtual_palette] != result.palette) {
+      snapshot.virtual_palettes.edit(virtual_palette) = result.palette;
+    }
+    ++replaced;
+  }
+
+  return replaced;
+}
+
+size_t import_sprites_rgba(StyleSnapshot& snapshot, std::span<const RgbaImport> imports, const IndexedImportOptions& options) {
+  TRACE_SCOPE("import_sprites_rgba");
+  return import_items(snapshot, imports, options, false);
+}
+
+size_t import_tiles_rgba(StyleSnapshot& snapshot, std::span<const RgbaImport> imports, const IndexedImportOptions& options) {
+  TRACE_SCOPE("import_tiles_rgba");
+  return import_items(snapshot, imports, options, true);
+}
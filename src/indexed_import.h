@@ -0,0 +1,109 @@
+#pragma once
+
+#include "style_format.h"
+#include "style_snapshot.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <span>
+#include <vector>
+
+class ThreadPool;
+
+// Indexed import converts RGBA images, e.g. sprites edited in an external
+// tool, back into palette indices of a style's physical palettes.
+
+enum class Dither : uint8_t {
+  None,
+  Ordered,        // 8x8 Bayer matrix, stable when an image is edited and imported again
+  FloydSteinberg, // error diffusion, smoother gradients
+};
+
+struct IndexedImportOptions {
+  Dither dither = Dither::None;
+
+  // Palette index 0 is transparent, as in sprites and in tiles drawn flat:
+  // pixels with alpha below 128 become index 0 and other pixels never do.
+  // Otherwise alpha is ignored and every index is used.
+  bool transparent = true;
+
+  // Used to convert images in parallel when set.
+  ThreadPool* pool = nullptr;
+};
+
+// PaletteLookup finds the nearest color of a palette, by squared RGB
+// distance, in a few comparisons. RGB space is split into 8x8x8 cells and
+// each cell lists the only palette colors that can be nearest to a color
+// inside it. Finer cells hold fewer candidates but take longer to build
+// than a typical import spends looking colors up.
+class PaletteLookup {
+  private:
+    static constexpr uint32_t kCellBits = 3;
+    static constexpr uint32_t kCellsPerAxis = 1 << kCellBits;
+
+    struct Cell {
+      uint32_t first; // into m_candidates
+      uint32_t count;
+    };
+
+    Color m_colors[kPhysicalPaletteSize] = { };
+    Cell m_cells[kCellsPerAxis * kCellsPerAxis * kCellsPerAxis] = { };
+    std::vector<uint8_t> m_candidates;
+
+  public:
+    PaletteLookup() = default;
+    PaletteLookup(const PhysicalPalette& palette, bool transparent);
+
+    // nearest returns the index of the palette color nearest to r, g, b, the
+    // lowest one when several are as near. distance is set to the squared
+    // distance to it.
+    uint8_t nearest(int r, int g, int b, uint32_t* distance = nullptr) const;
+
+    const Color& color(uint8_t index) const { return m_colors[index]; }
+};
+
+// RgbaImage is width x height RGBA pixels with straight alpha.
+struct RgbaImage {
+  const Color* pixels;
+  uint32_t width;
+  uint32_t height;
+};
+
+struct IndexedImage {
+  std::vector<uint8_t> indices; // width x height
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint16_t palette = 0; // physical palette the indices refer to
+  uint64_t error = 0;   // summed squared RGB error of the opaque pixels
+};
+
+// convert_to_indexed converts image to the palette of lookup. Sets
+// everything in out but the palette.
+void convert_to_indexed(const RgbaImage& image, const PaletteLookup& lookup, const IndexedImportOptions& options, IndexedImage& out);
+
+// IndexedImportJob is an image and the physical palettes it may use.
+struct IndexedImportJob {
+  RgbaImage image;
+  std::vector<uint16_t> palettes;
+};
+
+// import_indexed converts the images of jobs, each to the allowed palette
+// it fits best, i.e. with the least error before dithering. The lookups of
+// every palette used are built once and shared by the images. palettes
+// holds each physical palette by index.
+std::vector<IndexedImage> import_indexed(std::span<const IndexedImportJob> jobs, std::span<const PhysicalPalette* const> palettes, const IndexedImportOptions& options);
+
+// RgbaImport replaces sprite or tile item of a snapshot with image. An empty
+// palettes list keeps the palette the item has.
+struct RgbaImport {
+  size_t item;
+  RgbaImage image;
+  std::vector<uint16_t> palettes;
+};
+
+// import_sprites_rgba and import_tiles_rgba convert the images of imports
+// and write them into snapshot. Items whose palette changes get their
+// virtual palette entry pointed at the new one. Tiles must be 64x64, sprites
+// at most 255x255. Sprites are resized in one batch, see
+// StyleSnapshot::resize_sprites. Returns the number of items replaced.
+size_t import_sprites_rgba(StyleSnapshot& snapshot, std::span<const RgbaImport> imports, const IndexedImportOptions& options);
+size_t import_tiles_rgba(StyleSnapshot& snapshot, std::span<const RgbaImport> imports, const IndexedImportOptions& options);
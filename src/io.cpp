@@ -1,5 +1,14 @@
 #include "io.h"
 
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 bool File::open(const char* filename) {
   m_file = fopen(filename, "rb");
   return m_file != nullptr;
@@ -36,3 +45,212 @@ bool File::read(void* buf, size_t size) {
 
   return ok;
 }
+
+MappedFile::~MappedFile() {
+  close();
+}
+
+#if defined(_WIN32)
+
+bool MappedFile::open(const char* filename) {
+  close();
+
+  m_file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (m_file == INVALID_HANDLE_VALUE) {
+    m_file = nullptr;
+    return false;
+  }
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0) {
+    close();
+    return false;
+  }
+
+  m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!m_mapping) {
+    close();
+    return false;
+  }
+
+  m_data = static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+  if (!m_data) {
+    close();
+    return false;
+  }
+
+  m_size = static_cast<size_t>(size.QuadPart);
+  return true;
+}
+
+void MappedFile::close() {
+  if (m_data) UnmapViewOfFile(m_data);
+  if (m_mapping) CloseHandle(m_mapping);
+  if (m_file) CloseHandle(m_file);
+  m_data = nullptr;
+  m_size = 0;
+  m_mapping = nullptr;
+  m_file = nullptr;
+}
+
+#else
+
+bool MappedFile::open(const char* filename) {
+  close();
+
+  int fd = ::open(filename, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    ::close(fd);
+    return false;
+  }
+
+  // The mapping keeps the file alive, the descriptor isn't needed anymore.
+  void* data = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+
+  m_data = static_cast<const uint8_t*>(data);
+  m_size = size_t(st.st_size);
+  return true;
+}
+
+void MappedFile::close() {
+  if (m_data) {
+    munmap(const_cast<uint8_t*>(m_data), m_size);
+    m_data = nullptr;
+    m_size = 0;
+  }
+}
+
+#endif
+
+SharedMemory::~SharedMemory() {
+  close();
+}
+
+#if defined(_WIN32)
+
+bool SharedMemory::create(const char* name, size_t size) {
+  close();
+
+  m_mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, DWORD(uint64_t(size) >> 32), DWORD(size), name);
+  if (!m_mapping) {
+    return false;
+  }
+
+  m_data = static_cast<uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_WRITE, 0, 0, size));
+  if (!m_data) {
+    close();
+    return false;
+  }
+
+  m_size = size;
+  return true;
+}
+
+bool SharedMemory::open(const char* name, bool writable) {
+  close();
+
+  DWORD access = writable ? FILE_MAP_WRITE : FILE_MAP_READ;
+  m_mapping = OpenFileMappingA(access, FALSE, name);
+  if (!m_mapping) {
+    return false;
+  }
+
+  m_data = static_cast<uint8_t*>(MapViewOfFile(m_mapping, access, 0, 0, 0));
+  MEMORY_BASIC_INFORMATION info;
+  if (!m_data || VirtualQuery(m_data, &info, sizeof(info)) == 0) {
+    close();
+    return false;
+  }
+
+  m_size = info.RegionSize;
+  return true;
+}
+
+void SharedMemory::close() {
+  if (m_data) UnmapViewOfFile(m_data);
+  if (m_mapping) CloseHandle(m_mapping);
+  m_data = nullptr;
+  m_size = 0;
+  m_mapping = nullptr;
+}
+
+void SharedMemory::remove(const char*) {
+}
+
+#else
+
+bool SharedMemory::create(const char* name, size_t size) {
+  close();
+
+  shm_unlink(name);
+  int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+
+  if (ftruncate(fd, off_t(size)) != 0) {
+    ::close(fd);
+    shm_unlink(name);
+    return false;
+  }
+
+  void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    shm_unlink(name);
+    return false;
+  }
+
+  m_data = static_cast<uint8_t*>(data);
+  m_size = size;
+  return true;
+}
+
+bool SharedMemory::open(const char* name, bool writable) {
+  close();
+
+  int fd = shm_open(name, (writable ? O_RDWR : O_RDONLY) | O_CLOEXEC, 0);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    ::close(fd);
+    return false;
+  }
+
+  int protection = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+  void* data = mmap(nullptr, size_t(st.st_size), protection, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+
+  m_data = static_cast<uint8_t*>(data);
+  m_size = size_t(st.st_size);
+  return true;
+}
+
+void SharedMemory::close() {
+  if (m_data) {
+    munmap(m_data, m_size);
+    m_data = nullptr;
+    m_size = 0;
+  }
+}
+
+void SharedMemory::remove(const char* name) {
+  shm_unlink(name);
+}
+
+#endif
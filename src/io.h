@@ -18,6 +18,59 @@ class File {
     bool read(void* buf, size_t size);
 };
 
+// MappedFile maps a whole file read-only into memory.
+class MappedFile {
+  private:
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+#if defined(_WIN32)
+    void* m_file = nullptr;
+    void* m_mapping = nullptr;
+#endif
+
+  public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    bool open(const char* filename);
+    void close();
+
+    const uint8_t* data() const { return m_data; }
+    size_t size() const { return m_size; }
+};
+
+// SharedMemory is a named shared memory segment, created writable by one
+// process and opened read-only by others.
+class SharedMemory {
+  private:
+    uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+#if defined(_WIN32)
+    void* m_mapping = nullptr;
+#endif
+
+  public:
+    SharedMemory() = default;
+    SharedMemory(const SharedMemory&) = delete;
+    SharedMemory& operator=(const SharedMemory&) = delete;
+    ~SharedMemory();
+
+    // create replaces any segment called name with a zeroed one of size bytes.
+    bool create(const char* name, size_t size);
+    bool open(const char* name, bool writable = false);
+    void close();
+
+    // remove unlinks name; mappings that are open stay valid. Segments on
+    // Windows go away with their last handle, so this does nothing there.
+    static void remove(const char* name);
+
+    const uint8_t* data() const { return m_data; }
+    uint8_t* data() { return m_data; }
+    size_t size() const { return m_size; }
+};
+
 struct Reader {
   uint8_t* data;
   size_t size;
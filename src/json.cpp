@@ -0,0 +1,106 @@
+#include "json.h"
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+
+void JsonWriter::separate() {
+  if (m_after_key) {
+    m_after_key = false;
+    return;
+  }
+
+  if (!m_first.empty()) {
+    if (!m_first.back()) {
+      m_out += ',';
+    }
+    m_first.back() = false;
+  }
+}
+
+void JsonWriter::string(const char* s) {
+  m_out += '"';
+  for (; *s; ++s) {
+    unsigned char c = static_cast<unsigned char>(*s);
+    switch (c) {
+      case '"':  m_out += "\\\""; break;
+      case '\\': m_out += "\\\\"; break;
+      case '\n': m_out += "\\n"; break;
+      case '\r': m_out += "\\r"; break;
+      case '\t': m_out += "\\t"; break;
+      default:
+        if (c < 0x20) {
+          char buf[8];
+          snprintf(buf, sizeof(buf), "\\u%04x", c);
+          m_out += buf;
+        } else {
+          m_out += char(c);
+        }
+        break;
+    }
+  }
+  m_out += '"';
+}
+
+void JsonWriter::begin_object() {
+  separate();
+  m_out += '{';
+  m_first.push_back(true);
+}
+
+void JsonWriter::end_object() {
+  m_out += '}';
+  m_first.pop_back();
+}
+
+void JsonWriter::begin_array() {
+  separate();
+  m_out += '[';
+  m_first.push_back(true);
+}
+
+void JsonWriter::end_array() {
+  m_out += ']';
+  m_first.pop_back();
+}
+
+void JsonWriter::key(const char* name) {
+  separate();
+  string(name);
+  m_out += ':';
+  m_after_key = true;
+}
+
+void JsonWriter::value(const char* s) {
+  separate();
+  string(s);
+}
+
+void JsonWriter::value(bool b) {
+  separate();
+  m_out += b ? "true" : "false";
+}
+
+void JsonWriter::value(int64_t n) {
+  separate();
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%" PRId64, n);
+  m_out += buf;
+}
+
+void JsonWriter::value(uint64_t n) {
+  separate();
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%" PRIu64, n);
+  m_out += buf;
+}
+
+void JsonWriter::value(double n) {
+  separate();
+  if (!isfinite(n)) {
+    m_out += "null";
+    return;
+  }
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%.9g", n);
+  m_out += buf;
+}
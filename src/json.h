@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// JsonWriter builds compact JSON text. Commas are inserted automatically,
+// inside objects every value must be preceded by a key.
+class JsonWriter {
+  private:
+    std::string m_out;
+    std::vector<bool> m_first; // per open object/array, nothing written yet
+    bool m_after_key = false;
+
+    void separate();
+    void string(const char* s);
+
+  public:
+    void begin_object();
+    void end_object();
+    void begin_array();
+    void end_array();
+
+    void key(const char* name);
+
+    void value(const char* s);
+    void value(const std::string& s) { value(s.c_str()); }
+    void value(bool b);
+    void value(int64_t n);
+    void value(uint64_t n);
+    void value(int n) { value(int64_t(n)); }
+    void value(unsigned n) { value(uint64_t(n)); }
+    void value(double n);
+
+    template <typename T>
+    void field(const char* name, const T& v) {
+      key(name);
+      value(v);
+    }
+
+    const std::string& str() const { return m_out; }
+};
@@ -40,38 +40,20 @@ LRESULT CALLBACK Win32WindowProc(HWND window, UINT message, WPARAM wparam, LPARA
   return result;
 }
 
-#if 0
-auto create_sprite_filename = [](SpriteBases& bases, size_t sprite_index) {
-  if (sprite_index >= bases.car.offset && sprite_index < bases.ped.offset) {
-    return std::format("sprites/car_{}.png", sprite_index - bases.car.offset);
-  }
-
-  if (sprite_index >= bases.ped.offset && sprite_index < bases.code.offset) {
-    return std::format("sprites/ped_{}.png", sprite_index - bases.ped.offset);
-  }
-
-  if (sprite_index >= bases.code.offset && sprite_index < bases.map.offset) {
-    return std::format("sprites/code_{}.png", sprite_index - bases.code.offset);
-  }
-
-  if (sprite_index >= bases.map.offset && sprite_index < bases.user.offset) {
-    return std::format("sprites/map_{}.png", sprite_index - bases.map.offset);
-  }
-
-  if (sprite_index >= bases.user.offset && sprite_index < bases.font.offset) {
-    return std::format("sprites/user_{}.png", sprite_index - bases.user.offset);
+static std::string create_sprite_filename(const Styles& styles, size_t sprite_index) {
+  SpriteRef ref;
+  if (!styles.sprite_catalog.find(sprite_index, ref)) {
+    return std::format("sprites/sprite_{}.png", sprite_index);
   }
+  return std::format("sprites/{}_{}.png", to_string(ref.kind), ref.index);
+}
 
-  return std::format("sprites/font_{}.png", sprite_index - bases.font.offset);
-};
-#endif
-
-static void dump_sprites(const std::vector<Sprite>& sprites) {
+static void dump_sprites(const Styles& styles) {
   std::filesystem::create_directory("sprites");
 
-  for (size_t i = 0; i < sprites.size(); ++i) {
-    auto& s = sprites[i];
-    auto filename = std::format("sprites/sprite_{}.png", i);
+  for (size_t i = 0; i < styles.sprites.size(); ++i) {
+    auto& s = styles.sprites[i];
+    auto filename = create_sprite_filename(styles, i);
     stbi_write_png(filename.c_str(), s.width, s.height, 4, s.pixels.data(), 4 * s.width);
   }
 }
@@ -118,7 +100,7 @@ int CALLBACK wWinMain(HINSTANCE instance, HINSTANCE previousInstance, LPWSTR cmd
 
   Styles styles;
   if (styles.load("../../../../data/wil.sty")) {
-    //dump_sprites(styles.sprites);
+    //dump_sprites(styles);
     //dump_tiles(styles.tiles);
     dump_deltas(styles.deltas, styles.delta_sprites);
   }
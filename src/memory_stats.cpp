@@ -0,0 +1,196 @@
+#include "memory_stats.h"
+#include "styles.h"
+#include "json.h"
+#include <unordered_set>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#elif defined(__GLIBC__)
+#include <malloc.h>
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#endif
+
+const char* to_string(MemoryCategory category) {
+  switch (category) {
+    case MemoryCategory::FileBuffer:      return "file_buffer";
+    case MemoryCategory::Palettes:        return "palettes";
+    case MemoryCategory::VirtualPalettes: return "virtual_palettes";
+    case MemoryCategory::Tiles:           return "tiles";
+    case MemoryCategory::Sprites:         return "sprites";
+    case MemoryCategory::Deltas:          return "deltas";
+    case MemoryCategory::Metadata:        return "metadata";
+    case MemoryCategory::Caches:          return "caches";
+    case MemoryCategory::Count:           break;
+  }
+  return "unknown";
+}
+
+size_t allocated_size(const void* ptr, size_t fallback) {
+  (void)fallback;
+  if (!ptr) {
+    return 0;
+  }
+#if defined(_WIN32)
+  return _msize(const_cast<void*>(ptr));
+#elif defined(__GLIBC__)
+  return malloc_usable_size(const_cast<void*>(ptr));
+#elif defined(__APPLE__)
+  return malloc_size(ptr);
+#else
+  return fallback;
+#endif
+}
+
+template <typename T>
+static MemoryUsage vector_memory(const std::vector<T>& v) {
+  return {
+    .logical = v.size() * sizeof(T),
+    .allocated = allocated_size(v.data(), v.capacity() * sizeof(T)),
+  };
+}
+
+// ImageCounter counts every distinct pixel buffer once.
+struct ImageCounter {
+  std::unordered_set<const void*> seen;
+
+  MemoryUsage count(const std::vector<Sprite>& images) {
+    MemoryUsage result = vector_memory(images);
+    for (auto& image : images) {
+      result += pixels(image.pixels);
+    }
+    return result;
+  }
+
+  MemoryUsage pixels(const Pixels& pixels) {
+    auto& buffer = pixels.buffer();
+    if (!buffer || !seen.insert(buffer.get()).second) {
+      return { };
+    }
+    return vector_memory(*buffer);
+  }
+};
+
+static MemoryUsage mip_memory(const std::vector<std::vector<Sprite>>& mips, ImageCounter& counter) {
+  MemoryUsage result = vector_memory(mips);
+  for (auto& chain : mips) {
+    result += counter.count(chain);
+  }
+  return result;
+}
+
+static MemoryUsage mask_memory(const std::vector<CollisionMask>& masks) {
+  MemoryUsage result = vector_memory(masks);
+  for (auto& mask : masks) {
+    result += vector_memory(mask.bits);
+  }
+  return result;
+}
+
+static MemoryUsage metadata_memory(const StyleSource& source) {
+  MemoryUsage result = vector_memory(source.chunks);
+  result += {sizeof(PaletteBases) + sizeof(SpriteBases), sizeof(PaletteBases) + sizeof(SpriteBases)};
+  result += vector_memory(source.font_bases);
+  result += vector_memory(source.map_objects);
+  result += vector_memory(source.recyclable_cars);
+
+  result += vector_memory(source.surfaces);
+  for (auto& surface : source.surfaces) {
+    result += vector_memory(surface);
+  }
+
+  result += vector_memory(source.cars);
+  for (auto& car : source.cars) {
+    result += vector_memory(car.remap);
+    result += vector_memory(car.doors);
+  }
+
+  return result;
+}
+
+static void add_source(StyleMemoryStats& stats, const StyleSource& source) {
+  stats[MemoryCategory::Palettes] += vector_memory(source.palettes);
+  stats[MemoryCategory::VirtualPalettes] += {sizeof(VirtualPaletteTable), sizeof(VirtualPaletteTable)};
+  stats[MemoryCategory::Tiles] += vector_memory(source.tiles);
+  stats[MemoryCategory::Sprites] += vector_memory(source.sprite_store);
+  stats[MemoryCategory::Sprites] += vector_memory(source.sprites);
+  stats[MemoryCategory::Deltas] += vector_memory(source.delta_store);
+  stats[MemoryCategory::Deltas] += vector_memory(source.deltas);
+  for (auto& set : source.deltas) {
+    stats[MemoryCategory::Deltas] += vector_memory(set.sizes);
+  }
+  stats[MemoryCategory::Metadata] += metadata_memory(source);
+}
+
+static void sum(StyleMemoryStats& stats) {
+  stats.total = { };
+  for (size_t i = 0; i < size_t(MemoryCategory::Count); ++i) {
+    if (MemoryCategory(i) != MemoryCategory::FileBuffer) {
+      stats.total += stats.categories[i];
+    }
+  }
+}
+
+MemoryUsage source_memory(const StyleSource& source) {
+  StyleMemoryStats stats;
+  add_source(stats, source);
+  sum(stats);
+  return stats.total;
+}
+
+MemoryUsage image_memory(const std::vector<Sprite>& images) {
+  ImageCounter counter;
+  return counter.count(images);
+}
+
+StyleMemoryStats memory_stats(const Styles& styles) {
+  StyleMemoryStats stats;
+  add_source(stats, styles.source);
+
+  ImageCounter counter;
+  stats[MemoryCategory::Tiles] += counter.count(styles.tiles);
+  stats[MemoryCategory::Sprites] += counter.count(styles.sprites);
+  stats[MemoryCategory::Deltas] += counter.count(styles.deltas);
+  stats[MemoryCategory::Deltas] += vector_memory(styles.delta_sprites);
+  stats[MemoryCategory::Metadata] += vector_memory(styles.sprite_catalog.kinds);
+
+  stats[MemoryCategory::Caches] += mip_memory(styles.sprite_mips, counter);
+  stats[MemoryCategory::Caches] += mip_memory(styles.tile_mips, counter);
+  stats[MemoryCategory::Caches] += mask_memory(styles.sprite_masks);
+  stats[MemoryCategory::Caches] += mask_memory(styles.delta_masks);
+  stats[MemoryCategory::Caches] += vector_memory(styles.sprite_hashes);
+  stats[MemoryCategory::Caches] += vector_memory(styles.tile_hashes);
+
+  stats[MemoryCategory::FileBuffer] = styles.file_buffer;
+
+  sum(stats);
+  stats.peak_load_bytes = styles.peak_load_bytes;
+  return stats;
+}
+
+std::string to_json(const StyleMemoryStats& stats) {
+  JsonWriter json;
+  json.begin_object();
+
+  json.key("categories");
+  json.begin_object();
+  for (size_t i = 0; i < size_t(MemoryCategory::Count); ++i) {
+    json.key(to_string(MemoryCategory(i)));
+    json.begin_object();
+    json.field("logical", stats.categories[i].logical);
+    json.field("allocated", stats.categories[i].allocated);
+    json.end_object();
+  }
+  json.end_object();
+
+  json.key("total");
+  json.begin_object();
+  json.field("logical", stats.total.logical);
+  json.field("allocated", stats.total.allocated);
+  json.end_object();
+
+  json.field("peak_load_bytes", stats.peak_load_bytes);
+
+  json.end_object();
+  return json.str();
+}
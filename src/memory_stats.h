@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+struct Styles;
+struct StyleSource;
+struct Sprite;
+
+enum class MemoryCategory {
+  FileBuffer,      // style file read by the last load, released since and not in the total
+  Palettes,        // physical palettes
+  VirtualPalettes, // palette index table
+  Tiles,           // indexed and RGBA tiles
+  Sprites,         // indexed and RGBA sprites
+  Deltas,          // indexed and RGBA deltas
+  Metadata,        // chunk directory, bases, cars, map objects, surfaces
+  Caches,          // mip levels, collision masks and perceptual hashes
+
+  Count
+};
+
+const char* to_string(MemoryCategory category);
+
+// MemoryUsage counts bytes both as stored (logical) and as taken from the
+// allocator (allocated), which includes unused capacity and the allocator's
+// rounding.
+struct MemoryUsage {
+  size_t logical = 0;
+  size_t allocated = 0;
+
+  MemoryUsage& operator+=(const MemoryUsage& other) {
+    logical += other.logical;
+    allocated += other.allocated;
+    return *this;
+  }
+};
+
+struct StyleMemoryStats {
+  MemoryUsage categories[size_t(MemoryCategory::Count)];
+  MemoryUsage total;
+  size_t peak_load_bytes = 0; // allocated bytes at the peak of the last load, tracked as it allocated
+
+  MemoryUsage& operator[](MemoryCategory category) { return categories[size_t(category)]; }
+  const MemoryUsage& operator[](MemoryCategory category) const { return categories[size_t(category)]; }
+};
+
+// memory_stats reports the memory held by styles. Pixel buffers shared
+// between images of styles are counted once, buffers shared with other
+// styles through a PixelStore are counted in full.
+StyleMemoryStats memory_stats(const Styles& styles);
+
+// source_memory and image_memory are the parts of memory_stats used to
+// track the peak while loading, after each step that allocates.
+MemoryUsage source_memory(const StyleSource& source);
+MemoryUsage image_memory(const std::vector<Sprite>& images);
+
+// allocated_size returns how many bytes the allocator reserved for the
+// block at ptr, or fallback if that can't be queried on this platform.
+size_t allocated_size(const void* ptr, size_t fallback);
+
+std::string to_json(const StyleMemoryStats& stats);
@@ -0,0 +1,179 @@
+#include "mipmap.h"
+#include "styles.h"
+#include "thread_pool.h"
+#include "trace.h"
+#include <math.h>
+#include <algorithm>
+#include <array>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define FTA2_SSE2 1
+#endif
+
+struct GammaTables {
+  std::array<float, 256> to_linear;
+  std::array<uint8_t, 4096> to_srgb; // indexed by linear * 4095
+
+  GammaTables() {
+    for (size_t i = 0; i < to_linear.size(); ++i) {
+      float c = float(i) / 255.0f;
+      to_linear[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+    }
+
+    for (size_t i = 0; i < to_srgb.size(); ++i) {
+      float l = float(i) / float(to_srgb.size() - 1);
+      float c = l <= 0.0031308f ? l * 12.92f : 1.055f * powf(l, 1.0f / 2.4f) - 0.055f;
+      to_srgb[i] = uint8_t(std::clamp(c * 255.0f + 0.5f, 0.0f, 255.0f));
+    }
+  }
+};
+
+static const GammaTables& gamma_tables() {
+  static const GammaTables tables;
+  return tables;
+}
+
+static Color box(const Color& c0, const Color& c1, const Color& c2, const Color& c3) {
+  uint32_t a = uint32_t(c0.a) + c1.a + c2.a + c3.a;
+  if (a == 0) {
+    return Color{0, 0, 0, 0};
+  }
+
+  auto channel = [&](uint8_t Color::*ch) {
+    uint32_t sum = uint32_t(c0.*ch) * c0.a + uint32_t(c1.*ch) * c1.a + uint32_t(c2.*ch) * c2.a + uint32_t(c3.*ch) * c3.a;
+    return uint8_t((sum + a / 2) / a);
+  };
+
+  return Color{channel(&Color::r), channel(&Color::g), channel(&Color::b), uint8_t((a + 2) / 4)};
+}
+
+static Color gamma_box(const Color& c0, const Color& c1, const Color& c2, const Color& c3) {
+  uint32_t a = uint32_t(c0.a) + c1.a + c2.a + c3.a;
+  if (a == 0) {
+    return Color{0, 0, 0, 0};
+  }
+
+  auto& t = gamma_tables();
+  auto channel = [&](uint8_t Color::*ch) {
+    float sum = t.to_linear[c0.*ch] * c0.a + t.to_linear[c1.*ch] * c1.a + t.to_linear[c2.*ch] * c2.a + t.to_linear[c3.*ch] * c3.a;
+    float linear = sum / float(a);
+    return t.to_srgb[size_t(linear * float(t.to_srgb.size() - 1) + 0.5f)];
+  };
+
+  return Color{channel(&Color::r), channel(&Color::g), channel(&Color::b), uint8_t((a + 2) / 4)};
+}
+
+// unpremultiply turns a premultiplied color back into a straight one, the
+// filters average straight colors weighted by alpha.
+static Color unpremultiply(Color c) {
+  if (c.a == 0 || c.a == 0xff) {
+    return c;
+  }
+  auto channel = [&](uint8_t v) { return uint8_t(std::min(255u, (uint32_t(v) * 255 + c.a / 2) / c.a)); };
+  return Color{channel(c.r), channel(c.g), channel(c.b), c.a};
+}
+
+static Color premultiply(Color c) {
+  auto channel = [&](uint8_t v) { return uint8_t((uint32_t(v) * c.a + 127) / 255); };
+  return Color{channel(c.r), channel(c.g), channel(c.b), c.a};
+}
+
+#if FTA2_SSE2
+// box_opaque_sse2 averages the 2x2 blocks of four opaque pixels of two
+// rows into two pixels. Returns false if any of the pixels is not opaque.
+static bool box_opaque_sse2(const Color* row0, const Color* row1, Color* dest) {
+  __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0));
+  __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1));
+
+  __m128i alpha = _mm_set1_epi32(int(0xff000000));
+  __m128i both = _mm_and_si128(a, b);
+  if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(both, alpha), alpha)) != 0xffff) {
+    return false;
+  }
+
+  __m128i zero = _mm_setzero_si128();
+  __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero)); // p0 p1
+  __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero)); // p2 p3
+
+  // Add the horizontal neighbours: p0+p1 and p2+p3.
+  __m128i sum_lo = _mm_add_epi16(lo, _mm_unpackhi_epi64(lo, lo));
+  __m128i sum_hi = _mm_add_epi16(hi, _mm_unpackhi_epi64(hi, hi));
+  __m128i sums = _mm_unpacklo_epi64(sum_lo, sum_hi);
+
+  sums = _mm_srli_epi16(_mm_add_epi16(sums, _mm_set1_epi16(2)), 2);
+  _mm_storel_epi64(reinterpret_cast<__m128i*>(dest), _mm_packus_epi16(sums, zero));
+  return true;
+}
+#endif
+
+static Sprite downsample(const Sprite& src, MipFilter filter, bool premultiplied) {
+  Sprite dest;
+  dest.width = std::max(1u, src.width / 2);
+  dest.height = std::max(1u, src.height / 2);
+  dest.x = src.x / 2;
+  dest.y = src.y / 2;
+  std::vector<Color> pixels(size_t(dest.width) * dest.height);
+
+  for (uint32_t y = 0; y < dest.height; ++y) {
+    const Color* row0 = src.pixels.data() + std::min(2 * y, src.height - 1) * src.width;
+    const Color* row1 = src.pixels.data() + std::min(2 * y + 1, src.height - 1) * src.width;
+    Color* out = pixels.data() + y * dest.width;
+
+    for (uint32_t x = 0; x < dest.width; ++x) {
+#if FTA2_SSE2
+      if (filter == MipFilter::Box && x % 2 == 0 && 2 * x + 4 <= src.width && box_opaque_sse2(row0 + 2 * x, row1 + 2 * x, out + x)) {
+        ++x;
+        continue;
+      }
+#endif
+
+      uint32_t x0 = std::min(2 * x, src.width - 1);
+      uint32_t x1 = std::min(2 * x + 1, src.width - 1);
+
+      Color c0 = row0[x0], c1 = row0[x1], c2 = row1[x0], c3 = row1[x1];
+      if (premultiplied) {
+        c0 = unpremultiply(c0);
+        c1 = unpremultiply(c1);
+        c2 = unpremultiply(c2);
+        c3 = unpremultiply(c3);
+      }
+
+      Color c = filter == MipFilter::Box ? box(c0, c1, c2, c3) : gamma_box(c0, c1, c2, c3);
+      out[x] = premultiplied ? premultiply(c) : c;
+    }
+  }
+
+  dest.pixels = std::move(pixels);
+  dest.opacity = compute_opacity(dest);
+  return dest;
+}
+
+std::vector<Sprite> build_mip_chain(const Sprite& sprite, MipFilter filter, bool premultiplied) {
+  std::vector<Sprite> result;
+  if (sprite.width == 0 || sprite.height == 0) {
+    return result;
+  }
+
+  const Sprite* level = &sprite;
+  while (level->width > 1 || level->height > 1) {
+    result.push_back(downsample(*level, filter, premultiplied));
+    level = &result.back();
+  }
+
+  return result;
+}
+
+std::vector<std::vector<Sprite>> build_mip_chains(const std::vector<Sprite>& sprites, MipFilter filter, bool premultiplied, ThreadPool* pool) {
+  std::vector<std::vector<Sprite>> result(sprites.size());
+
+  constexpr size_t kGrain = 64;
+  parallel_for(pool, sprites.size(), kGrain, [&](size_t begin, size_t end) {
+    TRACE_SCOPE("mip_chains");
+    for (size_t i = begin; i < end; ++i) {
+      result[i] = build_mip_chain(sprites[i], filter, premultiplied);
+    }
+  });
+
+  return result;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+struct Sprite;
+class ThreadPool;
+
+enum class MipFilter {
+  Box,      // 2x2 average of the stored values
+  GammaBox, // 2x2 average in linear light, for sRGB content
+};
+
+// build_mip_chain returns the levels below sprite, each half the size of
+// the previous one (odd sizes round down) until 1x1. Colors are weighted by
+// alpha so transparent pixels don't bleed into their neighbours. If the
+// sprite is premultiplied the levels are premultiplied too.
+std::vector<Sprite> build_mip_chain(const Sprite& sprite, MipFilter filter, bool premultiplied = false);
+
+// build_mip_chains builds the chains of every sprite in parallel on pool,
+// or on the calling thread if pool is null.
+std::vector<std::vector<Sprite>> build_mip_chains(const std::vector<Sprite>& sprites, MipFilter filter, bool premultiplied, ThreadPool* pool);
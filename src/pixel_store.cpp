@@ -0,0 +1,115 @@
+#include "pixel_store.h"
+
+Pixels::Pixels(std::vector<Color>&& pixels)
+  : m_buffer(std::make_shared<std::vector<Color>>(std::move(pixels))) {
+}
+
+Pixels::Pixels(std::shared_ptr<const std::vector<Color>> buffer)
+  : m_buffer(std::move(buffer)) {
+}
+
+Color* Pixels::mutable_data() {
+  if (!m_buffer) {
+    return nullptr;
+  }
+
+  if (m_buffer.use_count() > 1) {
+    m_buffer = std::make_shared<std::vector<Color>>(*m_buffer);
+  }
+
+  // The buffer was allocated non-const by this class and nothing else
+  // references it.
+  return const_cast<Color*>(m_buffer->data());
+}
+
+PixelStore& PixelStore::global() {
+  static PixelStore store;
+  return store;
+}
+
+bool PixelStore::find(const PixelKey& key, Pixels& pixels) {
+  auto& s = shard(key);
+  std::lock_guard lock(s.mutex);
+
+  auto it = s.entries.find(key);
+  if (it == s.entries.end()) {
+    ++s.misses;
+    return false;
+  }
+
+  ++s.hits;
+  pixels = it->second;
+  return true;
+}
+
+Pixels PixelStore::insert(const PixelKey& key, std::vector<Color>&& pixels) {
+  Pixels entry(std::move(pixels));
+
+  auto& s = shard(key);
+  std::lock_guard lock(s.mutex);
+
+  auto [it, inserted] = s.entries.try_emplace(key, std::move(entry));
+  return it->second;
+}
+
+size_t PixelStore::references(const PixelKey& key) {
+  auto& s = shard(key);
+  std::lock_guard lock(s.mutex);
+
+  auto it = s.entries.find(key);
+  if (it == s.entries.end()) {
+    return 0;
+  }
+  // Not counting the store's own reference.
+  return size_t(it->second.buffer().use_count()) - 1;
+}
+
+size_t PixelStore::purge() {
+  size_t released = 0;
+
+  for (auto& s : m_shards) {
+    std::lock_guard lock(s.mutex);
+
+    for (auto it = s.entries.begin(); it != s.entries.end(); ) {
+      if (it->second.buffer().use_count() == 1) {
+        released += it->second.size() * sizeof(Color);
+        it = s.entries.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  return released;
+}
+
+void PixelStore::clear() {
+  for (auto& s : m_shards) {
+    std::lock_guard lock(s.mutex);
+    s.entries.clear();
+    s.hits = 0;
+    s.misses = 0;
+  }
+}
+
+PixelStoreStats PixelStore::stats() {
+  PixelStoreStats result;
+
+  for (auto& s : m_shards) {
+    std::lock_guard lock(s.mutex);
+
+    result.entries += s.entries.size();
+    result.hits += s.hits;
+    result.misses += s.misses;
+
+    for (auto& [key, pixels] : s.entries) {
+      size_t refs = size_t(pixels.buffer().use_count()) - 1;
+      size_t bytes = pixels.size() * sizeof(Color);
+      result.references += refs;
+      result.bytes += bytes;
+      result.shared_bytes += refs * bytes;
+    }
+  }
+
+  return result;
+}
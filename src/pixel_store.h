@@ -0,0 +1,102 @@
+#pragma once
+
+#include "style_format.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Pixels is a block of RGBA pixels that can be shared between sprites and
+// between styles. Copies share the same buffer, mutable_data copies the
+// buffer first if anything else references it.
+class Pixels {
+  private:
+    std::shared_ptr<const std::vector<Color>> m_buffer;
+
+  public:
+    Pixels() = default;
+    Pixels(std::vector<Color>&& pixels);
+    explicit Pixels(std::shared_ptr<const std::vector<Color>> buffer);
+
+    size_t size() const { return m_buffer ? m_buffer->size() : 0; }
+    bool empty() const { return size() == 0; }
+    const Color* data() const { return m_buffer ? m_buffer->data() : nullptr; }
+    const Color* begin() const { return data(); }
+    const Color* end() const { return data() + size(); }
+    const Color& operator[](size_t index) const { return (*m_buffer)[index]; }
+
+    Color* mutable_data();
+
+    bool shares_buffer_with(const Pixels& other) const { return m_buffer && m_buffer == other.m_buffer; }
+    const std::shared_ptr<const std::vector<Color>>& buffer() const { return m_buffer; }
+};
+
+// PixelKey identifies the contents of an image, a 128-bit hash of its palette
+// indices, palette and whatever else went into converting it. Keys can
+// collide, callers check the pixels they find under one.
+struct PixelKey {
+  uint64_t lo = 0;
+  uint64_t hi = 0;
+
+  bool operator==(const PixelKey&) const = default;
+};
+
+struct PixelStoreStats {
+  size_t entries = 0;
+  size_t references = 0;    // images referencing an entry, summed over entries
+  size_t bytes = 0;         // RGBA bytes held by the store
+  size_t shared_bytes = 0;  // bytes the references would take without sharing
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+};
+
+// PixelStore is a content-addressed store of immutable pixel buffers. Styles
+// loaded with the same store share identical sprites and tiles instead of
+// converting and keeping their own copies. Entries stay in the store until
+// purge is called after the last image referencing them is gone.
+//
+// The store is thread-safe, styles may be loaded into it concurrently.
+class PixelStore {
+  private:
+    struct KeyHash {
+      size_t operator()(const PixelKey& key) const { return size_t(key.lo); }
+    };
+
+    struct Shard {
+      std::mutex mutex;
+      std::unordered_map<PixelKey, Pixels, KeyHash> entries;
+      uint64_t hits = 0;
+      uint64_t misses = 0;
+    };
+
+    static constexpr size_t kShardCount = 16;
+    Shard m_shards[kShardCount];
+
+    Shard& shard(const PixelKey& key) { return m_shards[key.hi % kShardCount]; }
+
+  public:
+    // global returns the process-wide store.
+    static PixelStore& global();
+
+    // find sets pixels to the entry stored for key and returns true, or
+    // returns false if there is no such entry. The contents aren't compared,
+    // the entry may belong to a colliding key.
+    bool find(const PixelKey& key, Pixels& pixels);
+
+    // insert stores pixels under key and returns the stored entry. If
+    // another thread stored the same key first, that entry is returned.
+    Pixels insert(const PixelKey& key, std::vector<Color>&& pixels);
+
+    // references returns how many images reference the entry for key.
+    size_t references(const PixelKey& key);
+
+    // purge drops the entries no image references anymore and returns how
+    // many bytes were released.
+    size_t purge();
+
+    void clear();
+
+    PixelStoreStats stats();
+};
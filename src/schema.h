@@ -0,0 +1,298 @@
+#pragma once
+
+// Compile-time chunk schemas.
+//
+// A chunk type declares its on-disk layout once with the building blocks
+// below, and the schema generates a validator, a bulk decoder and an encoder
+// for it. Fixed-size parts are copied with a single memcpy instead of being
+// read field by field. Nothing here knows about styles, the same blocks
+// describe map (.gmp) chunks.
+//
+//   Fixed<T>               the chunk is exactly one T
+//   Array<T>               the chunk is a whole number of T's
+//   Records<H, Tails...>   the chunk is a sequence of variable-length records,
+//                          each a fixed header H followed by Tails
+//
+//   CountedBy<&H::n, T>    tail of header.n T's
+//   Counted<N, T>          tail of an N count followed by that many T's
+//
+// A chunk descriptor names its FourCC, its Layout and how to move the
+// decoded layout into and out of the target it is registered for:
+//
+//   struct SprxChunk {
+//     static constexpr schema::FourCC type = "SPRX";
+//     using Layout = schema::Array<GTASpriteTransfer>;
+//     static void decode(StyleSource& target, Layout::Decoded&& value);
+//     static Layout::Decoded encode(const StyleSource& target);
+//   };
+//
+// Descriptors are collected into a Registry that dispatches on the FourCC.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace schema {
+
+  struct FourCC {
+    uint32_t value = 0;
+
+    constexpr FourCC() = default;
+    constexpr FourCC(const char (&name)[5]) : value(pack(name)) { }
+
+    static constexpr FourCC from(const char* name) {
+      FourCC result;
+      result.value = pack(name);
+      return result;
+    }
+
+    constexpr bool operator==(const FourCC&) const = default;
+
+  private:
+    static constexpr uint32_t pack(const char* name) {
+      return uint32_t(uint8_t(name[0])) | uint32_t(uint8_t(name[1])) << 8 | uint32_t(uint8_t(name[2])) << 16 | uint32_t(uint8_t(name[3])) << 24;
+    }
+  };
+
+  template <typename T>
+  void append(std::vector<uint8_t>& out, const T* values, size_t count) {
+    auto bytes = reinterpret_cast<const uint8_t*>(values);
+    out.insert(out.end(), bytes, bytes + count * sizeof(T));
+  }
+
+  // Fixed<T> is a chunk holding exactly one T.
+  template <typename T>
+  struct Fixed {
+    static_assert(std::is_trivially_copyable_v<T>);
+    using Decoded = T;
+
+    static bool validate(const uint8_t*, size_t size) {
+      return size == sizeof(T);
+    }
+
+    static Decoded decode(const uint8_t* data, size_t) {
+      T result;
+      memcpy(&result, data, sizeof(T));
+      return result;
+    }
+
+    static void encode(const Decoded& value, std::vector<uint8_t>& out) {
+      append(out, &value, 1);
+    }
+  };
+
+  // Array<T> is a chunk holding chunk_size / sizeof(T) T's.
+  template <typename T>
+  struct Array {
+    static_assert(std::is_trivially_copyable_v<T>);
+    using Decoded = std::vector<T>;
+
+    static bool validate(const uint8_t*, size_t size) {
+      return size % sizeof(T) == 0;
+    }
+
+    static Decoded decode(const uint8_t* data, size_t size) {
+      Decoded result(size / sizeof(T));
+      memcpy(result.data(), data, result.size() * sizeof(T));
+      return result;
+    }
+
+    static void encode(const Decoded& value, std::vector<uint8_t>& out) {
+      append(out, value.data(), value.size());
+    }
+  };
+
+  // CountedBy<&Header::count, T> is a record tail of header.count T's.
+  template <auto Count, typename T>
+  struct CountedBy {
+    static_assert(std::is_trivially_copyable_v<T>);
+    using type = T;
+
+    template <typename Header>
+    static bool skip(const Header& header, const uint8_t*, size_t size, size_t& cursor) {
+      size_t bytes = size_t(header.*Count) * sizeof(T);
+      if (size - cursor < bytes) return false;
+      cursor += bytes;
+      return true;
+    }
+
+    template <typename Header>
+    static bool read(const Header& header, const uint8_t* data, size_t size, size_t& cursor, std::vector<T>& out) {
+      size_t start = cursor;
+      if (!skip(header, data, size, cursor)) return false;
+      out.resize(header.*Count);
+      memcpy(out.data(), data + start, out.size() * sizeof(T));
+      return true;
+    }
+
+    template <typename Header>
+    static void write(const Header&, const std::vector<T>& values, std::vector<uint8_t>& out) {
+      append(out, values.data(), values.size());
+    }
+  };
+
+  // Counted<N, T> is a record tail of an N count followed by that many T's.
+  template <typename N, typename T>
+  struct Counted {
+    static_assert(std::is_trivially_copyable_v<N> && std::is_trivially_copyable_v<T>);
+    using type = T;
+
+    static bool count(const uint8_t* data, size_t size, size_t& cursor, size_t& n) {
+      if (size - cursor < sizeof(N)) return false;
+      N value;
+      memcpy(&value, data + cursor, sizeof(N));
+      cursor += sizeof(N);
+      n = size_t(value);
+      return size - cursor >= n * sizeof(T);
+    }
+
+    template <typename Header>
+    static bool skip(const Header&, const uint8_t* data, size_t size, size_t& cursor) {
+      size_t n;
+      if (!count(data, size, cursor, n)) return false;
+      cursor += n * sizeof(T);
+      return true;
+    }
+
+    template <typename Header>
+    static bool read(const Header&, const uint8_t* data, size_t size, size_t& cursor, std::vector<T>& out) {
+      size_t n;
+      if (!count(data, size, cursor, n)) return false;
+      out.resize(n);
+      memcpy(out.data(), data + cursor, n * sizeof(T));
+      cursor += n * sizeof(T);
+      return true;
+    }
+
+    template <typename Header>
+    static void write(const Header&, const std::vector<T>& values, std::vector<uint8_t>& out) {
+      N n = static_cast<N>(values.size());
+      append(out, &n, 1);
+      append(out, values.data(), values.size());
+    }
+  };
+
+  // Records<Header, Tails...> is a chunk of back to back variable-length
+  // records. Each record is decoded into a tuple of its header and one
+  // vector per tail.
+  template <typename Header, typename... Tails>
+  struct Records {
+    static_assert(std::is_trivially_copyable_v<Header>);
+    using Record = std::tuple<Header, std::vector<typename Tails::type>...>;
+    using Decoded = std::vector<Record>;
+
+    static bool validate(const uint8_t* data, size_t size) {
+      size_t cursor = 0;
+      while (cursor < size) {
+        if (size - cursor < sizeof(Header)) return false;
+
+        Header header;
+        memcpy(&header, data + cursor, sizeof(Header));
+        cursor += sizeof(Header);
+
+        if (!(Tails::skip(header, data, size, cursor) && ...)) return false;
+      }
+      return true;
+    }
+
+    static Decoded decode(const uint8_t* data, size_t size) {
+      Decoded result;
+      size_t cursor = 0;
+      while (cursor < size) {
+        Record record;
+        if (!read_record(data, size, cursor, record, std::index_sequence_for<Tails...>{})) break;
+        result.push_back(std::move(record));
+      }
+      return result;
+    }
+
+    static void encode(const Decoded& value, std::vector<uint8_t>& out) {
+      for (auto& record : value) {
+        write_record(record, out, std::index_sequence_for<Tails...>{});
+      }
+    }
+
+  private:
+    template <size_t... I>
+    static bool read_record(const uint8_t* data, size_t size, size_t& cursor, Record& record, std::index_sequence<I...>) {
+      if (size - cursor < sizeof(Header)) return false;
+
+      auto& header = std::get<0>(record);
+      memcpy(&header, data + cursor, sizeof(Header));
+      cursor += sizeof(Header);
+
+      return (Tails::read(header, data, size, cursor, std::get<I + 1>(record)) && ...);
+    }
+
+    template <size_t... I>
+    static void write_record(const Record& record, std::vector<uint8_t>& out, std::index_sequence<I...>) {
+      auto& header = std::get<0>(record);
+      append(out, &header, 1);
+      (Tails::write(header, std::get<I + 1>(record), out), ...);
+    }
+  };
+
+  enum class ChunkStatus {
+    Ok,
+    Unknown, // no descriptor is registered for the chunk type
+    Invalid, // the chunk does not match its layout
+  };
+
+  // Registry dispatches chunks to the descriptor registered for their type.
+  template <typename Target, typename... Chunks>
+  struct Registry {
+    static constexpr bool unique_types() {
+      FourCC types[] = {Chunks::type...};
+      for (size_t i = 0; i < sizeof...(Chunks); ++i) {
+        for (size_t j = i + 1; j < sizeof...(Chunks); ++j) {
+          if (types[i] == types[j]) return false;
+        }
+      }
+      return true;
+    }
+    static_assert(unique_types(), "chunk type registered twice");
+
+    static constexpr bool known(FourCC type) {
+      return ((type == Chunks::type) || ...);
+    }
+
+    static ChunkStatus validate(FourCC type, const uint8_t* data, size_t size) {
+      ChunkStatus status = ChunkStatus::Unknown;
+      ((type == Chunks::type && (status = validate_chunk<Chunks>(data, size), true)) || ...);
+      return status;
+    }
+
+    static ChunkStatus decode(FourCC type, const uint8_t* data, size_t size, Target& target) {
+      ChunkStatus status = ChunkStatus::Unknown;
+      ((type == Chunks::type && (status = decode_chunk<Chunks>(data, size, target), true)) || ...);
+      return status;
+    }
+
+    // encode appends the chunk data (without the chunk header) to out.
+    static ChunkStatus encode(FourCC type, const Target& target, std::vector<uint8_t>& out) {
+      ChunkStatus status = ChunkStatus::Unknown;
+      ((type == Chunks::type && (Chunks::Layout::encode(Chunks::encode(target), out), status = ChunkStatus::Ok, true)) || ...);
+      return status;
+    }
+
+  private:
+    template <typename Chunk>
+    static ChunkStatus validate_chunk(const uint8_t* data, size_t size) {
+      return Chunk::Layout::validate(data, size) ? ChunkStatus::Ok : ChunkStatus::Invalid;
+    }
+
+    template <typename Chunk>
+    static ChunkStatus decode_chunk(const uint8_t* data, size_t size, Target& target) {
+      if (!Chunk::Layout::validate(data, size)) {
+        return ChunkStatus::Invalid;
+      }
+      Chunk::decode(target, Chunk::Layout::decode(data, size));
+      return ChunkStatus::Ok;
+    }
+  };
+
+} // namespace schema
@@ -0,0 +1,227 @@
+#include "shared_styles.h"
+#include "trace.h"
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <new>
+
+static const char kControlMagic[8] = {'F', 'T', 'A', '2', 'S', 'H', 'M', 0};
+static const char kSegmentMagic[8] = {'F', 'T', 'A', '2', 'S', 'E', 'G', 0};
+
+// A segment can be replaced and unlinked between reading the generation and
+// opening it, readers then try the newer one.
+constexpr int kAttachAttempts = 8;
+
+struct SharedControl {
+  char magic[8];
+  uint32_t version;
+  uint32_t cooked_version;
+  std::atomic<uint64_t> generation; // 0 until the first publish
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "the generation is read across processes");
+
+// The header is padded so the cooked data after it stays 16 byte aligned.
+constexpr size_t kSegmentHeaderSize = 64;
+
+struct SharedSegmentHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+  uint64_t generation;
+  uint64_t size; // of the cooked data, the segment may be rounded up
+};
+
+static_assert(sizeof(SharedSegmentHeader) <= kSegmentHeaderSize);
+static_assert(kSegmentHeaderSize % 16 == 0);
+
+// Names end up in /dev/shm or the Windows object namespace, keep them flat.
+static bool valid_name(const char* name) {
+  return name && name[0] && !strpbrk(name, "/\\");
+}
+
+static std::string control_name(const std::string& name) {
+#if defined(_WIN32)
+  return "Local\\fta2." + name;
+#else
+  return "/fta2." + name;
+#endif
+}
+
+static std::string segment_name(const std::string& name, uint64_t generation) {
+  char suffix[24];
+  snprintf(suffix, sizeof(suffix), ".%llu", (unsigned long long)generation);
+  return control_name(name) + suffix;
+}
+
+static bool valid_control(const SharedMemory& memory) {
+  if (memory.size() < sizeof(SharedControl)) return false;
+  auto control = reinterpret_cast<const SharedControl*>(memory.data());
+  return memcmp(control->magic, kControlMagic, sizeof(kControlMagic)) == 0 &&
+    control->version == kSharedStylesVersion &&
+    control->cooked_version == kCookedVersion;
+}
+
+// view_segment points styles at the cooked data of a segment of generation.
+static bool view_segment(CookedStyles& styles, const SharedMemory& segment, uint64_t generation) {
+  if (segment.size() < kSegmentHeaderSize) return false;
+
+  auto header = reinterpret_cast<const SharedSegmentHeader*>(segment.data());
+  bool ok = memcmp(header->magic, kSegmentMagic, sizeof(kSegmentMagic)) == 0 &&
+    header->version == kSharedStylesVersion &&
+    header->generation == generation &&
+    header->size <= segment.size() - kSegmentHeaderSize;
+
+  return ok && styles.view(segment.data() + kSegmentHeaderSize, size_t(header->size));
+}
+
+bool StylePublisher::open(const char* name) {
+  close();
+
+  if (!valid_name(name)) {
+    return false;
+  }
+
+  std::string control = control_name(name);
+  if (m_control.open(control.c_str(), true) && valid_control(m_control)) {
+    m_generation = reinterpret_cast<SharedControl*>(m_control.data())->generation.load(std::memory_order_acquire);
+  } else if (m_control.create(control.c_str(), sizeof(SharedControl))) {
+    auto header = new (m_control.data()) SharedControl{ };
+    memcpy(header->magic, kControlMagic, sizeof(kControlMagic));
+    header->version = kSharedStylesVersion;
+    header->cooked_version = kCookedVersion;
+    header->generation.store(0, std::memory_order_release);
+    m_generation = 0;
+  } else {
+    return false;
+  }
+
+  m_name = name;
+  return true;
+}
+
+void StylePublisher::close() {
+  m_segments[0].close();
+  m_segments[1].close();
+  m_control.close();
+  m_name.clear();
+  m_current = 0;
+  m_generation = 0;
+}
+
+bool StylePublisher::publish(const Styles& styles, const CookedSourceInfo& source) {
+  TRACE_SCOPE("publish_styles");
+
+  if (!m_control.data()) {
+    return false;
+  }
+
+  std::vector<uint8_t> cooked = cook_styles(styles, source);
+
+  uint64_t generation = m_generation + 1;
+  std::string name = segment_name(m_name, generation);
+  SharedMemory& segment = m_segments[m_current ^ 1];
+  if (!segment.create(name.c_str(), kSegmentHeaderSize + cooked.size())) {
+    return false;
+  }
+
+  auto header = reinterpret_cast<SharedSegmentHeader*>(segment.data());
+  memcpy(header->magic, kSegmentMagic, sizeof(kSegmentMagic));
+  header->version = kSharedStylesVersion;
+  header->generation = generation;
+  header->size = cooked.size();
+  memcpy(segment.data() + kSegmentHeaderSize, cooked.data(), cooked.size());
+
+  // Readers that see the new generation also see the segment written above.
+  reinterpret_cast<SharedControl*>(m_control.data())->generation.store(generation, std::memory_order_release);
+
+  if (m_generation != 0) {
+    SharedMemory::remove(segment_name(m_name, m_generation).c_str());
+  }
+  m_segments[m_current].close();
+  m_current ^= 1;
+  m_generation = generation;
+  return true;
+}
+
+void StylePublisher::unpublish() {
+  if (m_name.empty()) {
+    return;
+  }
+
+  if (m_generation != 0) {
+    SharedMemory::remove(segment_name(m_name, m_generation).c_str());
+  }
+  SharedMemory::remove(control_name(m_name).c_str());
+  close();
+}
+
+bool SharedStyles::attach(const char* name) {
+  detach();
+
+  if (!valid_name(name) || !m_control.open(control_name(name).c_str()) || !valid_control(m_control)) {
+    detach();
+    return false;
+  }
+
+  m_name = name;
+  if (!refresh()) {
+    detach();
+    return false;
+  }
+
+  return true;
+}
+
+void SharedStyles::detach() {
+  m_styles.close();
+  m_segments[0].close();
+  m_segments[1].close();
+  m_control.close();
+  m_name.clear();
+  m_current = 0;
+  m_generation = 0;
+}
+
+uint64_t SharedStyles::published_generation() const {
+  if (!m_control.data()) return 0;
+  return reinterpret_cast<const SharedControl*>(m_control.data())->generation.load(std::memory_order_acquire);
+}
+
+bool SharedStyles::changed() const {
+  return published_generation() != m_generation;
+}
+
+bool SharedStyles::refresh() {
+  TRACE_SCOPE("refresh_shared_styles");
+
+  for (int attempt = 0; attempt < kAttachAttempts; ++attempt) {
+    uint64_t generation = published_generation();
+    if (generation == 0) {
+      return false;
+    }
+    if (generation == m_generation) {
+      return true;
+    }
+
+    SharedMemory& segment = m_segments[m_current ^ 1];
+    if (!segment.open(segment_name(m_name, generation).c_str())) {
+      continue;
+    }
+
+    if (!view_segment(m_styles, segment, generation)) {
+      segment.close();
+      if (m_generation != 0) {
+        view_segment(m_styles, m_segments[m_current], m_generation);
+      }
+      return false;
+    }
+
+    m_segments[m_current].close();
+    m_current ^= 1;
+    m_generation = generation;
+    return true;
+  }
+
+  return false;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "cooked_styles.h"
+#include "io.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+// Shared styles let one process decode a style file and publish it in shared
+// memory, where other processes attach to it read-only without decoding or
+// copying anything. The published data is the cooked format, which is
+// offset based and can be used at any address.
+//
+// Each publication goes into its own segment, named after the style and its
+// generation. A small control segment holds the current generation, so
+// readers can tell that a reload happened and attach to the new segment.
+// Segments that are replaced are unlinked, readers that still map them keep
+// using them until they refresh.
+//
+//   /fta2.<name>        SharedControl
+//   /fta2.<name>.<gen>  SharedSegmentHeader, cooked styles
+//
+// There must be only one publisher per name.
+
+constexpr uint32_t kSharedStylesVersion = 1;
+
+// StylePublisher cooks styles that are already loaded and publishes them.
+class StylePublisher {
+  private:
+    std::string m_name;
+    SharedMemory m_control;
+    SharedMemory m_segments[2]; // the current one stays mapped until the next is published
+    size_t m_current = 0;
+    uint64_t m_generation = 0;
+
+  public:
+    // open creates the control segment for name, or continues the generations
+    // of one left by an earlier publisher.
+    bool open(const char* name);
+    void close();
+
+    // publish cooks styles into a new segment and makes it current.
+    bool publish(const Styles& styles, const CookedSourceInfo& source = { });
+
+    // unpublish removes the control segment and the current segment.
+    void unpublish();
+
+    uint64_t generation() const { return m_generation; }
+};
+
+// SharedStyles is a read-only view of the styles published under a name.
+class SharedStyles {
+  private:
+    std::string m_name;
+    SharedMemory m_control;
+    SharedMemory m_segments[2];
+    size_t m_current = 0;
+    CookedStyles m_styles;
+    uint64_t m_generation = 0;
+
+    uint64_t published_generation() const;
+
+  public:
+    // attach opens the control segment for name and the current styles.
+    bool attach(const char* name);
+    void detach();
+
+    // changed is true when a newer generation than the attached one has been
+    // published. It is a single atomic load, cheap enough to poll every frame.
+    bool changed() const;
+
+    // refresh attaches to the current generation. The old styles stay valid
+    // when it fails. Spans and pointers from styles() are invalidated when
+    // it succeeds.
+    bool refresh();
+
+    uint64_t generation() const { return m_generation; }
+    const CookedStyles& styles() const { return m_styles; }
+};
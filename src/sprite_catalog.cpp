@@ -0,0 +1,65 @@
+#include "sprite_catalog.h"
+#include "style_format.h"
+#include <algorithm>
+#include <bitset>
+
+const char* to_string(SpriteKind kind) {
+  switch (kind) {
+    case SpriteKind::Car:   return "car";
+    case SpriteKind::Ped:   return "ped";
+    case SpriteKind::Code:  return "code";
+    case SpriteKind::Map:   return "map";
+    case SpriteKind::User:  return "user";
+    case SpriteKind::Font:  return "font";
+    case SpriteKind::Count: break;
+  }
+  return "unknown";
+}
+
+SpriteCatalog build_sprite_catalog(const StyleSource& source) {
+  SpriteCatalog catalog;
+
+  auto& bases = source.sprite_bases;
+  const SpriteBase* all[] = {&bases.car, &bases.ped, &bases.code, &bases.map, &bases.user, &bases.font};
+  static_assert(std::size(all) == size_t(SpriteKind::Count));
+
+  catalog.kinds.assign(source.sprites.size(), SpriteKind::Count);
+
+  for (size_t k = 0; k < std::size(all); ++k) {
+    // Ranges are clamped to the sprites there are, so every sprite in a
+    // range exists.
+    size_t first = std::min<size_t>(all[k]->offset, source.sprites.size());
+    size_t count = std::min<size_t>(all[k]->count, source.sprites.size() - first);
+
+    catalog.ranges[k] = SpriteRange{uint16_t(first), uint16_t(count)};
+    std::fill_n(catalog.kinds.begin() + first, count, SpriteKind(k));
+  }
+
+  return catalog;
+}
+
+MapObjectCatalog build_map_object_catalog(const StyleSource& source) {
+  MapObjectCatalog catalog;
+
+  // The map object range is clamped to the sprites there are, as in
+  // build_sprite_catalog, so every model range lies within the sprites.
+  const SpriteBase& base = source.sprite_bases.map;
+  size_t first = std::min<size_t>(base.offset, source.sprites.size());
+  size_t count = std::min<size_t>(base.count, source.sprites.size() - first);
+
+  std::bitset<kMaxObjectModels> assigned;
+  size_t next = 0;
+
+  for (auto& object : source.map_objects) {
+    // Objects past the end of the range get clamped rather than pointing
+    // into the user sprites, a model listed twice keeps its first range.
+    if (!assigned[object.model]) {
+      size_t start = std::min(next, count);
+      catalog.models[object.model] = SpriteRange{uint16_t(first + start), uint16_t(std::min<size_t>(object.sprites, count - start))};
+      assigned[object.model] = true;
+    }
+    next += object.sprites;
+  }
+
+  return catalog;
+}
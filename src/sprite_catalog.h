@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <ranges>
+#include <vector>
+
+struct StyleSource;
+
+// SpriteRange is a run of count sprites starting at sprite index first.
+struct SpriteRange {
+  uint16_t first = 0;
+  uint16_t count = 0;
+
+  bool empty() const { return count == 0; }
+  bool contains(size_t sprite) const { return sprite >= first && sprite - first < count; }
+
+  // indices iterates over the sprite indices of the range.
+  auto indices() const { return std::views::iota(size_t(first), size_t(first) + count); }
+};
+
+// SpriteKind is the sprite base a sprite belongs to, in SPRB order.
+enum class SpriteKind : uint8_t {
+  Car,
+  Ped,
+  Code, // code object
+  Map,  // map object
+  User,
+  Font,
+
+  Count
+};
+
+const char* to_string(SpriteKind kind);
+
+// SpriteRef names a sprite by its kind and its index within the kind.
+struct SpriteRef {
+  SpriteKind kind;
+  uint16_t index;
+};
+
+// SpriteCatalog maps between sprite indices and the SPRB sprite bases.
+// Sprites past the last base have no kind.
+struct SpriteCatalog {
+  SpriteRange ranges[size_t(SpriteKind::Count)];
+  std::vector<SpriteKind> kinds; // per sprite, SpriteKind::Count for sprites without a kind
+
+  const SpriteRange& operator[](SpriteKind kind) const { return ranges[size_t(kind)]; }
+
+  // find returns the kind and local index of sprite, or false if the sprite
+  // has no kind.
+  bool find(size_t sprite, SpriteRef& ref) const {
+    if (sprite >= kinds.size() || kinds[sprite] == SpriteKind::Count) {
+      return false;
+    }
+    ref.kind = kinds[sprite];
+    ref.index = uint16_t(sprite - ranges[size_t(ref.kind)].first);
+    return true;
+  }
+};
+
+SpriteCatalog build_sprite_catalog(const StyleSource& source);
+
+constexpr size_t kMaxObjectModels = 256;
+
+// MapObjectCatalog resolves a map object model number to its sprites. OBJI
+// lists the models in the order their sprites are stored in the map object
+// sprite range, the first sprite of each model is the sum of the sprite
+// counts of the models before it.
+struct MapObjectCatalog {
+  SpriteRange models[kMaxObjectModels]; // empty for models not in OBJI
+
+  const SpriteRange& operator[](uint8_t model) const { return models[model]; }
+};
+
+MapObjectCatalog build_map_object_catalog(const StyleSource& source);
@@ -0,0 +1,270 @@
+#include "style_diff.h"
+#include "hash.h"
+#include "json.h"
+#include "thread_pool.h"
+#include "trace.h"
+#include <string.h>
+#include <algorithm>
+#include <initializer_list>
+
+constexpr size_t kHashGrain = 256;
+constexpr size_t kSpritePageSize = 256;
+
+const char* to_string(DiffKind kind) {
+  switch (kind) {
+    case DiffKind::Added:   return "added";
+    case DiffKind::Removed: return "removed";
+    case DiffKind::Changed: return "changed";
+  }
+  return "unknown";
+}
+
+static const StyleChunk* find_chunk(const StyleSource& source, ChunkType type) {
+  for (auto& chunk : source.chunks) {
+    if (chunk.type == type) return &chunk;
+  }
+  return nullptr;
+}
+
+static ChunkType chunk_type(const char* name) {
+  ChunkType type;
+  memcpy(type.name, name, sizeof(type.name));
+  return type;
+}
+
+// same_chunks returns true if every chunk in names is identical in a and b.
+static bool same_chunks(const StyleSource& a, const StyleSource& b, std::initializer_list<const char*> names) {
+  for (auto name : names) {
+    auto ca = find_chunk(a, chunk_type(name));
+    auto cb = find_chunk(b, chunk_type(name));
+    if (!ca != !cb) return false;
+    if (ca && (ca->hash != cb->hash || ca->size != cb->size)) return false;
+  }
+  return true;
+}
+
+static std::vector<ItemDiff> compare(const std::vector<uint64_t>& a, const std::vector<uint64_t>& b) {
+  std::vector<ItemDiff> result;
+
+  size_t common = std::min(a.size(), b.size());
+  for (size_t i = 0; i < common; ++i) {
+    if (a[i] != b[i]) result.push_back({uint32_t(i), DiffKind::Changed});
+  }
+  for (size_t i = common; i < b.size(); ++i) {
+    result.push_back({uint32_t(i), DiffKind::Added});
+  }
+  for (size_t i = common; i < a.size(); ++i) {
+    result.push_back({uint32_t(i), DiffKind::Removed});
+  }
+
+  return result;
+}
+
+template <typename F>
+static std::vector<uint64_t> hash_items(ThreadPool* pool, size_t count, F&& hash) {
+  std::vector<uint64_t> result(count);
+  parallel_for(pool, count, kHashGrain, [&](size_t begin, size_t end) {
+    TRACE_SCOPE("hash_items");
+    for (size_t i = begin; i < end; ++i) {
+      result[i] = hash(i);
+    }
+  });
+  return result;
+}
+
+static std::vector<uint64_t> palette_hashes(const StyleSource& s, ThreadPool* pool) {
+  return hash_items(pool, s.palettes.size(), [&](size_t i) {
+    return hash64(s.palettes[i].colors, sizeof(PhysicalPalette));
+  });
+}
+
+// The palette an item is drawn with, by content so that moving a palette
+// around doesn't count as a change.
+static uint64_t mapped_palette_hash(const StyleSource& s, const std::vector<uint64_t>& palettes, size_t virtual_index) {
+  if (virtual_index >= kVirtualPaletteTableSize) return 0;
+  size_t physical = s.vtable.map[virtual_index];
+  return physical < palettes.size() ? palettes[physical] : 0;
+}
+
+static std::vector<uint64_t> sprite_hashes(const StyleSource& s, const std::vector<uint64_t>& palettes, ThreadPool* pool) {
+  return hash_items(pool, s.sprites.size(), [&](size_t i) {
+    auto& sprite = s.sprites[i];
+    uint64_t h = mapped_palette_hash(s, palettes, s.palette_bases.sprite.offset + i);
+    h = hash64(&sprite.width, 1, h);
+    h = hash64(&sprite.height, 1, h);
+    for (size_t y = 0; y < sprite.height; ++y) {
+      size_t offset = sprite.offset + y * kSpritePageSize;
+      if (offset + sprite.width > s.sprite_store.size()) break;
+      h = hash64(s.sprite_store.data() + offset, sprite.width, h);
+    }
+    return h;
+  });
+}
+
+static std::vector<uint64_t> tile_hashes(const StyleSource& s, const std::vector<uint64_t>& palettes, ThreadPool* pool) {
+  return hash_items(pool, s.tiles.size(), [&](size_t i) {
+    uint64_t h = mapped_palette_hash(s, palettes, s.palette_bases.tile.offset + i);
+    return hash64(s.tiles[i].colors, sizeof(Tile), h);
+  });
+}
+
+static std::vector<uint64_t> delta_hashes(const StyleSource& s, ThreadPool* pool) {
+  struct Entry {
+    uint16_t sprite;
+    size_t offset;
+    size_t size;
+  };
+
+  std::vector<Entry> entries;
+  size_t offset = 0;
+  for (auto& set : s.deltas) {
+    for (auto size : set.sizes) {
+      entries.push_back({set.sprite, offset, size});
+      offset += size;
+    }
+  }
+
+  return hash_items(pool, entries.size(), [&](size_t i) {
+    auto& e = entries[i];
+    size_t size = e.offset < s.delta_store.size() ? std::min(e.size, s.delta_store.size() - e.offset) : 0;
+    return hash64(s.delta_store.data() + e.offset, size, e.sprite);
+  });
+}
+
+static std::vector<uint64_t> car_hashes(const StyleSource& s, ThreadPool* pool) {
+  return hash_items(pool, s.cars.size(), [&](size_t i) {
+    auto& car = s.cars[i];
+    const uint8_t fields[] = {
+      car.model, car.sprite, car.width, car.height, car.num_remaps, car.passengers, car.wreck, car.rating,
+      uint8_t(car.front_wheel_offset), uint8_t(car.rear_wheel_offset), uint8_t(car.front_window_offset), uint8_t(car.rear_window_offset),
+      car.info_flags, car.info_flags2, car.num_doors,
+    };
+    uint64_t h = hash64(fields, sizeof(fields));
+    h = hash64(car.remap.data(), car.remap.size(), h);
+    return hash64(car.doors.data(), car.doors.size() * sizeof(Door), h);
+  });
+}
+
+StyleDiff diff_styles(const StyleSource& a, const StyleSource& b, ThreadPool* pool) {
+  TRACE_SCOPE("diff_styles");
+
+  StyleDiff diff;
+
+  for (auto& ca : a.chunks) {
+    auto cb = find_chunk(b, ca.type);
+    if (!cb) {
+      diff.chunks.push_back({ca.type, DiffKind::Removed, ca.size, 0});
+    } else if (ca.hash != cb->hash || ca.size != cb->size) {
+      diff.chunks.push_back({ca.type, DiffKind::Changed, ca.size, cb->size});
+    }
+  }
+  for (auto& cb : b.chunks) {
+    if (!find_chunk(a, cb.type)) {
+      diff.chunks.push_back({cb.type, DiffKind::Added, 0, cb.size});
+    }
+  }
+
+  if (diff.chunks.empty()) {
+    return diff;
+  }
+
+  const bool palettes_same = same_chunks(a, b, {"PPAL", "PALX", "PALB"});
+
+  std::vector<uint64_t> palettes_a, palettes_b;
+  if (!palettes_same || !same_chunks(a, b, {"SPRG", "SPRX", "TILE"})) {
+    palettes_a = palette_hashes(a, pool);
+    palettes_b = palette_hashes(b, pool);
+  }
+
+  if (!palettes_same) {
+    diff.palettes = compare(palettes_a, palettes_b);
+  }
+
+  if (!palettes_same || !same_chunks(a, b, {"SPRG", "SPRX"})) {
+    diff.sprites = compare(sprite_hashes(a, palettes_a, pool), sprite_hashes(b, palettes_b, pool));
+  }
+
+  if (!palettes_same || !same_chunks(a, b, {"TILE"})) {
+    diff.tiles = compare(tile_hashes(a, palettes_a, pool), tile_hashes(b, palettes_b, pool));
+  }
+
+  if (!same_chunks(a, b, {"DELS", "DELX"})) {
+    diff.deltas = compare(delta_hashes(a, pool), delta_hashes(b, pool));
+  }
+
+  if (!same_chunks(a, b, {"CARI"})) {
+    diff.cars = compare(car_hashes(a, pool), car_hashes(b, pool));
+  }
+
+  return diff;
+}
+
+static StyleLoadStatus read_source(const char* filename, StyleSource& source) {
+  std::vector<uint8_t> buf;
+  auto status = read_style_file(filename, buf);
+  if (status != StyleLoadStatus::Ok) {
+    return status;
+  }
+  return decode_style_source(buf.data(), buf.size(), source);
+}
+
+StyleLoadStatus diff_style_files(const char* a, const char* b, StyleDiff& diff, ThreadPool* pool) {
+  StyleSource source_a, source_b;
+  StyleLoadStatus status_a, status_b;
+
+  if (pool) {
+    auto pending = pool->submit([&] { status_b = read_source(b, source_b); });
+    status_a = read_source(a, source_a);
+    pending.wait();
+  } else {
+    status_a = read_source(a, source_a);
+    status_b = read_source(b, source_b);
+  }
+
+  if (status_a != StyleLoadStatus::Ok) return status_a;
+  if (status_b != StyleLoadStatus::Ok) return status_b;
+
+  diff = diff_styles(source_a, source_b, pool);
+  return StyleLoadStatus::Ok;
+}
+
+static void write_items(JsonWriter& json, const char* name, const std::vector<ItemDiff>& items) {
+  json.key(name);
+  json.begin_array();
+  for (auto& item : items) {
+    json.begin_object();
+    json.field("id", item.id);
+    json.field("change", to_string(item.kind));
+    json.end_object();
+  }
+  json.end_array();
+}
+
+std::string to_json(const StyleDiff& diff) {
+  JsonWriter json;
+  json.begin_object();
+
+  json.key("chunks");
+  json.begin_array();
+  for (auto& chunk : diff.chunks) {
+    char type[5] = { };
+    memcpy(type, chunk.type.name, 4);
+
+    json.begin_object();
+    json.field("type", type);
+    json.field("change", to_string(chunk.kind));
+    json.field("old_size", chunk.old_size);
+    json.field("new_size", chunk.new_size);
+    json.end_object();
+  }
+  json.end_array();
+
+  write_items(json, "palettes", diff.palettes);
+  write_items(json, "sprites", diff.sprites);
+  write_items(json, "tiles", diff.tiles);
+  write_items(json, "deltas", diff.deltas);
+  write_items(json, "cars", diff.cars);
+
+  json.end_object();
+  return json.str();
+}
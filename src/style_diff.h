@@ -0,0 +1,52 @@
+#pragma once
+
+#include "styles.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+enum class DiffKind : uint8_t {
+  Added,
+  Removed,
+  Changed,
+};
+
+const char* to_string(DiffKind kind);
+
+struct ChunkDiff {
+  ChunkType type;
+  DiffKind kind;
+  uint32_t old_size;
+  uint32_t new_size;
+};
+
+struct ItemDiff {
+  uint32_t id;
+  DiffKind kind;
+};
+
+// StyleDiff lists what differs between two style files. Items are compared
+// by id, a sprite or tile counts as changed if its pixels or the palette it
+// is drawn with differ. Deltas are numbered like Styles::deltas.
+struct StyleDiff {
+  std::vector<ChunkDiff> chunks;
+  std::vector<ItemDiff> palettes; // physical palettes
+  std::vector<ItemDiff> sprites;
+  std::vector<ItemDiff> tiles;
+  std::vector<ItemDiff> deltas;
+  std::vector<ItemDiff> cars;
+
+  bool empty() const { return chunks.empty(); }
+};
+
+// diff_styles compares two decoded style files. Items are only hashed for
+// the kinds whose chunks differ, in parallel on pool if one is given.
+StyleDiff diff_styles(const StyleSource& a, const StyleSource& b, ThreadPool* pool = nullptr);
+
+// diff_style_files reads and decodes both files, concurrently if a pool is
+// given, and compares them.
+StyleLoadStatus diff_style_files(const char* a, const char* b, StyleDiff& diff, ThreadPool* pool = nullptr);
+
+std::string to_json(const StyleDiff& diff);
@@ -0,0 +1,183 @@
+#pragma once
+
+// Chunk level data of a GTA2 style (.sty) file as it is decoded from disk,
+// before sprites and tiles are imported into RGBA.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+struct Color {
+  uint8_t r, g, b, a;
+};
+static_assert(sizeof(Color) == 4);
+
+struct ChunkType {
+  char name[4];
+
+  bool operator==(const ChunkType&) const = default;
+};
+
+constexpr size_t kVirtualPaletteTableSize = 16384;
+
+struct VirtualPaletteTable {
+  uint16_t map[kVirtualPaletteTableSize]; // Virtual index to 'physical' index.
+};
+static_assert(sizeof(VirtualPaletteTable) == kVirtualPaletteTableSize * sizeof(uint16_t));
+
+// kPaletteSize is the number of colors stored in a single palette.
+constexpr size_t kPhysicalPaletteSize = 256;
+
+struct PhysicalPalette {
+  Color colors[kPhysicalPaletteSize];
+};
+
+using PhysicalPalettes = std::vector<PhysicalPalette>;
+
+constexpr size_t kTileDim = 64;
+
+struct Tile {
+  uint8_t colors[kTileDim * kTileDim];
+};
+
+using Tiles = std::vector<Tile>;
+
+using SpriteStore = std::vector<uint8_t>;
+
+struct GTASprite {
+  uint32_t offset; // sprite store offset
+  uint8_t width;
+  uint8_t height;
+};
+
+using GTASprites = std::vector<GTASprite>;
+
+struct SpriteBase {
+  uint16_t offset;
+  uint16_t count;
+};
+
+struct SpriteBases {
+  SpriteBase car;
+  SpriteBase ped;
+  SpriteBase code; // code object
+  SpriteBase map;  // map object
+  SpriteBase user;
+  SpriteBase font;
+};
+
+struct PaletteBase {
+  uint16_t offset;
+  uint16_t count;
+};
+
+struct PaletteBases {
+  PaletteBase tile;
+  PaletteBase sprite;
+  PaletteBase car;  // car remap
+  PaletteBase ped;  // ped remap
+  PaletteBase code; // code object remap
+  PaletteBase map;  // map object remap
+  PaletteBase user; // user remap
+  PaletteBase font; // font remap
+};
+
+using CarModelNumber = uint8_t;
+
+using DeltaStore = std::vector<uint8_t>;
+
+// DeltaSet uses the same palette as the sprite.
+struct DeltaSet {
+  uint16_t sprite; // sprite number
+  std::vector<uint16_t> sizes; // size in bytes of each of the deltas in this set
+};
+
+using Deltas = std::vector<DeltaSet>;
+
+struct FontBase {
+  uint16_t offset;
+  uint16_t count;
+};
+
+using FontBases = std::vector<FontBase>;
+
+struct MapObject {
+  uint8_t model; // object model number
+  uint8_t sprites; // number of sprites stored for this model
+};
+
+using MapObjects = std::vector<MapObject>;
+
+enum SurfaceType : uint8_t {
+  SurfaceType_Grass = 0,
+  SurfaceType_RoadSpecial = 1,
+  SurfaceType_Water = 2,
+  SurfaceType_Electrified = 3,
+  SurfaceType_ElectrifiedPlatform = 4,
+  SurfaceType_WoodFloor = 5,
+  SurfaceType_MetalFloor = 6,
+  SurfaceType_MetalWall = 7,
+  SurfaceType_GrassWall = 8,
+
+  SurfaceType_Count
+};
+
+using SurfaceTiles = std::vector<uint16_t>;
+using Surfaces = std::vector<SurfaceTiles>;
+
+struct Door {
+  int8_t relativeX;           // X position relative to the center of the car.
+  int8_t relativeY;           // Y position relative to the center of the car.
+};
+
+struct Car {
+  uint8_t model;              // Car model number.
+  uint8_t sprite;             // Relative car sprite number.
+  uint8_t width;              // Width of the car in pixels. Might be different than the sprite width (collision detection).
+  uint8_t height;             // Height of the car in pixels. Might be different than the sprite height (collision detection).
+  uint8_t num_remaps;
+  uint8_t passengers;         // Number of passengers the car can carry.
+  uint8_t wreck;              // Wreck graphic number to use when this car is wrecked (0-8, or 99 if can't wreck).
+  uint8_t rating;             // Quality rating for this car used to decide how often it is created in different areas of the city.
+  int8_t front_wheel_offset;    // Distance from the center of the car to the front axle.
+  int8_t rear_wheel_offset;     // Distance from the center of the car to the back axle.
+  int8_t front_window_offset;   // Distance from the center of the car to the front window.
+  int8_t rear_window_offset;    // Distance from the center of the car to the back window.
+  uint8_t info_flags;
+  uint8_t info_flags2;
+  std::vector<uint8_t> remap; // Virtual palette numbers, representing all of the alternative palettes which can sensibly be applied to this car. Note that these palette numbers are relative to the start of the car remap palette area.
+  uint8_t num_doors;
+  std::vector<Door> doors;
+};
+
+using Cars = std::vector<Car>;
+
+// StyleChunk is an entry of the chunk directory of a style file.
+struct StyleChunk {
+  ChunkType type;
+  uint32_t offset; // file offset of the chunk data
+  uint32_t size;
+  uint64_t hash;   // hash64 of the chunk data
+};
+
+// StyleSource holds every decoded chunk of a style file. Sprites, tiles
+// and deltas are imported from it and re-imported from it on reload.
+struct StyleSource {
+  uint16_t version = 0;
+  std::vector<StyleChunk> chunks;
+
+  VirtualPaletteTable vtable = { };
+  PhysicalPalettes palettes;
+  PaletteBases palette_bases = { };
+  SpriteBases sprite_bases = { };
+  SpriteStore sprite_store;
+  GTASprites sprites;
+  DeltaStore delta_store;
+  Deltas deltas;
+  Tiles tiles;
+  FontBases font_bases;
+  MapObjects map_objects;
+  Surfaces surfaces;
+  std::vector<CarModelNumber> recyclable_cars;
+  Cars cars;
+};
@@ -0,0 +1,108 @@
+#include "style_loader.h"
+#include "thread_pool.h"
+#include "trace.h"
+#include <assert.h>
+#include <mutex>
+#include <string>
+#include <thread>
+
+struct StyleLoadTask::State {
+  Styles styles;
+  std::atomic<bool> cancel = false;
+  std::promise<StyleLoadStatus> promise;
+  std::shared_future<StyleLoadStatus> future = promise.get_future().share();
+
+  mutable std::mutex progress_mutex;
+  StyleLoadProgress progress = { };
+};
+
+bool StyleLoadTask::valid() const {
+  return m_state != nullptr;
+}
+
+bool StyleLoadTask::ready() const {
+  assert(valid());
+  return m_state->future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+void StyleLoadTask::cancel() {
+  assert(valid());
+  m_state->cancel.store(true, std::memory_order_relaxed);
+}
+
+StyleLoadStatus StyleLoadTask::wait() const {
+  assert(valid());
+  return m_state->future.get();
+}
+
+std::shared_future<StyleLoadStatus> StyleLoadTask::future() const {
+  assert(valid());
+  return m_state->future;
+}
+
+StyleLoadProgress StyleLoadTask::progress() const {
+  assert(valid());
+  std::lock_guard lock(m_state->progress_mutex);
+  return m_state->progress;
+}
+
+Styles& StyleLoadTask::styles() {
+  assert(ready() && wait() == StyleLoadStatus::Ok);
+  return m_state->styles;
+}
+
+StyleLoadTask load_styles_async(const char* filename, StyleLoadCallbacks callbacks) {
+  StyleLoadTask task;
+  task.m_state = std::make_shared<StyleLoadTask::State>();
+
+  std::thread([state = task.m_state, path = std::string(filename), callbacks = std::move(callbacks)] {
+    StyleLoadOptions options;
+    options.cancel = &state->cancel;
+    options.on_progress = [&](const StyleLoadProgress& progress) {
+      {
+        std::lock_guard lock(state->progress_mutex);
+        state->progress = progress;
+      }
+      if (callbacks.on_progress) {
+        callbacks.on_progress(progress);
+      }
+    };
+
+    StyleLoadStatus status = state->styles.load(path.c_str(), options);
+    if (callbacks.on_complete) {
+      callbacks.on_complete(status, state->styles);
+    }
+    state->promise.set_value(status);
+  }).detach();
+
+  return task;
+}
+
+std::vector<StyleLoadResult> load_styles(const std::vector<std::string>& paths, ThreadPool& pool) {
+  TRACE_SCOPE("load_styles");
+
+  std::vector<StyleLoadResult> results(paths.size());
+  std::vector<std::future<void>> pending;
+  pending.reserve(paths.size());
+
+  for (size_t i = 0; i < paths.size(); ++i) {
+    auto& result = results[i];
+    result.path = paths[i];
+
+    auto buf = std::make_shared<std::vector<uint8_t>>();
+    result.status = read_style_file(result.path.c_str(), *buf);
+    if (result.status != StyleLoadStatus::Ok) {
+      continue;
+    }
+
+    pending.push_back(pool.submit([&result, buf] {
+      result.status = result.styles.load_from_memory(buf->data(), buf->size());
+    }));
+  }
+
+  for (auto& p : pending) {
+    p.wait();
+  }
+
+  return results;
+}
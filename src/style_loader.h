@@ -0,0 +1,56 @@
+#pragma once
+
+#include "styles.h"
+#include <future>
+#include <memory>
+#include <string>
+
+class ThreadPool;
+
+struct StyleLoadCallbacks {
+  // Called on the loading thread, see StyleLoadOptions::on_progress.
+  std::function<void(const StyleLoadProgress&)> on_progress;
+
+  // Called on the loading thread once the load has finished, failed or
+  // been cancelled. The styles are only populated for StyleLoadStatus::Ok.
+  std::function<void(StyleLoadStatus, Styles&)> on_complete;
+};
+
+// StyleLoadTask is a handle to a style being loaded on a background thread.
+// Dropping the last handle does not stop the load, call cancel() first if
+// the result is no longer needed.
+class StyleLoadTask {
+  private:
+    struct State;
+    std::shared_ptr<State> m_state;
+
+    friend StyleLoadTask load_styles_async(const char* filename, StyleLoadCallbacks callbacks);
+
+  public:
+    bool valid() const;
+    bool ready() const;
+
+    // cancel requests the load to stop at the next chunk or import batch.
+    void cancel();
+
+    StyleLoadStatus wait() const;
+    std::shared_future<StyleLoadStatus> future() const;
+    StyleLoadProgress progress() const;
+
+    // styles returns the loaded styles, must only be called after the task
+    // has completed with StyleLoadStatus::Ok.
+    Styles& styles();
+};
+
+StyleLoadTask load_styles_async(const char* filename, StyleLoadCallbacks callbacks = {});
+
+struct StyleLoadResult {
+  std::string path;
+  StyleLoadStatus status;
+  Styles styles; // only populated for StyleLoadStatus::Ok
+};
+
+// load_styles loads every style in paths concurrently. Files are read one
+// after another on the calling thread while the pool decodes the ones that
+// have already been read. Results are returned in the order of paths.
+std::vector<StyleLoadResult> load_styles(const std::vector<std::string>& paths, ThreadPool& pool);
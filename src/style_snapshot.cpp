@@ -0,0 +1,318 @@
+#include "style_snapshot.h"
+#include "trace.h"
+#include <string.h>
+#include <algorithm>
+#include <unordered_set>
+
+const uint8_t* StyleSnapshot::sprite_row(size_t i, uint32_t y) const {
+  size_t offset = sprites[i].offset + y * kSpriteStorePitch;
+  return sprite_store.page(offset / kSpriteStorePageBytes).data() + offset % kSpriteStorePageBytes;
+}
+
+uint8_t* StyleSnapshot::edit_sprite_row(size_t i, uint32_t y) {
+  size_t offset = sprites[i].offset + y * kSpriteStorePitch;
+  return sprite_store.edit(offset, sprites[i].width).data();
+}
+
+void StyleSnapshot::write_sprite(size_t i, const uint8_t* indices) {
+  auto& sprite = sprites[i];
+  for (uint32_t y = 0; y < sprite.height; ++y) {
+    memcpy(edit_sprite_row(i, y), indices + y * sprite.width, sprite.width);
+  }
+}
+
+bool StyleSnapshot::replace_sprite(size_t i, uint32_t width, uint32_t height, const uint8_t* indices) {
+  if (width > UINT8_MAX || height > UINT8_MAX) {
+    return false;
+  }
+
+  const SpriteResize resize = {.sprite = i, .width = uint8_t(width), .height = uint8_t(height)};
+  if (!resize_sprites({&resize, 1})) {
+    return false;
+  }
+
+  write_sprite(i, indices);
+  return true;
+}
+
+// pack_sprites lays out sprites with the sizes of layout on as few store
+// pages as it can. Sprites flagged in blank are left blank, the pixels of
+// the others are copied over.
+static void pack_sprites(StyleSnapshot& snapshot, const std::vector<GTASprite>& layout, const std::vector<uint8_t>& blank) {
+  std::vector<uint32_t> order(layout.size());
+  for (uint32_t i = 0; i < order.size(); ++i) order[i] = i;
+  std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return layout[a].height > layout[b].height; });
+
+  std::vector<GTASprite> packed(layout.size());
+  std::vector<uint8_t> store;
+  size_t page = 0, x = 0, y = 0, shelf = 0;
+
+  for (auto i : order) {
+    auto& sprite = layout[i];
+    if (x + sprite.width > kSpriteStorePitch) {
+      x = 0;
+      y += shelf;
+      shelf = 0;
+    }
+    if (y + sprite.height > kSpriteStorePitch) {
+      page++;
+      x = 0;
+      y = 0;
+      shelf = 0;
+    }
+
+    size_t offset = page * kSpriteStorePageBytes + y * kSpriteStorePitch + x;
+    store.resize((page + 1) * kSpriteStorePageBytes);
+
+    // Pixels are read with the size the sprite has in the snapshot, blank
+    // ones may have grown past their old rect.
+    if (!blank[i]) {
+      for (uint32_t row = 0; row < sprite.height; ++row) {
+        memcpy(store.data() + offset + row * kSpriteStorePitch, snapshot.sprite_row(i, row), sprite.width);
+      }
+    }
+
+    packed[i] = {.offset = uint32_t(offset), .width = sprite.width, .height = sprite.height};
+    x += sprite.width;
+    shelf = std::max<size_t>(shelf, sprite.height);
+  }
+
+  snapshot.sprites = CowArray<GTASprite, 256>(packed);
+  snapshot.sprite_store = CowArray<uint8_t, kSpriteStorePageBytes>(store);
+}
+
+bool StyleSnapshot::resize_sprites(std::span<const SpriteResize> resizes) {
+  bool repack = false;
+  for (auto& resize : resizes) {
+    if (resize.sprite >= sprites.size()) {
+      return false;
+    }
+
+    auto& old = sprites[resize.sprite];
+    if (resize.width != old.width || resize.height != old.height) {
+      for (auto& set : base->deltas) {
+        if (set.sprite == resize.sprite) return false;
+      }
+    }
+    repack |= resize.width > old.width || resize.height > old.height;
+  }
+
+  if (repack) {
+    TRACE_SCOPE("repack_sprites");
+
+    std::vector<GTASprite> layout(sprites.size());
+    sprites.copy_to(layout.data());
+    std::vector<uint8_t> blank(sprites.size());
+    for (auto& resize : resizes) {
+      layout[resize.sprite].width = resize.width;
+      layout[resize.sprite].height = resize.height;
+      blank[resize.sprite] = 1;
+    }
+
+    pack_sprites(*this, layout, blank);
+    return true;
+  }
+
+  // Clear the old rects so no stale pixels stay behind in the pages.
+  for (auto& resize : resizes) {
+    auto& old = sprites[resize.sprite];
+    for (uint32_t y = 0; y < old.height; ++y) {
+      memset(edit_sprite_row(resize.sprite, y), 0, old.width);
+    }
+
+    auto& sprite = sprites.edit(resize.sprite);
+    sprite.width = resize.width;
+    sprite.height = resize.height;
+  }
+  return true;
+}
+
+void StyleSnapshot::repack_sprites() {
+  TRACE_SCOPE("repack_sprites");
+
+  std::vector<GTASprite> layout(sprites.size());
+  sprites.copy_to(layout.data());
+  pack_sprites(*this, layout, std::vector<uint8_t>(sprites.size()));
+}
+
+uint16_t StyleSnapshot::sprite_palette(size_t i) const {
+  return virtual_palettes[base->palette_bases.sprite.offset + i];
+}
+
+uint16_t StyleSnapshot::tile_palette(size_t i) const {
+  return virtual_palettes[base->palette_bases.tile.offset + i];
+}
+
+StyleSnapshot make_snapshot(const StyleSource& source) {
+  TRACE_SCOPE("make_snapshot");
+
+  auto base = std::make_shared<StyleSource>(source);
+  base->palettes.clear();
+  base->tiles.clear();
+  base->sprites.clear();
+  base->sprite_store.clear();
+
+  return {
+    .base = std::move(base),
+    .palettes = CowArray<PhysicalPalette, 16>(source.palettes),
+    .virtual_palettes = CowArray<uint16_t, 1024>(source.vtable.map),
+    .tiles = CowArray<Tile, 4>(source.tiles),
+    .sprites = CowArray<GTASprite, 256>(source.sprites),
+    .sprite_store = CowArray<uint8_t, kSpriteStorePageBytes>(source.sprite_store),
+  };
+}
+
+StyleSource snapshot_source(const StyleSnapshot& snapshot) {
+  StyleSource source = *snapshot.base;
+
+  source.palettes.resize(snapshot.palettes.size());
+  snapshot.palettes.copy_to(source.palettes.data());
+  snapshot.virtual_palettes.copy_to(source.vtable.map);
+  source.tiles.resize(snapshot.tiles.size());
+  snapshot.tiles.copy_to(source.tiles.data());
+  source.sprites.resize(snapshot.sprites.size());
+  snapshot.sprites.copy_to(source.sprites.data());
+  source.sprite_store.resize(snapshot.sprite_store.size());
+  snapshot.sprite_store.copy_to(source.sprite_store.data());
+
+  return source;
+}
+
+// diff_items appends the indices of the items of a and b that differ,
+// comparing only the pages they don't share.
+template <typename T, size_t N>
+static void diff_items(const CowArray<T, N>& a, const CowArray<T, N>& b, std::vector<uint32_t>& diff) {
+  if (a.same(b)) return;
+
+  for (size_t page = 0; page < a.page_count(); ++page) {
+    if (a.same_page(b, page)) continue;
+
+    auto pa = a.page(page);
+    auto pb = b.page(page);
+    for (size_t i = 0; i < pa.size(); ++i) {
+      if (memcmp(&pa[i], &pb[i], sizeof(T)) != 0) {
+        diff.push_back(static_cast<uint32_t>(page * N + i));
+      }
+    }
+  }
+}
+
+static bool same_sprite(const StyleSnapshot& a, const StyleSnapshot& b, size_t i) {
+  auto& sa = a.sprites[i];
+  auto& sb = b.sprites[i];
+  if (sa.offset != sb.offset || sa.width != sb.width || sa.height != sb.height) {
+    return false;
+  }
+  if (sa.width == 0 || sa.height == 0) {
+    return true;
+  }
+
+  size_t first_page = sa.offset / kSpriteStorePageBytes;
+  size_t last_page = (sa.offset + (sa.height - 1) * kSpriteStorePitch + sa.width - 1) / kSpriteStorePageBytes;
+  bool shared = true;
+  for (size_t page = first_page; page <= last_page && shared; ++page) {
+    shared = page < a.sprite_store.page_count() && page < b.sprite_store.page_count() && a.sprite_store.same_page(b.sprite_store, page);
+  }
+  if (shared) {
+    return true;
+  }
+
+  for (uint32_t y = 0; y < sa.height; ++y) {
+    if (memcmp(a.sprite_row(i, y), b.sprite_row(i, y), sa.width) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool diff_snapshots(const StyleSnapshot& from, const StyleSnapshot& to, SnapshotDiff& diff) {
+  TRACE_SCOPE("diff_snapshots");
+
+  diff = { };
+
+  bool comparable = from.palettes.size() == to.palettes.size() &&
+    from.virtual_palettes.size() == to.virtual_palettes.size() &&
+    from.tiles.size() == to.tiles.size() &&
+    from.sprites.size() == to.sprites.size();
+  if (!comparable) {
+    return false;
+  }
+
+  diff_items(from.palettes, to.palettes, diff.palettes);
+  diff_items(from.virtual_palettes, to.virtual_palettes, diff.virtual_palettes);
+  diff_items(from.tiles, to.tiles, diff.tiles);
+
+  if (!from.sprites.same(to.sprites) || !from.sprite_store.same(to.sprite_store)) {
+    for (size_t i = 0; i < to.sprites.size(); ++i) {
+      if (!same_sprite(from, to, i)) {
+        diff.sprites.push_back(static_cast<uint32_t>(i));
+      }
+    }
+  }
+
+  return true;
+}
+
+StyleHistory::StyleHistory(StyleSnapshot initial, size_t limit) : m_current(std::move(initial)), m_limit(limit) {
+}
+
+void StyleHistory::commit(StyleSnapshot snapshot) {
+  m_undo.push_back(std::move(m_current));
+  m_current = std::move(snapshot);
+  m_redo.clear();
+
+  if (m_limit != 0 && m_undo.size() > m_limit) {
+    m_undo.erase(m_undo.begin());
+  }
+}
+
+bool StyleHistory::undo() {
+  if (m_undo.empty()) {
+    return false;
+  }
+
+  m_redo.push_back(std::move(m_current));
+  m_current = std::move(m_undo.back());
+  m_undo.pop_back();
+  return true;
+}
+
+bool StyleHistory::redo() {
+  if (m_redo.empty()) {
+    return false;
+  }
+
+  m_undo.push_back(std::move(m_current));
+  m_current = std::move(m_redo.back());
+  m_redo.pop_back();
+  return true;
+}
+
+template <typename T, size_t N>
+static size_t count_pages(const CowArray<T, N>& array, std::unordered_set<const void*>& seen) {
+  size_t bytes = 0;
+  for (size_t page = 0; page < array.page_count(); ++page) {
+    if (seen.insert(array.page_id(page)).second) {
+      bytes += array.page(page).size_bytes();
+    }
+  }
+  return bytes;
+}
+
+size_t StyleHistory::bytes() const {
+  std::unordered_set<const void*> seen;
+  size_t bytes = 0;
+
+  auto count = [&](const StyleSnapshot& snapshot) {
+    bytes += count_pages(snapshot.palettes, seen);
+    bytes += count_pages(snapshot.virtual_palettes, seen);
+    bytes += count_pages(snapshot.tiles, seen);
+    bytes += count_pages(snapshot.sprites, seen);
+    bytes += count_pages(snapshot.sprite_store, seen);
+  };
+
+  for (auto& snapshot : m_undo) count(snapshot);
+  for (auto& snapshot : m_redo) count(snapshot);
+  count(m_current);
+  return bytes;
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "cow_array.h"
+#include "style_format.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <span>
+#include <vector>
+
+// Style snapshots are versions of the editable parts of a StyleSource:
+// palettes, the virtual palette table, tiles and sprite pixels. Snapshots
+// share every page they have in common, so taking one is O(1) and an edit
+// only copies the pages it touches, whatever the size of the style.
+//
+//   StyleHistory history(make_snapshot(styles.source));
+//
+//   StyleSnapshot next = history.current();
+//   next.palettes.edit(3).colors[17] = {255, 0, 0, 255};
+//
+//   SnapshotDiff diff;
+//   diff_snapshots(history.current(), next, diff);
+//   styles.apply_snapshot(next, diff, changes);
+//   history.commit(std::move(next));
+
+// Sprite store pages are SPRG pages of 256 x 256 palette indices.
+constexpr size_t kSpriteStorePitch = 256;
+constexpr size_t kSpriteStorePageBytes = kSpriteStorePitch * kSpriteStorePitch;
+
+// SpriteResize gives sprite a new width and height.
+struct SpriteResize {
+  size_t sprite;
+  uint8_t width;
+  uint8_t height;
+};
+
+struct StyleSnapshot {
+  // Everything that isn't edited, with the tables below left empty.
+  std::shared_ptr<const StyleSource> base;
+
+  CowArray<PhysicalPalette, 16> palettes;
+  CowArray<uint16_t, 1024> virtual_palettes;
+  CowArray<Tile, 4> tiles;
+  CowArray<GTASprite, 256> sprites;
+  CowArray<uint8_t, kSpriteStorePageBytes> sprite_store;
+
+  // sprite_row returns the palette indices of row y of sprite i.
+  const uint8_t* sprite_row(size_t i, uint32_t y) const;
+  uint8_t* edit_sprite_row(size_t i, uint32_t y);
+
+  // write_sprite replaces the pixels of sprite i with width x height
+  // palette indices. The sprite keeps its size and place in the store.
+  void write_sprite(size_t i, const uint8_t* indices);
+
+  // replace_sprite gives sprite i a new size and pixels, see resize_sprites.
+  bool replace_sprite(size_t i, uint32_t width, uint32_t height, const uint8_t* indices);
+
+  // resize_sprites gives sprites new sizes and blanks their pixels, to be
+  // written with write_sprite. Sprites stay in place if they fit the rect
+  // they had, otherwise every sprite is repacked once for the whole batch,
+  // see repack_sprites. Sprites that deltas apply to can't change size,
+  // returns false without changing anything if one would.
+  bool resize_sprites(std::span<const SpriteResize> resizes);
+
+  // repack_sprites lays all sprites out again on as few store pages as
+  // shelf packing, tallest first, manages.
+  void repack_sprites();
+
+  // sprite_palette and tile_palette return the physical palette index of
+  // sprite or tile i.
+  uint16_t sprite_palette(size_t i) const;
+  uint16_t tile_palette(size_t i) const;
+};
+
+// make_snapshot copies the editable tables of source into pages.
+StyleSnapshot make_snapshot(const StyleSource& source);
+
+// snapshot_source rebuilds a whole StyleSource from snapshot, e.g. to
+// encode it. The chunk hashes are those of the file it was loaded from.
+StyleSource snapshot_source(const StyleSnapshot& snapshot);
+
+// SnapshotDiff lists the items that differ between two snapshots.
+struct SnapshotDiff {
+  std::vector<uint32_t> palettes;
+  std::vector<uint32_t> virtual_palettes;
+  std::vector<uint32_t> tiles;
+  std::vector<uint32_t> sprites;
+
+  bool empty() const { return palettes.empty() && virtual_palettes.empty() && tiles.empty() && sprites.empty(); }
+};
+
+// diff_snapshots compares two snapshots of the same style. Pages both still
+// share are skipped without being read, so the cost is that of the pages
+// edited since they diverged. Returns false if the snapshots have different
+// item counts and can't be compared item by item. The sprite store may
+// differ in size, after a repack.
+bool diff_snapshots(const StyleSnapshot& from, const StyleSnapshot& to, SnapshotDiff& diff);
+
+// StyleHistory is an undo/redo stack of snapshots. Every step only holds
+// the pages that it changed.
+class StyleHistory {
+  private:
+    std::vector<StyleSnapshot> m_undo;
+    std::vector<StyleSnapshot> m_redo;
+    StyleSnapshot m_current;
+    size_t m_limit;
+
+  public:
+    // limit is the number of undo steps kept, 0 for no limit.
+    explicit StyleHistory(StyleSnapshot initial = { }, size_t limit = 0);
+
+    const StyleSnapshot& current() const { return m_current; }
+
+    // commit makes snapshot current, the one it replaces can be restored
+    // with undo. Steps that were undone can't be redone anymore.
+    void commit(StyleSnapshot snapshot);
+
+    bool undo();
+    bool redo();
+
+    size_t undo_steps() const { return m_undo.size(); }
+    size_t redo_steps() const { return m_redo.size(); }
+
+    // bytes counts the pages held by the whole history, each page once
+    // however many snapshots share it.
+    size_t bytes() const;
+};
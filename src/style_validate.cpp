@@ -0,0 +1,399 @@
+#include "style_validate.h"
+#include "hash.h"
+#include "json.h"
+#include "thread_pool.h"
+#include "trace.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+constexpr size_t kSpritePageSize = 256;
+constexpr size_t kDeltaEntryHeaderSize = 3; // u16 offset, u8 length
+constexpr uint16_t kStyleVersion = 700;
+
+// Per check, only the first few bad items are listed one by one.
+constexpr size_t kMaxItemIssues = 16;
+
+const char* to_string(IssueSeverity severity) {
+  switch (severity) {
+    case IssueSeverity::Warning: return "warning";
+    case IssueSeverity::Error:   return "error";
+  }
+  return "unknown";
+}
+
+size_t StyleValidation::errors() const {
+  return size_t(std::count_if(issues.begin(), issues.end(), [](const StyleIssue& issue) {
+    return issue.severity == IssueSeverity::Error;
+  }));
+}
+
+static ChunkType chunk_type(const char* name) {
+  ChunkType type;
+  memcpy(type.name, name, sizeof(type.name));
+  return type;
+}
+
+// IssueList collects issues, or when there is nowhere to put them only
+// remembers whether there was an error.
+class IssueList {
+  private:
+    std::vector<StyleIssue>* m_issues;
+    bool m_failed = false;
+
+  public:
+    explicit IssueList(std::vector<StyleIssue>* issues) : m_issues(issues) { }
+
+    // stop returns true once nothing more can be learned, i.e. after the
+    // first error when issues aren't collected.
+    bool stop() const { return m_failed && !m_issues; }
+    bool failed() const { return m_failed; }
+
+    void add(IssueSeverity severity, const char* chunk, int64_t item, const char* format, ...) {
+      m_failed |= severity == IssueSeverity::Error;
+      if (!m_issues) return;
+
+      char message[256];
+      va_list args;
+      va_start(args, format);
+      vsnprintf(message, sizeof(message), format, args);
+      va_end(args);
+
+      m_issues->push_back({
+        .severity = severity,
+        .chunk = chunk ? chunk_type(chunk) : ChunkType{ },
+        .item = item,
+        .message = message,
+      });
+    }
+
+    // add_item adds the issue of the count'th bad item of a check, see
+    // kMaxItemIssues.
+    template <typename... Args>
+    void add_item(size_t& count, const char* chunk, int64_t item, const char* format, Args... args) {
+      if (count++ < kMaxItemIssues) {
+        add(IssueSeverity::Error, chunk, item, format, args...);
+      } else {
+        m_failed = true;
+      }
+    }
+
+    void add_remaining(size_t count, const char* chunk, const char* what) {
+      if (count > kMaxItemIssues) {
+        add(IssueSeverity::Error, chunk, -1, "%zu more %s", count - kMaxItemIssues, what);
+      }
+    }
+};
+
+static void check_palettes(const StyleSource& source, IssueList& issues) {
+  auto& bases = source.palette_bases;
+  const PaletteBase* all[] = {&bases.tile, &bases.sprite, &bases.car, &bases.ped, &bases.code, &bases.map, &bases.user, &bases.font};
+
+  size_t covered = 0;
+  for (auto base : all) {
+    covered += base->count;
+  }
+  if (covered > kVirtualPaletteTableSize) {
+    issues.add(IssueSeverity::Error, "PALB", -1, "palette bases cover %zu virtual palettes, PALX holds %zu", covered, kVirtualPaletteTableSize);
+  }
+
+  // Every tile and sprite is drawn with its own virtual palette, whatever
+  // the PALB counts say.
+  size_t tiles_end = size_t(bases.tile.offset) + source.tiles.size();
+  size_t sprites_end = size_t(bases.sprite.offset) + source.sprites.size();
+  if (tiles_end > kVirtualPaletteTableSize) {
+    issues.add(IssueSeverity::Error, "TILE", -1, "%zu tiles need virtual palettes up to %zu, PALX holds %zu", source.tiles.size(), tiles_end, kVirtualPaletteTableSize);
+  }
+  if (sprites_end > kVirtualPaletteTableSize) {
+    issues.add(IssueSeverity::Error, "SPRX", -1, "%zu sprites need virtual palettes up to %zu, PALX holds %zu", source.sprites.size(), sprites_end, kVirtualPaletteTableSize);
+  }
+  if (issues.stop()) return;
+
+  size_t used = std::min(kVirtualPaletteTableSize, std::max({covered, tiles_end, sprites_end}));
+  size_t bad = 0;
+  for (size_t i = 0; i < used && !issues.stop(); ++i) {
+    if (source.vtable.map[i] >= source.palettes.size()) {
+      issues.add_item(bad, "PALX", int64_t(i), "virtual palette %zu maps to palette %u, PPAL holds %zu", i, unsigned(source.vtable.map[i]), source.palettes.size());
+    }
+  }
+  issues.add_remaining(bad, "PALX", "virtual palettes past the end of PPAL");
+}
+
+static void check_sprites(const StyleSource& source, IssueList& issues) {
+  auto& bases = source.sprite_bases;
+  size_t counted = size_t(bases.car.count) + bases.ped.count + bases.code.count + bases.map.count + bases.user.count + bases.font.count;
+  if (counted != source.sprites.size()) {
+    issues.add(IssueSeverity::Warning, "SPRB", -1, "sprite bases count %zu sprites, SPRX has %zu", counted, source.sprites.size());
+  }
+
+  size_t bad = 0;
+  for (size_t i = 0; i < source.sprites.size() && !issues.stop(); ++i) {
+    auto& sprite = source.sprites[i];
+    if (sprite.width == 0 || sprite.height == 0) continue;
+
+    size_t x = sprite.offset % kSpritePageSize;
+    size_t end = size_t(sprite.offset) + (sprite.height - 1) * kSpritePageSize + sprite.width;
+
+    if (x + sprite.width > kSpritePageSize) {
+      issues.add_item(bad, "SPRX", int64_t(i), "%ux%u sprite at x %zu runs past the %zu pixel wide page", unsigned(sprite.width), unsigned(sprite.height), x, kSpritePageSize);
+    } else if (end > source.sprite_store.size()) {
+      issues.add_item(bad, "SPRX", int64_t(i), "%ux%u sprite at offset %u ends at %zu, SPRG holds %zu bytes", unsigned(sprite.width), unsigned(sprite.height), sprite.offset, end, source.sprite_store.size());
+    }
+  }
+  issues.add_remaining(bad, "SPRX", "sprites outside of SPRG");
+
+  size_t fonts = 0;
+  for (auto& font : source.font_bases) {
+    fonts += font.count;
+  }
+  if (fonts > bases.font.count) {
+    issues.add(IssueSeverity::Warning, "FONB", -1, "fonts have %zu characters, there are %u font sprites", fonts, unsigned(bases.font.count));
+  }
+
+  size_t objects = 0;
+  for (auto& object : source.map_objects) {
+    objects += object.sprites;
+  }
+  if (objects > bases.map.count) {
+    issues.add(IssueSeverity::Warning, "OBJI", -1, "map objects have %zu sprites, there are %u map object sprites", objects, unsigned(bases.map.count));
+  }
+
+  for (size_t i = 0; i < source.cars.size(); ++i) {
+    if (source.cars[i].sprite >= bases.car.count) {
+      issues.add(IssueSeverity::Warning, "CARI", int64_t(i), "car sprite %u, there are %u car sprites", unsigned(source.cars[i].sprite), unsigned(bases.car.count));
+    }
+  }
+}
+
+// check_delta walks the runs of one delta like import_deltas does, and
+// returns false if a run leaves the delta or the sprite it applies to.
+static bool check_delta(const DeltaStore& store, size_t start, size_t size, const GTASprite& sprite, const char** reason) {
+  size_t end = start + size;
+  size_t pixels = size_t(sprite.width) * sprite.height;
+  size_t position = 0;
+
+  for (size_t cursor = start; cursor < end;) {
+    if (end - cursor < kDeltaEntryHeaderSize) {
+      *reason = "run header past the end of the delta";
+      return false;
+    }
+
+    uint16_t offset;
+    memcpy(&offset, store.data() + cursor, sizeof(offset));
+    uint8_t length = store[cursor + 2];
+    cursor += kDeltaEntryHeaderSize;
+
+    if (end - cursor < length) {
+      *reason = "run data past the end of the delta";
+      return false;
+    }
+    cursor += length;
+
+    position += offset;
+    size_t x = position % kSpritePageSize;
+    size_t y = position / kSpritePageSize;
+    position += length;
+
+    if (length > 0 && x + length + y * sprite.width > pixels) {
+      *reason = "run outside of the sprite";
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static void check_deltas(const StyleSource& source, IssueList& issues) {
+  size_t total = 0;
+  for (auto& set : source.deltas) {
+    for (auto size : set.sizes) {
+      total += size;
+    }
+  }
+  if (total > source.delta_store.size()) {
+    issues.add(IssueSeverity::Error, "DELX", -1, "deltas take %zu bytes, DELS holds %zu", total, source.delta_store.size());
+    return;
+  }
+
+  size_t bad = 0;
+  size_t store_offset = 0;
+  int64_t delta = 0;
+
+  for (size_t i = 0; i < source.deltas.size() && !issues.stop(); ++i) {
+    auto& set = source.deltas[i];
+
+    if (set.sprite >= source.sprites.size()) {
+      issues.add_item(bad, "DELX", int64_t(i), "delta set for sprite %u, SPRX has %zu sprites", unsigned(set.sprite), source.sprites.size());
+    }
+
+    for (auto size : set.sizes) {
+      const char* reason = nullptr;
+      if (set.sprite < source.sprites.size() && !check_delta(source.delta_store, store_offset, size, source.sprites[set.sprite], &reason)) {
+        issues.add_item(bad, "DELS", delta, "delta of sprite %u: %s", unsigned(set.sprite), reason);
+      }
+      store_offset += size;
+      ++delta;
+    }
+  }
+  issues.add_remaining(bad, "DELS", "bad deltas");
+}
+
+bool check_style_source(const StyleSource& source, std::vector<StyleIssue>* issues) {
+  TRACE_SCOPE("check_style_source");
+
+  IssueList list(issues);
+
+  check_palettes(source, list);
+  if (!list.stop()) check_sprites(source, list);
+  if (!list.stop()) check_deltas(source, list);
+
+  return !list.failed();
+}
+
+// check_chunk_directory walks the chunk headers and lists every chunk that
+// fits inside the file.
+static void check_chunk_directory(const uint8_t* data, size_t size, StyleValidation& result, IssueList& issues) {
+  constexpr size_t kHeaderSize = 6;
+  constexpr size_t kChunkHeaderSize = sizeof(ChunkType) + sizeof(uint32_t);
+
+  if (size < kHeaderSize || memcmp(data, "GBST", 4) != 0) {
+    issues.add(IssueSeverity::Error, nullptr, -1, "not a style file, GBST header missing");
+    return;
+  }
+
+  uint16_t version;
+  memcpy(&version, data + 4, sizeof(version));
+  if (version != kStyleVersion) {
+    issues.add(IssueSeverity::Warning, nullptr, -1, "version %u, expected %u", unsigned(version), unsigned(kStyleVersion));
+  }
+
+  size_t cursor = kHeaderSize;
+  while (cursor < size) {
+    if (size - cursor < kChunkHeaderSize) {
+      issues.add(IssueSeverity::Error, nullptr, -1, "truncated chunk header at offset %zu", cursor);
+      return;
+    }
+
+    ChunkChecksum chunk = { };
+    memcpy(&chunk.type, data + cursor, sizeof(chunk.type));
+    memcpy(&chunk.size, data + cursor + sizeof(ChunkType), sizeof(chunk.size));
+    cursor += kChunkHeaderSize;
+
+    char name[5] = { };
+    memcpy(name, chunk.type.name, sizeof(chunk.type.name));
+
+    if (chunk.size > size - cursor) {
+      issues.add(IssueSeverity::Error, name, -1, "%u byte chunk at offset %zu, only %zu bytes left in the file", chunk.size, cursor, size - cursor);
+      return;
+    }
+    chunk.offset = uint32_t(cursor);
+    cursor += chunk.size;
+
+    for (auto& other : result.checksums) {
+      if (other.type == chunk.type) {
+        issues.add(IssueSeverity::Warning, name, -1, "duplicate chunk, the last one wins");
+        break;
+      }
+    }
+
+    switch (validate_style_chunk(chunk.type, data + chunk.offset, chunk.size)) {
+      case schema::ChunkStatus::Ok:
+        break;
+      case schema::ChunkStatus::Unknown:
+        issues.add(IssueSeverity::Warning, name, -1, "unknown chunk type, not loaded");
+        break;
+      case schema::ChunkStatus::Invalid:
+        issues.add(IssueSeverity::Error, name, -1, "%u bytes don't match the chunk layout", chunk.size);
+        break;
+    }
+
+    result.checksums.push_back(chunk);
+  }
+}
+
+StyleValidation validate_style(const uint8_t* data, size_t size, ThreadPool* pool) {
+  TRACE_SCOPE("validate_style");
+
+  StyleValidation result;
+  IssueList issues(&result.issues);
+
+  check_chunk_directory(data, size, result, issues);
+
+  // One chunk per task, TILE and SPRG make up most of a file.
+  parallel_for(pool, result.checksums.size(), 1, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      auto& chunk = result.checksums[i];
+      chunk.crc32c = crc32c(data + chunk.offset, chunk.size);
+    }
+  });
+
+  if (issues.failed()) {
+    return result;
+  }
+
+  StyleSource source;
+  auto status = decode_style_source(data, size, source);
+  if (status != StyleLoadStatus::Ok) {
+    issues.add(IssueSeverity::Error, nullptr, -1, "decoding failed: %s", to_string(status));
+    return result;
+  }
+
+  check_style_source(source, &result.issues);
+  return result;
+}
+
+StyleLoadStatus validate_style_file(const char* filename, StyleValidation& result, ThreadPool* pool) {
+  std::vector<uint8_t> buf;
+  auto status = read_style_file(filename, buf);
+  if (status != StyleLoadStatus::Ok) {
+    return status;
+  }
+
+  result = validate_style(buf.data(), buf.size(), pool);
+  return StyleLoadStatus::Ok;
+}
+
+std::string to_json(const StyleValidation& validation) {
+  JsonWriter json;
+  json.begin_object();
+
+  json.field("ok", validation.ok());
+  json.field("errors", uint64_t(validation.errors()));
+
+  json.key("issues");
+  json.begin_array();
+  for (auto& issue : validation.issues) {
+    char chunk[5] = { };
+    memcpy(chunk, issue.chunk.name, 4);
+
+    json.begin_object();
+    json.field("severity", to_string(issue.severity));
+    json.field("chunk", chunk);
+    json.field("item", issue.item);
+    json.field("message", issue.message);
+    json.end_object();
+  }
+  json.end_array();
+
+  json.key("chunks");
+  json.begin_array();
+  for (auto& chunk : validation.checksums) {
+    char type[5] = { };
+    memcpy(type, chunk.type.name, 4);
+
+    char crc[9];
+    snprintf(crc, sizeof(crc), "%08x", chunk.crc32c);
+
+    json.begin_object();
+    json.field("type", type);
+    json.field("offset", chunk.offset);
+    json.field("size", chunk.size);
+    json.field("crc32c", crc);
+    json.end_object();
+  }
+  json.end_array();
+
+  json.end_object();
+  return json.str();
+}
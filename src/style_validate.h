@@ -0,0 +1,55 @@
+#pragma once
+
+#include "style_format.h"
+#include "styles.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+enum class IssueSeverity {
+  Warning, // unusual but loadable
+  Error,   // the file would be rejected, or read out of bounds, by the loader
+};
+
+const char* to_string(IssueSeverity severity);
+
+struct StyleIssue {
+  IssueSeverity severity;
+  ChunkType chunk = { };    // zeroed for issues with the file header
+  int64_t item = -1;        // record within the chunk, -1 for the whole chunk
+  std::string message;
+};
+
+struct ChunkChecksum {
+  ChunkType type;
+  uint32_t offset; // file offset of the chunk data
+  uint32_t size;
+  uint32_t crc32c;
+};
+
+struct StyleValidation {
+  std::vector<StyleIssue> issues;
+  std::vector<ChunkChecksum> checksums; // in file order, for every chunk that fits the file
+
+  size_t errors() const;
+  bool ok() const { return errors() == 0; }
+};
+
+// validate_style checks every chunk header and length, the layout of every
+// known chunk and the references between chunks, see check_style_source.
+// Chunk checksums are computed on pool when set. Nothing is imported, so
+// broken files are reported without being read out of bounds.
+StyleValidation validate_style(const uint8_t* data, size_t size, ThreadPool* pool = nullptr);
+StyleLoadStatus validate_style_file(const char* filename, StyleValidation& result, ThreadPool* pool = nullptr);
+
+// check_style_source checks that the indices and offsets of decoded chunks
+// stay inside the data they point into: SPRX rects inside SPRG, DELX sets
+// inside DELS and their sprites, PALX entries inside PPAL. Issues are
+// appended to issues when set, otherwise it stops at the first error.
+// Returns false if there are errors.
+bool check_style_source(const StyleSource& source, std::vector<StyleIssue>* issues = nullptr);
+
+std::string to_json(const StyleValidation& validation);
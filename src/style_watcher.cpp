@@ -0,0 +1,109 @@
+#include "style_watcher.h"
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+StyleWatcher::~StyleWatcher() {
+  close();
+}
+
+#if defined(__linux__)
+
+bool StyleWatcher::watch(const char* filename) {
+  close();
+
+  std::filesystem::path path = std::filesystem::absolute(filename);
+  m_path = path.string();
+  m_name = path.filename().string();
+
+  m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (m_fd < 0) {
+    return false;
+  }
+
+  if (inotify_add_watch(m_fd, path.parent_path().c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+    close();
+    return false;
+  }
+
+  return true;
+}
+
+void StyleWatcher::close() {
+  if (m_fd >= 0) {
+    ::close(m_fd);
+    m_fd = -1;
+  }
+}
+
+bool StyleWatcher::changed() {
+  if (m_fd < 0) {
+    return false;
+  }
+
+  bool result = false;
+  alignas(inotify_event) char buf[4096];
+
+  for (;;) {
+    ssize_t len = read(m_fd, buf, sizeof(buf));
+    if (len <= 0) {
+      break;
+    }
+
+    for (ssize_t offset = 0; offset < len;) {
+      auto event = reinterpret_cast<const inotify_event*>(buf + offset);
+      if (event->len > 0 && m_name == event->name) {
+        result = true;
+      }
+      offset += sizeof(inotify_event) + event->len;
+    }
+  }
+
+  return result;
+}
+
+#else
+
+bool StyleWatcher::watch(const char* filename) {
+  std::error_code ec;
+  m_path = filename;
+  m_last_write = std::filesystem::last_write_time(m_path, ec);
+  return !ec;
+}
+
+void StyleWatcher::close() {
+  m_path.clear();
+}
+
+bool StyleWatcher::changed() {
+  if (m_path.empty()) {
+    return false;
+  }
+
+  std::error_code ec;
+  auto last_write = std::filesystem::last_write_time(m_path, ec);
+  if (ec || last_write == m_last_write) {
+    return false;
+  }
+
+  m_last_write = last_write;
+  return true;
+}
+
+#endif
+
+StyleLoadStatus StyleWatcher::poll(Styles& styles, const std::function<void(const StyleChanges&)>& on_change) {
+  if (!changed()) {
+    return StyleLoadStatus::Ok;
+  }
+
+  StyleChanges changes;
+  auto status = styles.reload(m_path.c_str(), changes);
+  if (status == StyleLoadStatus::Ok && !changes.chunks.empty() && on_change) {
+    on_change(changes);
+  }
+
+  return status;
+}
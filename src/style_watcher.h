@@ -0,0 +1,38 @@
+#pragma once
+
+#include "styles.h"
+#include <filesystem>
+#include <functional>
+#include <string>
+
+// StyleWatcher notices when a style file is written and reloads it
+// incrementally. On Linux it uses inotify on the containing directory, so
+// editors that save by renaming a temporary file are picked up too, other
+// platforms compare the modification time on every poll.
+class StyleWatcher {
+  private:
+    std::string m_path;
+#if defined(__linux__)
+    std::string m_name; // file name within the watched directory
+    int m_fd = -1;
+#else
+    std::filesystem::file_time_type m_last_write;
+#endif
+
+    bool changed();
+
+  public:
+    StyleWatcher() = default;
+    ~StyleWatcher();
+
+    StyleWatcher(const StyleWatcher&) = delete;
+    StyleWatcher& operator=(const StyleWatcher&) = delete;
+
+    bool watch(const char* filename);
+    void close();
+
+    // poll checks without blocking whether the file has been written since
+    // the last poll. If it has, it is reloaded into styles and on_change is
+    // called with what the reload affected.
+    StyleLoadStatus poll(Styles& styles, const std::function<void(const StyleChanges&)>& on_change);
+};
@@ -0,0 +1,181 @@
+#include "style_writer.h"
+#include "trace.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <filesystem>
+#include <random>
+
+static int64_t modification_time(const char* filename) {
+  std::error_code ec;
+  auto time = std::filesystem::last_write_time(filename, ec);
+  return ec ? 0 : int64_t(time.time_since_epoch().count());
+}
+
+static const StyleChunk* find_chunk(const std::vector<StyleChunk>& chunks, const char* name) {
+  for (auto& chunk : chunks) {
+    if (memcmp(chunk.type.name, name, 4) == 0) return &chunk;
+  }
+  return nullptr;
+}
+
+// PagePatch is an encoded page and where it goes in the file.
+struct PagePatch {
+  size_t offset;
+  std::vector<uint8_t> bytes;
+};
+
+// sprite_pages adds the store pages the rect of sprite covers to pages.
+static void sprite_pages(const GTASprite& sprite, std::vector<size_t>& pages) {
+  if (sprite.width == 0 || sprite.height == 0) return;
+
+  size_t first = sprite.offset / kStylePageBytes;
+  size_t last = (sprite.offset + (sprite.height - 1) * kSpriteStorePitch + sprite.width - 1) / kStylePageBytes;
+  for (size_t page = first; page <= last; ++page) {
+    pages.push_back(page);
+  }
+}
+
+bool StyleWriter::write_pages(const StyleSnapshot& snapshot, const SnapshotDiff& diff, StyleSaveStats& stats, bool& fits) {
+  std::vector<size_t> palette_pages, tile_pages, sprite_store_pages;
+  bool sprite_entries_changed = false;
+
+  for (auto i : diff.palettes) palette_pages.push_back(i / kPalettesPerStylePage);
+  for (auto i : diff.tiles) tile_pages.push_back(i / kTilesPerStylePage);
+  for (auto i : diff.sprites) {
+    auto& before = m_saved.sprites[i];
+    auto& after = snapshot.sprites[i];
+    sprite_entries_changed |= before.offset != after.offset || before.width != after.width || before.height != after.height;
+    sprite_pages(before, sprite_store_pages);
+    sprite_pages(after, sprite_store_pages);
+  }
+
+  std::vector<PagePatch> patches;
+  fits = true;
+
+  // Pages are encoded before anything is written, a save that doesn't fit
+  // leaves the file as it was.
+  auto add = [&](const char* name, std::vector<size_t> pages) {
+    std::sort(pages.begin(), pages.end());
+    pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+
+    auto chunk = find_chunk(m_chunks, name);
+    for (auto page : pages) {
+      PagePatch patch;
+      fits = fits && chunk && encode_snapshot_page(snapshot, chunk->type, page, patch.bytes);
+      if (!fits) return;
+
+      patch.offset = chunk->offset + page * kStylePageBytes;
+      fits = patch.offset + patch.bytes.size() <= size_t(chunk->offset) + chunk->size;
+      patches.push_back(std::move(patch));
+    }
+  };
+
+  add("PPAL", std::move(palette_pages));
+  add("TILE", std::move(tile_pages));
+  add("SPRG", std::move(sprite_store_pages));
+  if (!diff.virtual_palettes.empty()) add("PALX", {0});
+  if (sprite_entries_changed) add("SPRX", {0});
+
+  // A repack can grow or shrink the sprite store, item counts don't change.
+  auto store = find_chunk(m_chunks, "SPRG");
+  fits = fits && (!store || store->size == snapshot.sprite_store.size());
+
+  if (!fits || patches.empty()) {
+    return true;
+  }
+
+  FILE* f = fopen(m_filename.c_str(), "r+b");
+  if (!f) {
+    return false;
+  }
+
+  bool ok = true;
+  for (auto& patch : patches) {
+    ok = ok && fseek(f, long(patch.offset), SEEK_SET) == 0 && fwrite(patch.bytes.data(), patch.bytes.size(), 1, f) == 1;
+    stats.bytes_written += patch.bytes.size();
+  }
+  ok = fclose(f) == 0 && ok;
+
+  stats.pages_written = patches.size();
+  return ok;
+}
+
+bool StyleWriter::write_file(const char* filename, const StyleSnapshot& snapshot, StyleSaveStats& stats) {
+  std::string name = filename; // may be m_filename
+  reset();
+
+  std::vector<uint8_t> data = encode_styles(snapshot_source(snapshot));
+  std::string temp = name + ".tmp" + std::to_string(std::random_device{}());
+
+  FILE* f = fopen(temp.c_str(), "wb");
+  if (!f) {
+    return false;
+  }
+
+  bool ok = fwrite(data.data(), data.size(), 1, f) == 1;
+  ok = fclose(f) == 0 && ok;
+
+  std::error_code ec;
+  if (ok) {
+    std::filesystem::rename(temp, name, ec);
+  }
+  if (!ok || ec) {
+    std::filesystem::remove(temp, ec);
+    return false;
+  }
+
+  stats.full_write = true;
+  stats.bytes_written = data.size();
+
+  if (!read_chunk_directory(data.data(), data.size(), m_chunks)) {
+    return false;
+  }
+  m_filename = name;
+  m_saved = snapshot;
+  m_file_size = data.size();
+  m_mtime = modification_time(name.c_str());
+  return true;
+}
+
+bool StyleWriter::save(const char* filename, const StyleSnapshot& snapshot, StyleSaveStats* stats) {
+  TRACE_SCOPE("save_style");
+
+  StyleSaveStats ignored;
+  StyleSaveStats& result = stats ? *stats : ignored;
+  result = { };
+
+  // The pages can only be patched if the file still holds the last save of
+  // the same style.
+  std::error_code ec;
+  bool patchable = m_filename == filename &&
+    m_saved.base == snapshot.base &&
+    std::filesystem::file_size(filename, ec) == m_file_size && !ec &&
+    modification_time(filename) == m_mtime;
+
+  SnapshotDiff diff;
+  if (patchable && diff_snapshots(m_saved, snapshot, diff)) {
+    bool fits = false;
+    if (!write_pages(snapshot, diff, result, fits)) {
+      // Some pages may have been written, the file no longer matches m_saved.
+      reset();
+      return false;
+    }
+    if (fits) {
+      m_saved = snapshot;
+      m_mtime = modification_time(filename);
+      return true;
+    }
+    result = { };
+  }
+
+  return write_file(filename, snapshot, result);
+}
+
+void StyleWriter::reset() {
+  m_filename.clear();
+  m_saved = { };
+  m_chunks.clear();
+  m_file_size = 0;
+  m_mtime = 0;
+}
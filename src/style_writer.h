@@ -0,0 +1,41 @@
+#pragma once
+
+#include "style_snapshot.h"
+#include "styles.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct StyleSaveStats {
+  bool full_write = false; // the whole file was encoded and replaced
+  size_t pages_written = 0;
+  size_t bytes_written = 0;
+};
+
+// StyleWriter saves snapshots of a style to a style file. The first save
+// encodes the whole file. Later saves of the same file, while nothing else
+// changed it, only re-encode the PPAL, TILE and SPRG pages holding items
+// that changed since the last save, and PALX and SPRX when they changed,
+// and write them in place. A save falls back to writing the whole file when
+// a chunk changes size, e.g. when repacking sprites needed another page.
+//
+// Whole files are written next to filename and renamed into place, pages
+// written in place are not atomic.
+class StyleWriter {
+  private:
+    std::string m_filename;
+    StyleSnapshot m_saved;
+    std::vector<StyleChunk> m_chunks; // where the chunks of m_saved lie in the file
+    uint64_t m_file_size = 0;
+    int64_t m_mtime = 0;
+
+    bool write_file(const char* filename, const StyleSnapshot& snapshot, StyleSaveStats& stats);
+    bool write_pages(const StyleSnapshot& snapshot, const SnapshotDiff& diff, StyleSaveStats& stats, bool& fits);
+
+  public:
+    bool save(const char* filename, const StyleSnapshot& snapshot, StyleSaveStats* stats = nullptr);
+
+    // reset forgets the last save, the next one writes the whole file.
+    void reset();
+};
@@ -1,579 +1,828 @@
 #include "styles.h"
 #include "io.h"
-#include "ext/string_hash.h"
+#include "hash.h"
+#include "image_hash.h"
+#include "memory_stats.h"
+#include "schema.h"
+#include "style_snapshot.h"
+#include "style_validate.h"
+#include "trace.h"
+#include "trim.h"
+#include <assert.h>
+#include <algorithm>
+
+// kReadBlockSize is how much of the file is read between progress reports.
+constexpr size_t kReadBlockSize = 1024 * 1024;
+
+// kImportBatchSize is how many items are imported between progress reports.
+constexpr size_t kImportBatchSize = 256;
+
+struct LoadContext {
+  const StyleLoadOptions& options;
+  StyleLoadProgress progress = { };
+
+  bool cancelled() const {
+    return options.cancel && options.cancel->load(std::memory_order_relaxed);
+  }
 
-struct ChunkType {
-  char name[4];
-};
+  // report notifies the progress callback and returns false if the load
+  // should stop.
+  bool report() {
+    if (options.on_progress) {
+      options.on_progress(progress);
+    }
+    return !cancelled();
+  }
+
+  bool block_read(size_t bytes) {
+    progress.bytes_read += bytes;
+    TRACE_COUNTER("bytes_read", progress.bytes_read);
+    return report();
+  }
+
+  bool chunk_decoded() {
+    progress.chunks_decoded++;
+    TRACE_COUNTER("chunks_decoded", progress.chunks_decoded);
+    return report();
+  }
+
+  bool item_imported() {
+    progress.items_imported++;
+    if (progress.items_imported % kImportBatchSize != 0) {
+      return true;
+    }
+    TRACE_COUNTER("items_imported", progress.items_imported);
+    return report();
+  }
 
-constexpr size_t kVirtualPaletteTableSize = 16384;
+  // Allocated bytes the load holds and their high-water mark, updated
+  // wherever the load allocates or releases a large block.
+  size_t resident = 0;
+  size_t peak = 0;
 
-struct VirtualPaletteTable {
-  uint16_t map[kVirtualPaletteTableSize]; // Virtual index to 'physical' index.
+  void allocated(size_t bytes) {
+    resident += bytes;
+    peak = std::max(peak, resident);
+  }
+
+  void released(size_t bytes) {
+    resident -= std::min(resident, bytes);
+  }
 };
-static_assert(sizeof(VirtualPaletteTable) == kVirtualPaletteTableSize * sizeof(uint16_t));
 
-static VirtualPaletteTable read_virtual_palette_table(Reader& r, size_t chunk_size) {
-  assert(chunk_size == sizeof(VirtualPaletteTable));
+// The chunk descriptors below declare the on-disk layout of every chunk
+// type once, see schema.h. decode moves the decoded layout into
+// StyleSource, encode produces it back from StyleSource.
 
-  VirtualPaletteTable result;
-  r.read_many<uint16_t>(result.map, kVirtualPaletteTableSize);
-  return result;
-}
+struct PalxChunk {
+  static constexpr schema::FourCC type = "PALX";
+  using Layout = schema::Fixed<VirtualPaletteTable>;
 
-// kPaletteSize is the number of colors stored in a single palette.
-constexpr size_t kPhysicalPaletteSize = 256;
+  static void decode(StyleSource& s, Layout::Decoded&& vtable) {
+    s.vtable = vtable;
+  }
 
-struct PhysicalPalette {
-  Color colors[kPhysicalPaletteSize];
+  static Layout::Decoded encode(const StyleSource& s) {
+    return s.vtable;
+  }
 };
 
-using PhysicalPalettes = std::vector<PhysicalPalette>;
-
-static PhysicalPalettes read_physical_palettes(Reader& r, size_t chunk_size) {
-  assert(chunk_size % sizeof(PhysicalPalette) == 0);
-
-  // Each page contains 64 palettes. Each palette
-  // contains 256 dword colors. Color byte order
-  // is BGRA.
-  //
-  // Within a page palettes are stored interleaved, i.e.
-  // C0P0   - C0P1   - ... - C0P63
-  // C1P0   - C1P1   - ... - C1P63
-  // ...
-  // C255P0 - C255P1 - ... - C255P63
-  //
-  // Where CiPi, is ith color of ith palette.
-
-  auto convert = [](uint32_t color) {
-    // @TODO: palette contains no alpha?
-    return Color{
-      .r = (color >> 16) & 0xff,
-      .g = (color >>  8) & 0xff,
-      .b = (color >>  0) & 0xff,
-      .a = 0xff,
-    };
-  };
+constexpr size_t kPalettesPerPage = 64;
+
+// Each page contains 64 palettes. Each palette
+// contains 256 dword colors. Color byte order
+// is BGRA.
+//
+// Within a page palettes are stored interleaved, i.e.
+// C0P0   - C0P1   - ... - C0P63
+// C1P0   - C1P1   - ... - C1P63
+// ...
+// C255P0 - C255P1 - ... - C255P63
+//
+// Where CiPi, is ith color of ith palette.
+struct PalettePage {
+  uint32_t colors[kPhysicalPaletteSize][kPalettesPerPage];
+};
 
-  constexpr size_t kPageSize = 64;
-  size_t count = chunk_size / sizeof(PhysicalPalette);
-  size_t pages = count / kPageSize;
+struct PpalChunk {
+  static constexpr schema::FourCC type = "PPAL";
+  using Layout = schema::Array<PalettePage>;
+
+  static void decode(StyleSource& s, Layout::Decoded&& pages) {
+    // The palettes have no alpha, transparency comes from palette index 0
+    // and is applied when importing, see palette_color.
+    auto convert = [](uint32_t color) {
+      return Color{
+        .r = uint8_t((color >> 16) & 0xff),
+        .g = uint8_t((color >>  8) & 0xff),
+        .b = uint8_t((color >>  0) & 0xff),
+        .a = 0xff,
+      };
+    };
 
-  PhysicalPalettes result(count);
+    s.palettes.resize(pages.size() * kPalettesPerPage);
 
-  for (size_t page = 0; page < pages; ++page) {
-    for (size_t color = 0; color < kPhysicalPaletteSize; ++color) {
-      for (size_t palette = 0; palette < kPageSize; ++palette) {
-        size_t idx = page * kPageSize + palette;
-        result[idx].colors[color] = convert(r.read<uint32_t>());
+    for (size_t page = 0; page < pages.size(); ++page) {
+      for (size_t color = 0; color < kPhysicalPaletteSize; ++color) {
+        for (size_t palette = 0; palette < kPalettesPerPage; ++palette) {
+          size_t idx = page * kPalettesPerPage + palette;
+          s.palettes[idx].colors[color] = convert(pages[page].colors[color][palette]);
+        }
       }
     }
   }
 
-  return result;
-}
+  static void encode_palette(const PhysicalPalette& palette, size_t idx, PalettePage& page) {
+    for (size_t color = 0; color < kPhysicalPaletteSize; ++color) {
+      auto c = palette.colors[color];
+      page.colors[color][idx % kPalettesPerPage] = uint32_t(c.r) << 16 | uint32_t(c.g) << 8 | uint32_t(c.b);
+    }
+  }
 
-constexpr size_t kTileDim = 64;
+  static Layout::Decoded encode(const StyleSource& s) {
+    Layout::Decoded pages((s.palettes.size() + kPalettesPerPage - 1) / kPalettesPerPage, PalettePage{});
 
-struct Tile {
-  uint8_t colors[kTileDim * kTileDim];
+    for (size_t idx = 0; idx < s.palettes.size(); ++idx) {
+      encode_palette(s.palettes[idx], idx, pages[idx / kPalettesPerPage]);
+    }
+    return pages;
+  }
 };
 
-using Tiles = std::vector<Tile>;
+constexpr size_t kTilePageDimPixels = 256;
+constexpr size_t kTilePageDimTiles = kTilePageDimPixels / kTileDim;
+constexpr size_t kTilesPerPage = kTilePageDimTiles * kTilePageDimTiles;
 
-static Tiles read_tiles(Reader& r, size_t chunk_size) {
-  constexpr size_t kPageDimPixels = 256;
-  constexpr size_t kPageDimTiles = kPageDimPixels / kTileDim;
-  const size_t count = chunk_size / sizeof(Tile);
+// Tiles are stored in 256x256 pages of 4x4 tiles.
+struct TilePage {
+  uint8_t pixels[kTilePageDimPixels * kTilePageDimPixels];
+};
 
-  const uint8_t* data = r.get_ptr<uint8_t>();
-  r.skip(chunk_size);
+struct TileChunk {
+  static constexpr schema::FourCC type = "TILE";
+  using Layout = schema::Array<TilePage>;
 
-  Tiles result(count);
-  for (size_t tile = 0; tile < count; ++tile) {
-    for (size_t y = 0; y < kTileDim; ++y) {
-      for (size_t x = 0; x < kTileDim; ++x) {
-        size_t row = tile / kPageDimTiles;
-        size_t col = tile % kPageDimTiles;
+  static size_t page_index(size_t tile, size_t x, size_t y) {
+    size_t row = (tile % kTilesPerPage) / kTilePageDimTiles;
+    size_t col = (tile % kTilesPerPage) % kTilePageDimTiles;
+    return x + col * kTileDim + (y + row * kTileDim) * kTilePageDimPixels;
+  }
 
-        size_t idx = x + col * kTileDim + (y + row * kTileDim) * kPageDimPixels;
-        result[tile].colors[x + y * kTileDim] = data[idx];
+  static void decode(StyleSource& s, Layout::Decoded&& pages) {
+    s.tiles.resize(pages.size() * kTilesPerPage);
+
+    for (size_t tile = 0; tile < s.tiles.size(); ++tile) {
+      auto& page = pages[tile / kTilesPerPage];
+      for (size_t y = 0; y < kTileDim; ++y) {
+        memcpy(&s.tiles[tile].colors[y * kTileDim], &page.pixels[page_index(tile, 0, y)], kTileDim);
       }
     }
   }
-  return result;
-}
 
-using SpriteStore = std::vector<uint8_t>;
+  static void encode_tile(const Tile& tile, size_t idx, TilePage& page) {
+    for (size_t y = 0; y < kTileDim; ++y) {
+      memcpy(&page.pixels[page_index(idx, 0, y)], &tile.colors[y * kTileDim], kTileDim);
+    }
+  }
 
-static SpriteStore read_sprite_store(Reader& r, size_t chunk_size) {
-  SpriteStore result(chunk_size);
-  r.read_many<uint8_t>(result.data(), chunk_size);
-  return result;
-}
+  static Layout::Decoded encode(const StyleSource& s) {
+    Layout::Decoded pages((s.tiles.size() + kTilesPerPage - 1) / kTilesPerPage, TilePage{});
 
-struct GTASprite {
-  uint32_t offset; // sprite store offset
-  uint8_t width;
-  uint8_t height;
+    for (size_t tile = 0; tile < s.tiles.size(); ++tile) {
+      encode_tile(s.tiles[tile], tile, pages[tile / kTilesPerPage]);
+    }
+    return pages;
+  }
 };
 
-using GTASprites = std::vector<GTASprite>;
+struct SprgChunk {
+  static constexpr schema::FourCC type = "SPRG";
+  using Layout = schema::Array<uint8_t>;
 
-static GTASprites read_sprites(Reader& r, size_t chunk_size) {
-  assert(chunk_size % 8 == 0);
+  static void decode(StyleSource& s, Layout::Decoded&& store) {
+    s.sprite_store = std::move(store);
+  }
 
-  struct GTASpriteTransfer {
-    uint32_t offset; // sprite store offset
-    uint8_t  width;
-    uint8_t  height;
-    uint16_t pad;
-  };
+  static Layout::Decoded encode(const StyleSource& s) {
+    return s.sprite_store;
+  }
+};
 
-  size_t count = chunk_size / sizeof(GTASpriteTransfer);
+struct GTASpriteTransfer {
+  uint32_t offset; // sprite store offset
+  uint8_t  width;
+  uint8_t  height;
+  uint16_t pad;
+};
+static_assert(sizeof(GTASpriteTransfer) == 8);
+
+struct SprxChunk {
+  static constexpr schema::FourCC type = "SPRX";
+  using Layout = schema::Array<GTASpriteTransfer>;
+
+  static void decode(StyleSource& s, Layout::Decoded&& sprites) {
+    s.sprites.resize(sprites.size());
+    for (size_t i = 0; i < sprites.size(); ++i) {
+      s.sprites[i] = GTASprite{
+        .offset = sprites[i].offset,
+        .width = sprites[i].width,
+        .height = sprites[i].height,
+      };
+    }
+  }
 
-  GTASprites result(count);
+  static Layout::Decoded encode(const StyleSource& s) {
+    Layout::Decoded sprites(s.sprites.size());
+    for (size_t i = 0; i < sprites.size(); ++i) {
+      sprites[i] = GTASpriteTransfer{
+        .offset = s.sprites[i].offset,
+        .width = s.sprites[i].width,
+        .height = s.sprites[i].height,
+        .pad = 0,
+      };
+    }
+    return sprites;
+  }
+};
 
-  for (size_t i = 0; i < count; ++i) {
-    auto s = r.read<GTASpriteTransfer>();
-    result[i] = GTASprite{
-      .offset = s.offset,
-      .width = s.width,
-      .height = s.height,
+struct SpriteBaseCounts {
+  uint16_t car;
+  uint16_t ped;
+  uint16_t code; // code object
+  uint16_t map;  // map object
+  uint16_t user;
+  uint16_t font;
+};
+static_assert(sizeof(SpriteBaseCounts) == 12);
+
+struct SprbChunk {
+  static constexpr schema::FourCC type = "SPRB";
+  using Layout = schema::Fixed<SpriteBaseCounts>;
+
+  static void decode(StyleSource& s, Layout::Decoded&& counts) {
+    uint16_t offset = 0;
+    auto next_base = [&offset](uint16_t count) {
+      SpriteBase base = {.offset = offset, .count = count};
+      offset += count;
+      return base;
     };
+
+    SpriteBases result = { };
+    result.car  = next_base(counts.car);
+    result.ped  = next_base(counts.ped);
+    result.code = next_base(counts.code);
+    result.map  = next_base(counts.map);
+    result.user = next_base(counts.user);
+    result.font = next_base(counts.font);
+    s.sprite_bases = result;
   }
 
-  return result;
-}
+  static Layout::Decoded encode(const StyleSource& s) {
+    auto& b = s.sprite_bases;
+    return {b.car.count, b.ped.count, b.code.count, b.map.count, b.user.count, b.font.count};
+  }
+};
 
-struct SpriteBase {
-  uint16_t offset;
-  uint16_t count;
+struct PaletteBaseCounts {
+  uint16_t tile;
+  uint16_t sprite;
+  uint16_t car;  // car remap
+  uint16_t ped;  // ped remap
+  uint16_t code; // code object remap
+  uint16_t map;  // map object remap
+  uint16_t user; // user remap
+  uint16_t font; // font remap
 };
+static_assert(sizeof(PaletteBaseCounts) == 16);
+
+struct PalbChunk {
+  static constexpr schema::FourCC type = "PALB";
+  using Layout = schema::Fixed<PaletteBaseCounts>;
+
+  static void decode(StyleSource& s, Layout::Decoded&& counts) {
+    uint16_t offset = 0;
+    auto next_base = [&offset](uint16_t count) {
+      PaletteBase base = {.offset = offset, .count = count};
+      offset += count;
+      return base;
+    };
 
-struct SpriteBases {
-  SpriteBase car;
-  SpriteBase ped;
-  SpriteBase code; // code object
-  SpriteBase map;  // map object
-  SpriteBase user;
-  SpriteBase font;
+    PaletteBases result = { };
+    result.tile    = next_base(counts.tile);
+    result.sprite  = next_base(counts.sprite);
+    result.car     = next_base(counts.car);
+    result.ped     = next_base(counts.ped);
+    result.code    = next_base(counts.code);
+    result.map     = next_base(counts.map);
+    result.user    = next_base(counts.user);
+    result.font    = next_base(counts.font);
+    s.palette_bases = result;
+  }
+
+  static Layout::Decoded encode(const StyleSource& s) {
+    auto& b = s.palette_bases;
+    return {b.tile.count, b.sprite.count, b.car.count, b.ped.count, b.code.count, b.map.count, b.user.count, b.font.count};
+  }
 };
 
-static SpriteBases read_sprite_bases(Reader& r, size_t chunk_size) {
-  assert(chunk_size == 12);
-
-  struct {
-    uint16_t car;
-    uint16_t ped;
-    uint16_t code; // code object
-    uint16_t map;  // map object
-    uint16_t user;
-    uint16_t font;
-  } counts;
-
-  counts.car  = r.read<uint16_t>();
-  counts.ped  = r.read<uint16_t>();
-  counts.code = r.read<uint16_t>();
-  counts.map  = r.read<uint16_t>();
-  counts.user = r.read<uint16_t>();
-  counts.font = r.read<uint16_t>();
-
-  uint16_t offset = 0;
-  auto next_base = [&offset](uint16_t count) {
-    SpriteBase base = {.offset = offset, .count = count};
-    offset += count;
-    return base;
-  };
+constexpr size_t kMaxRecyclableCars = 64;
 
-  SpriteBases result = { };
-  result.car  = next_base(counts.car);
-  result.ped  = next_base(counts.ped);
-  result.code = next_base(counts.code);
-  result.map  = next_base(counts.map);
-  result.user = next_base(counts.user);
-  result.font = next_base(counts.font);
-  return result;
-}
+struct RecyChunk {
+  static constexpr schema::FourCC type = "RECY";
+  using Layout = schema::Array<CarModelNumber>;
 
-struct PaletteBase {
-  uint16_t offset;
-  uint16_t count;
-};
+  // The list is terminated by 255.
+  static void decode(StyleSource& s, Layout::Decoded&& values) {
+    s.recyclable_cars.clear();
+    for (size_t i = 0; i < values.size() && i < kMaxRecyclableCars; ++i) {
+      if (values[i] == 255) break;
+      s.recyclable_cars.push_back(values[i]);
+    }
+  }
 
-struct PaletteBases {
-  PaletteBase tile;
-  PaletteBase sprite;
-  PaletteBase car;  // car remap
-  PaletteBase ped;  // ped remap
-  PaletteBase code; // code object remap
-  PaletteBase map;  // map object remap
-  PaletteBase user; // user remap
-  PaletteBase font; // font remap
+  static Layout::Decoded encode(const StyleSource& s) {
+    Layout::Decoded values = s.recyclable_cars;
+    values.resize(kMaxRecyclableCars, 255);
+    return values;
+  }
 };
 
-static PaletteBases read_palette_bases(Reader& r, size_t chunk_size) {
-  assert(chunk_size == 16);
-
-  struct {
-    uint16_t tile;
-    uint16_t sprite;
-    uint16_t car;  // car remap
-    uint16_t ped;  // ped remap
-    uint16_t code; // code object remap
-    uint16_t map;  // map object remap
-    uint16_t user; // user remap
-    uint16_t font; // font remap
-  } counts;
-
-  counts.tile    = r.read<uint16_t>();
-  counts.sprite  = r.read<uint16_t>();
-  counts.car     = r.read<uint16_t>();
-  counts.ped     = r.read<uint16_t>();
-  counts.code    = r.read<uint16_t>();
-  counts.map     = r.read<uint16_t>();
-  counts.user    = r.read<uint16_t>();
-  counts.font    = r.read<uint16_t>();
-
-  uint16_t offset = 0;
-  auto next_base = [&offset](uint16_t count) {
-    PaletteBase base = {.offset = offset, .count = count};
-    offset += count;
-    return base;
-  };
-
-  PaletteBases result = { };
-  result.tile    = next_base(counts.tile);
-  result.sprite  = next_base(counts.sprite);
-  result.car     = next_base(counts.car);
-  result.ped     = next_base(counts.ped);
-  result.code    = next_base(counts.code);
-  result.map     = next_base(counts.map);
-  result.user    = next_base(counts.user);
-  result.font    = next_base(counts.font);
-  return result;
-}
+struct DelsChunk {
+  static constexpr schema::FourCC type = "DELS";
+  using Layout = schema::Array<uint8_t>;
 
-using CarModelNumber = uint8_t;
+  static void decode(StyleSource& s, Layout::Decoded&& store) {
+    s.delta_store = std::move(store);
+  }
 
-std::vector<CarModelNumber> read_recyclable_cars(Reader& r, size_t chunk_size) {
-  assert(chunk_size <= 64);
+  static Layout::Decoded encode(const StyleSource& s) {
+    return s.delta_store;
+  }
+};
 
-  constexpr size_t kMaxCars = 64;
+struct DeltaSetHeader {
+  uint16_t sprite; // sprite number
+  uint8_t count;   // number of deltas in this set
+  uint8_t pad;
+};
+static_assert(sizeof(DeltaSetHeader) == 4);
 
-  std::vector<CarModelNumber> result;
-  for (size_t i = 0; i < kMaxCars; ++i) {
-    auto value = r.read<CarModelNumber>();
-    if (value == 255) break;
+struct DelxChunk {
+  static constexpr schema::FourCC type = "DELX";
+  using Layout = schema::Records<DeltaSetHeader, schema::CountedBy<&DeltaSetHeader::count, uint16_t>>;
 
-    result.push_back(value);
+  static void decode(StyleSource& s, Layout::Decoded&& records) {
+    s.deltas.resize(records.size());
+    for (size_t i = 0; i < records.size(); ++i) {
+      auto& [header, sizes] = records[i];
+      s.deltas[i] = DeltaSet{.sprite = header.sprite, .sizes = std::move(sizes)};
+    }
   }
-  return result;
-}
-
-using DeltaStore = std::vector<uint8_t>;
 
-static DeltaStore read_delta_store(Reader& r, size_t chunk_size) {
-  DeltaStore result(chunk_size);
-  r.read_many<uint8_t>(result.data(), chunk_size);
-  return result;
-}
+  static Layout::Decoded encode(const StyleSource& s) {
+    Layout::Decoded records;
+    for (auto& set : s.deltas) {
+      DeltaSetHeader header = {.sprite = set.sprite, .count = uint8_t(set.sizes.size()), .pad = 0};
+      records.emplace_back(header, set.sizes);
+    }
+    return records;
+  }
+};
 
-// DeltaSet uses the same palette as the sprite.
-struct DeltaSet {
-  uint16_t sprite; // sprite number
-  std::vector<uint16_t> sizes; // size in bytes of each of the deltas in this set
+struct FontBasesHeader {
+  uint16_t count;
 };
 
-using Deltas = std::vector<DeltaSet>;
+struct FonbChunk {
+  static constexpr schema::FourCC type = "FONB";
+  using Layout = schema::Records<FontBasesHeader, schema::CountedBy<&FontBasesHeader::count, uint16_t>>;
 
-static Deltas read_deltas(Reader& r, size_t chunk_size) {
-  Deltas result;
+  static void decode(StyleSource& s, Layout::Decoded&& records) {
+    s.font_bases.clear();
+    if (records.empty()) return;
 
-  size_t bytes = 0;
-  while (bytes < chunk_size) {
-    auto sprite = r.read<uint16_t>();
-    auto count = r.read<uint8_t>();
-    r.skip(sizeof(uint8_t));
+    auto& counts = std::get<1>(records[0]);
 
-    DeltaSet set = {.sprite = sprite};
-    set.sizes.resize(count);
+    uint16_t offset = 0;
+    auto next_base = [&offset](uint16_t count) {
+      FontBase base = {.offset = offset, .count = count};
+      offset += count;
+      return base;
+    };
 
-    for (size_t i = 0; i < count; ++i) {
-      set.sizes[i] = r.read<uint16_t>();
+    s.font_bases.resize(counts.size());
+    for (size_t i = 0; i < counts.size(); ++i) {
+      s.font_bases[i] = next_base(counts[i]);
     }
+  }
 
-    result.push_back(set);
+  static Layout::Decoded encode(const StyleSource& s) {
+    std::vector<uint16_t> counts;
+    for (auto& base : s.font_bases) {
+      counts.push_back(base.count);
+    }
 
-    bytes += 4 + count * sizeof(uint16_t);
+    Layout::Decoded records;
+    records.emplace_back(FontBasesHeader{uint16_t(counts.size())}, std::move(counts));
+    return records;
   }
+};
 
-  return result;
-}
+struct ObjiChunk {
+  static constexpr schema::FourCC type = "OBJI";
+  using Layout = schema::Array<MapObject>;
 
-struct FontBase {
-  uint16_t offset;
-  uint16_t count;
+  static void decode(StyleSource& s, Layout::Decoded&& objects) {
+    s.map_objects = std::move(objects);
+  }
+
+  static Layout::Decoded encode(const StyleSource& s) {
+    return s.map_objects;
+  }
 };
 
-using FontBases = std::vector<FontBase>;
+struct SpecChunk {
+  static constexpr schema::FourCC type = "SPEC";
+  using Layout = schema::Array<uint16_t>;
 
-static FontBases read_font_bases(Reader& r, size_t chunk_size) {
-  uint16_t count = r.read<uint16_t>();
+  // One zero terminated list of tiles per surface type.
+  static void decode(StyleSource& s, Layout::Decoded&& values) {
+    Surfaces result(SurfaceType_Count);
 
-  std::vector<uint16_t> counts(count);
-  r.read_many<uint16_t>(counts.data(), count);
+    size_t type = 0;
+    for (size_t i = 0; i < values.size() && type < SurfaceType_Count; ++i) {
+      if (values[i] == 0) {
+        ++type;
+        continue;
+      }
+      result[type].push_back(values[i]);
+    }
 
-  uint16_t offset = 0;
-  auto next_base = [&offset](uint16_t count) {
-    FontBase base = {.offset = offset, .count = count};
-    offset += count;
-    return base;
-  };
+    s.surfaces = std::move(result);
+  }
 
-  FontBases result(count);
-  for (size_t i = 0; i < count; ++i) {
-    result[i] = next_base(counts[i]);
+  static Layout::Decoded encode(const StyleSource& s) {
+    size_t count = s.surfaces.size();
+    while (count > 0 && s.surfaces[count - 1].empty()) {
+      --count;
+    }
+
+    Layout::Decoded values;
+    for (size_t type = 0; type < count; ++type) {
+      values.insert(values.end(), s.surfaces[type].begin(), s.surfaces[type].end());
+      values.push_back(0);
+    }
+    return values;
   }
-  return result;
-}
+};
 
-struct MapObject {
-  uint8_t model; // object model number
-  uint8_t sprites; // number of sprites stored for this model
+// CarHeader is the fixed part of a CARI record, it is followed by
+// num_remaps remap palettes and a counted list of doors.
+struct CarHeader {
+  uint8_t model;
+  uint8_t sprite;
+  uint8_t width;
+  uint8_t height;
+  uint8_t num_remaps;
+  uint8_t passengers;
+  uint8_t wreck;
+  uint8_t rating;
+  int8_t front_wheel_offset;
+  int8_t rear_wheel_offset;
+  int8_t front_window_offset;
+  int8_t rear_window_offset;
+  uint8_t info_flags;
+  uint8_t info_flags2;
 };
+static_assert(sizeof(CarHeader) == 14);
+
+struct CariChunk {
+  static constexpr schema::FourCC type = "CARI";
+  using Layout = schema::Records<CarHeader, schema::CountedBy<&CarHeader::num_remaps, uint8_t>, schema::Counted<uint8_t, Door>>;
+
+  static void decode(StyleSource& s, Layout::Decoded&& records) {
+    s.cars.resize(records.size());
+    for (size_t i = 0; i < records.size(); ++i) {
+      auto& [h, remap, doors] = records[i];
+      auto& car = s.cars[i];
+      car.model = h.model;
+      car.sprite = h.sprite;
+      car.width = h.width;
+      car.height = h.height;
+      car.num_remaps = h.num_remaps;
+      car.passengers = h.passengers;
+      car.wreck = h.wreck;
+      car.rating = h.rating;
+      car.front_wheel_offset = h.front_wheel_offset;
+      car.rear_wheel_offset = h.rear_wheel_offset;
+      car.front_window_offset = h.front_window_offset;
+      car.rear_window_offset = h.rear_window_offset;
+      car.info_flags = h.info_flags;
+      car.info_flags2 = h.info_flags2;
+      car.remap = std::move(remap);
+      car.num_doors = uint8_t(doors.size());
+      car.doors = std::move(doors);
+    }
+  }
 
-using MapObjects = std::vector<MapObject>;
+  static Layout::Decoded encode(const StyleSource& s) {
+    Layout::Decoded records;
+    for (auto& car : s.cars) {
+      CarHeader h = {
+        .model = car.model,
+        .sprite = car.sprite,
+        .width = car.width,
+        .height = car.height,
+        .num_remaps = uint8_t(car.remap.size()),
+        .passengers = car.passengers,
+        .wreck = car.wreck,
+        .rating = car.rating,
+        .front_wheel_offset = car.front_wheel_offset,
+        .rear_wheel_offset = car.rear_wheel_offset,
+        .front_window_offset = car.front_window_offset,
+        .rear_window_offset = car.rear_window_offset,
+        .info_flags = car.info_flags,
+        .info_flags2 = car.info_flags2,
+      };
+      records.emplace_back(h, car.remap, car.doors);
+    }
+    return records;
+  }
+};
 
-static MapObjects read_map_objects(Reader& r, size_t chunk_size) {
-  assert(chunk_size % sizeof(MapObject) == 0);
-  size_t count = chunk_size / sizeof(MapObject);
+// @TODO: PSXT (PSX tiles) has no descriptor and is skipped.
+using StyleSchemas = schema::Registry<StyleSource,
+  PalxChunk, PpalChunk, PalbChunk, SprbChunk, TileChunk, SprgChunk, SprxChunk,
+  DelsChunk, DelxChunk, FonbChunk, CariChunk, ObjiChunk, RecyChunk, SpecChunk>;
 
-  MapObjects result(count);
-  r.read_many<MapObject>(result.data(), count);
-  return result;
+static schema::FourCC chunk_fourcc(ChunkType type) {
+  return schema::FourCC::from(type.name);
 }
 
-enum SurfaceType : uint8_t {
-  SurfaceType_Grass = 0,
-  SurfaceType_RoadSpecial = 1,
-  SurfaceType_Water = 2,
-  SurfaceType_Electrified = 3,
-  SurfaceType_ElectrifiedPlatform = 4,
-  SurfaceType_WoodFloor = 5,
-  SurfaceType_MetalFloor = 6,
-  SurfaceType_MetalWall = 7,
-  SurfaceType_GrassWall = 8,
-
-  SurfaceType_Count
+struct DeltaStoreEntry {
+  uint16_t offset;
+  uint8_t length;
+  #pragma warning(suppress:4200)
+  uint8_t data[];
 };
 
-using SurfaceTiles = std::vector<uint16_t>;
-using Surfaces = std::vector<SurfaceTiles>;
+constexpr size_t kSpritePageSize = 256;
 
-static Surfaces read_surface_tiles(Reader& r, size_t chunk_size) {
-  uint8_t type = 0;
-  size_t bytes = 0;
+static const PhysicalPalette& sprite_palette(const StyleSource& source, size_t sprite) {
+  size_t virtual_palette_index = source.palette_bases.sprite.offset + sprite;
+  size_t physical_palette_index = source.vtable.map[virtual_palette_index];
+  return source.palettes[physical_palette_index];
+}
 
-  Surfaces result(SurfaceType_Count);
+static const PhysicalPalette& tile_palette(const StyleSource& source, size_t tile) {
+  size_t virtual_palette_index = source.palette_bases.tile.offset + tile;
+  size_t physical_palette_index = source.vtable.map[virtual_palette_index];
+  return source.palettes[physical_palette_index];
+}
 
-  while (type < SurfaceType_Count && bytes < chunk_size) {
-    SurfaceTiles tiles;
+static Color palette_color(const PhysicalPalette& palette, uint8_t index, bool transparent, bool premultiplied) {
+  Color c = palette.colors[index];
+  if (index == 0 && transparent) {
+    c = premultiplied ? Color{0, 0, 0, 0} : Color{c.r, c.g, c.b, 0};
+  }
+  return c;
+}
 
-    while (bytes < chunk_size) {
-      uint16_t value = r.read<uint16_t>();
-      bytes += sizeof(uint16_t);
-      if (value == 0) break;
+// pixel_key hashes everything that goes into converting a width x height
+// block of palette indices into RGBA pixels. It is fast, not collision
+// proof: import_pixels checks what it finds under the key.
+static PixelKey pixel_key(const uint8_t* indices, size_t pitch, uint32_t width, uint32_t height, const PhysicalPalette& palette, bool transparent, bool premultiplied) {
+  const uint32_t header[] = {width, height, uint32_t(transparent) | uint32_t(premultiplied) << 1};
 
-      tiles.push_back(value);
-    }
+  PixelKey key = {
+    .lo = hash64(header, sizeof(header), 0x9e3779b97f4a7c15ull),
+    .hi = hash64(header, sizeof(header), 0xc2b2ae3d27d4eb4full),
+  };
 
-    result[type] = tiles;
-    ++type;
+  for (uint32_t y = 0; y < height; ++y) {
+    key.lo = hash64(indices + y * pitch, width, key.lo);
+    key.hi = hash64(indices + y * pitch, width, key.hi);
   }
 
-  return result;
+  key.lo = hash64(palette.colors, sizeof(palette.colors), key.lo);
+  key.hi = hash64(palette.colors, sizeof(palette.colors), key.hi);
+  return key;
 }
 
-struct Door {
-  int8_t relativeX;           // X position relative to the center of the car.
-  int8_t relativeY;           // Y position relative to the center of the car.
-};
-
-struct Car {
-  uint8_t model;              // Car model number.
-  uint8_t sprite;             // Relative car sprite number.
-  uint8_t width;              // Width of the car in pixels. Might be different than the sprite width (collision detection).
-  uint8_t height;             // Height of the car in pixels. Might be different than the sprite height (collision detection).
-  uint8_t num_remaps;
-  uint8_t passengers;         // Number of passengers the car can carry.
-  uint8_t wreck;              // Wreck graphic number to use when this car is wrecked (0-8, or 99 if can't wreck).
-  uint8_t rating;             // Quality rating for this car used to decide how often it is created in different areas of the city.
-  int8_t front_wheel_offset;    // Distance from the center of the car to the front axle.
-  int8_t rear_wheel_offset;     // Distance from the center of the car to the back axle.
-  int8_t front_window_offset;   // Distance from the center of the car to the front window.
-  int8_t rear_window_offset;    // Distance from the center of the car to the back window.
-  uint8_t info_flags;
-  uint8_t info_flags2;
-  std::vector<uint8_t> remap; // Virtual palette numbers, representing all of the alternative palettes which can sensibly be applied to this car. Note that these palette numbers are relative to the start of the car remap palette area.
-  uint8_t num_doors;
-  std::vector<Door> doors;
-};
+// import_pixels converts a width x height block of palette indices, or
+// looks it up in the pixel store if one is set.
+static Pixels import_pixels(const uint8_t* indices, size_t pitch, uint32_t width, uint32_t height, const PhysicalPalette& palette, bool transparent, const StyleImportOptions& options) {
+  // Comparing an entry with the indices costs less than converting them, and
+  // a colliding key, by chance or crafted by a mod, can't hand this image
+  // the pixels of another one.
+  auto matches = [&](const Pixels& pixels) {
+    if (pixels.size() != size_t(width) * height) {
+      return false;
+    }
+    for (uint32_t y = 0; y < height; ++y) {
+      for (uint32_t x = 0; x < width; ++x) {
+        Color c = palette_color(palette, indices[x + y * pitch], transparent, options.premultiplied_alpha);
+        if (memcmp(&pixels[x + y * width], &c, sizeof(Color)) != 0) return false;
+      }
+    }
+    return true;
+  };
 
-using Cars = std::vector<Car>;
+  auto convert = [&] {
+    std::vector<Color> pixels(size_t(width) * height);
+    for (uint32_t y = 0; y < height; ++y) {
+      for (uint32_t x = 0; x < width; ++x) {
+        pixels[x + y * width] = palette_color(palette, indices[x + y * pitch], transparent, options.premultiplied_alpha);
+      }
+    }
+    return pixels;
+  };
 
-static Cars read_cars(Reader& r, size_t chunk_size) {
-  Cars result;
+  if (!options.pixel_store) {
+    return Pixels(convert());
+  }
 
-  size_t bytes = 0;
-  while (bytes < chunk_size) {
-    Car car = { };
-    car.model = r.read<uint8_t>();
-    car.sprite = r.read<uint8_t>();
-    car.width = r.read<uint8_t>();
-    car.height = r.read<uint8_t>();
-    car.num_remaps = r.read<uint8_t>();
-    car.passengers = r.read<uint8_t>();
-    car.wreck = r.read<uint8_t>();
-    car.rating = r.read<uint8_t>();
-    car.front_wheel_offset = r.read<int8_t>();
-    car.rear_wheel_offset = r.read<int8_t>();
-    car.front_window_offset = r.read<int8_t>();
-    car.rear_window_offset = r.read<int8_t>();
-    car.info_flags = r.read<uint8_t>();
-    car.info_flags2 = r.read<uint8_t>();
+  auto key = pixel_key(indices, pitch, width, height, palette, transparent, options.premultiplied_alpha);
 
-    car.remap.resize(car.num_remaps);
-    r.read_many<uint8_t>(car.remap.data(), car.num_remaps);
+  Pixels result;
+  if (options.pixel_store->find(key, result) && matches(result)) {
+    return result;
+  }
 
-    car.num_doors = r.read<uint8_t>();
+  // A colliding entry keeps the key, this image gets a copy of its own.
+  auto pixels = convert();
+  const Color* converted = pixels.data();
+  result = options.pixel_store->insert(key, std::move(pixels));
+  if (result.data() == converted || matches(result)) {
+    return result;
+  }
+  return Pixels(convert());
+}
 
-    car.doors.resize(car.num_doors);
-    r.read_many<Door>(car.doors.data(), car.num_doors);
+static Rect sprite_bounds(const StyleSource& source, size_t i) {
+  auto& src = source.sprites[i];
+  return opaque_bounds(source.sprite_store.data() + src.offset, kSpritePageSize, src.width, src.height);
+}
 
-    result.push_back(car);
+// import_sprite imports sprite i, cropped to its opaque pixels if trim is set.
+static void import_sprite(const StyleSource& source, size_t i, const StyleImportOptions& options, bool trim, Sprite& dest) {
+  auto& src = source.sprites[i];
+  Rect rect = trim ? sprite_bounds(source, i) : Rect{0, 0, src.width, src.height};
 
-    bytes += 15 + car.num_remaps * sizeof(uint8_t) + car.num_doors * sizeof(Door);
-  }
+  auto indices = source.sprite_store.data() + src.offset + rect.x + rect.y * kSpritePageSize;
 
-  return result;
+  dest.x = rect.x;
+  dest.y = rect.y;
+  dest.width = rect.width;
+  dest.height = rect.height;
+  dest.pixels = import_pixels(indices, kSpritePageSize, rect.width, rect.height, sprite_palette(source, i), true, options);
+  dest.opacity = compute_opacity(dest);
 }
 
-struct DeltaStoreEntry {
-  uint16_t offset;
-  uint8_t length;
-  #pragma warning(suppress:4200)
-  uint8_t data[];
-};
+static void import_tile(const StyleSource& source, size_t i, const StyleImportOptions& options, Sprite& dest) {
+  auto& src = source.tiles[i];
 
-static std::vector<Sprite> import_sprites(
-  const SpriteStore& store,
-  const GTASprites& sprites,
-  const PaletteBases& palette_bases,
-  const VirtualPaletteTable& vtable,
-  const PhysicalPalettes& palettes)
-{
-  constexpr size_t kPageSize = 256;
+  dest.width = kTileDim;
+  dest.height = kTileDim;
+  dest.pixels = import_pixels(src.colors, kTileDim, kTileDim, kTileDim, tile_palette(source, i), options.transparent_tiles, options);
+  dest.opacity = compute_opacity(dest);
+}
 
-  std::vector<Sprite> result(sprites.size());
+static std::vector<Sprite> import_sprites(LoadContext& ctx, const StyleSource& source) {
+  TRACE_SCOPE("import_sprites");
 
-  for (size_t i = 0; i < sprites.size(); ++i) {
-    auto& src = sprites[i];
-    auto& dest = result[i];
+  std::vector<Sprite> result(source.sprites.size());
 
-    dest.width = src.width;
-    dest.height = src.height;
-    dest.pixels.resize(src.width * src.height);
+  for (size_t i = 0; i < result.size(); ++i) {
+    import_sprite(source, i, ctx.options.import, ctx.options.import.trim, result[i]);
+    if (!ctx.item_imported()) break;
+  }
 
-    size_t virtual_palette_index = palette_bases.sprite.offset + i;
-    size_t physical_palette_index = vtable.map[virtual_palette_index];
-    auto& palette = palettes[physical_palette_index];
+  return result;
+}
 
-    size_t xoffset = src.offset % kPageSize;
-    size_t yoffset = src.offset / kPageSize;
+static std::vector<Sprite> import_tiles(LoadContext& ctx, const StyleSource& source) {
+  TRACE_SCOPE("import_tiles");
 
-    for (size_t y = 0; y < src.height; ++y) {
-      for (size_t x = 0; x < src.width; ++x) {
-        auto color_index = store[x + xoffset + (y + yoffset) * kPageSize];
-        dest.pixels[x + y * src.width] = palette.colors[color_index];
-      }
-    }
+  std::vector<Sprite> result(source.tiles.size());
+
+  for (size_t i = 0; i < result.size(); ++i) {
+    import_tile(source, i, ctx.options.import, result[i]);
+    if (!ctx.item_imported()) break;
   }
 
   return result;
 }
 
-static std::vector<Sprite> import_tiles(
-  const Tiles& tiles,
-  const PaletteBases& palette_bases,
-  const VirtualPaletteTable& vtable,
-  const PhysicalPalettes& palettes)
-{
-  std::vector<Sprite> result(tiles.size());
+// walk_delta calls fn(x, y, indices, length) for every run of the delta of
+// size bytes at store_offset and returns the store offset of the next delta.
+template <typename F>
+static size_t walk_delta(const DeltaStore& store, size_t store_offset, size_t size, F&& fn) {
+  size_t bytes = 0;
+  uint32_t position = 0;
 
-  for (size_t i = 0; i < tiles.size(); ++i) {
-    auto& src = tiles[i];
-    auto& dest = result[i];
+  while (bytes < size) {
+    auto entry = reinterpret_cast<const DeltaStoreEntry*>(store.data() + store_offset);
 
-    dest.width = kTileDim;
-    dest.height = kTileDim;
-    dest.pixels.resize(kTileDim * kTileDim);
+    position += entry->offset;
+    size_t x = position % kSpritePageSize;
+    size_t y = position / kSpritePageSize;
+    position += entry->length;
 
-    size_t virtual_palette_index = palette_bases.tile.offset + i;
-    size_t physical_palette_index = vtable.map[virtual_palette_index];
-    auto& palette = palettes[physical_palette_index];
+    fn(x, y, entry->data, entry->length);
 
-    for (size_t px = 0; px < kTileDim * kTileDim; ++px) {
-      auto color_index = src.colors[px];
-      dest.pixels[px] = palette.colors[color_index];
-    }
+    bytes += 3 + entry->length;
+    store_offset += 3 + entry->length;
   }
 
-  return result;
+  return store_offset;
 }
 
-static std::vector<Sprite> import_deltas(
-  const std::vector<Sprite>& sprites,
-  const DeltaStore& store,
-  const Deltas& deltas,
-  const PaletteBases& palette_bases,
-  const VirtualPaletteTable& vtable,
-  const PhysicalPalettes& palettes)
-{
+static std::vector<Sprite> import_deltas(LoadContext& ctx, const StyleSource& source) {
+  TRACE_SCOPE("import_deltas");
+
   std::vector<Sprite> result;
 
   size_t store_offset = 0;
 
-  for (auto& set : deltas) {
-    size_t virtual_palette_index = palette_bases.sprite.offset + set.sprite;
-    size_t physical_palette_index = vtable.map[virtual_palette_index];
-    auto& palette = palettes[physical_palette_index];
+  for (auto& set : source.deltas) {
+    auto& palette = sprite_palette(source, set.sprite);
+
+    // Deltas apply to the untrimmed sprite.
+    Sprite base;
+    import_sprite(source, set.sprite, ctx.options.import, false, base);
 
-    size_t delta_index = 0;
     for (auto size : set.sizes) {
-      auto sprite = sprites[set.sprite];
+      auto sprite = base;
+      Color* pixels = sprite.pixels.mutable_data();
+      uint32_t x0 = sprite.width, y0 = sprite.height, x1 = 0, y1 = 0;
+
+      store_offset = walk_delta(source.delta_store, store_offset, size, [&](size_t x, size_t y, const uint8_t* indices, size_t length) {
+        for (size_t j = 0; j < length; ++j) {
+          size_t p = x + j + y * sprite.width;
+          pixels[p] = palette_color(palette, indices[j], true, ctx.options.import.premultiplied_alpha);
+
+          if (indices[j] != 0) {
+            uint32_t px = uint32_t(p % sprite.width);
+            uint32_t py = uint32_t(p / sprite.width);
+            x0 = std::min(x0, px);
+            y0 = std::min(y0, py);
+            x1 = std::max(x1, px + 1);
+            y1 = std::max(y1, py + 1);
+          }
+        }
+      });
+
+      if (ctx.options.import.trim) {
+        // The sprite's own bounds are kept even where a delta clears
+        // pixels, so this is tight up to what the delta erases.
+        Rect runs = x0 < x1 ? Rect{x0, y0, x1 - x0, y1 - y0} : Rect{0, 0, 0, 0};
+        crop_sprite(sprite, union_rect(sprite_bounds(source, set.sprite), runs));
+      }
+      sprite.opacity = compute_opacity(sprite);
 
-      size_t bytes = 0;
-      uint32_t position = 0;
+      result.push_back(std::move(sprite));
 
-      while (bytes < size) {
-        auto entry = reinterpret_cast<const DeltaStoreEntry*>(store.data() + store_offset);
+      if (!ctx.item_imported()) return result;
+    }
+  }
 
-        position += entry->offset;
-        size_t x = position % 256;
-        size_t y = position / 256;
-        position += entry->length;
+  return result;
+}
 
-        for (size_t j = 0; j < entry->length; ++j) {
-          auto color_index = entry->data[j];
-          sprite.pixels[x + j + y * sprite.width] = palette.colors[color_index];
-        }
+static CollisionMask sprite_collision_mask(const StyleSource& source, size_t i, const Sprite& sprite) {
+  auto& src = source.sprites[i];
+  auto indices = source.sprite_store.data() + src.offset + sprite.x + sprite.y * kSpritePageSize;
+  return build_collision_mask(indices, kSpritePageSize, sprite.width, sprite.height);
+}
 
-        bytes += 3 + entry->length;
-        store_offset += 3 + entry->length;
-      }
+static std::vector<CollisionMask> delta_collision_masks(const StyleSource& source, const std::vector<Sprite>& deltas) {
+  std::vector<CollisionMask> result;
 
-      result.push_back(sprite);
+  size_t store_offset = 0;
+
+  for (auto& set : source.deltas) {
+    auto& src = source.sprites[set.sprite];
+    auto base = build_collision_mask(source.sprite_store.data() + src.offset, kSpritePageSize, src.width, src.height);
+
+    for (auto size : set.sizes) {
+      auto mask = base;
+
+      store_offset = walk_delta(source.delta_store, store_offset, size, [&](size_t x, size_t y, const uint8_t* indices, size_t length) {
+        for (size_t j = 0; j < length; ++j) {
+          // Same addressing as import_deltas, runs may continue on the next row.
+          size_t p = x + j + y * mask.width;
+          size_t px = p % mask.width;
+          size_t py = p / mask.width;
+
+          uint64_t bit = uint64_t(1) << (px % 64);
+          uint64_t& word = mask.bits[py * mask.stride + px / 64];
+          word = indices[j] != 0 ? (word | bit) : (word & ~bit);
+        }
+      });
+
+      auto& delta = deltas[result.size()];
+      result.push_back(crop_collision_mask(mask, delta.x, delta.y, delta.width, delta.height));
     }
   }
 
@@ -592,121 +841,745 @@ static std::vector<uint16_t> import_delta_sprites(const Deltas& deltas) {
   return result;
 }
 
+Opacity compute_opacity(const Sprite& sprite) {
+  bool any_opaque = false;
+  bool any_transparent = false;
+
+  for (auto& c : sprite.pixels) {
+    any_opaque |= c.a != 0;
+    any_transparent |= c.a != 0xff;
+    if (any_opaque && any_transparent) {
+      return Opacity::HasTransparency;
+    }
+  }
+
+  if (!any_opaque) {
+    return Opacity::FullyTransparent;
+  }
+  return Opacity::Opaque;
+}
+
+const char* to_string(StyleLoadStatus status) {
+  switch (status) {
+    case StyleLoadStatus::Ok: return "ok";
+    case StyleLoadStatus::FileNotFound: return "file not found";
+    case StyleLoadStatus::ReadError: return "read error";
+    case StyleLoadStatus::InvalidFormat: return "invalid format";
+    case StyleLoadStatus::Cancelled: return "cancelled";
+  }
+  return "unknown";
+}
+
 bool Styles::load(const char* filename) {
-  File f;
-  if (!f.open("../../../../data/wil.sty")) {
+  return load(filename, StyleLoadOptions{}) == StyleLoadStatus::Ok;
+}
+
+static schema::ChunkStatus decode_chunk(StyleSource& source, const StyleChunk& chunk, const uint8_t* data) {
+  return StyleSchemas::decode(chunk_fourcc(chunk.type), data + chunk.offset, chunk.size, source);
+}
+
+schema::ChunkStatus validate_style_chunk(ChunkType type, const uint8_t* data, size_t size) {
+  return StyleSchemas::validate(chunk_fourcc(type), data, size);
+}
+
+bool read_chunk_directory(const uint8_t* data, size_t size, std::vector<StyleChunk>& chunks) {
+  constexpr size_t kHeaderSize = 6;
+  constexpr size_t kChunkHeaderSize = sizeof(ChunkType) + sizeof(uint32_t);
+
+  if (size < kHeaderSize || memcmp(data, "GBST", 4) != 0) {
     return false;
   }
 
+  Reader r(const_cast<uint8_t*>(data), size);
+  r.skip(4);
+  r.skip(sizeof(uint16_t)); // skip version
+
+  chunks.clear();
+  while (!r.done()) {
+    if (r.size - r.cursor < kChunkHeaderSize) {
+      return false;
+    }
+
+    StyleChunk chunk;
+    chunk.type = r.read<ChunkType>();
+    chunk.size = r.read<uint32_t>();
+    chunk.offset = static_cast<uint32_t>(r.cursor);
+
+    if (chunk.size > r.size - r.cursor) {
+      return false;
+    }
+
+    chunk.hash = hash64(data + chunk.offset, chunk.size);
+    chunks.push_back(chunk);
+    r.skip(chunk.size);
+  }
+
+  return true;
+}
+
+static StyleLoadStatus decode_source(LoadContext& ctx, const uint8_t* data, size_t size, StyleSource& source) {
+  TRACE_SCOPE("decode_source");
+
+  if (!read_chunk_directory(data, size, source.chunks)) {
+    return StyleLoadStatus::InvalidFormat;
+  }
+  memcpy(&source.version, data + 4, sizeof(uint16_t));
+
+  for (auto& chunk : source.chunks) {
+    char type[5] = { };
+    memcpy(type, chunk.type.name, sizeof(chunk.type.name));
+    TRACE_SCOPE("decode_chunk", type);
+
+    if (decode_chunk(source, chunk, data) == schema::ChunkStatus::Invalid) {
+      return StyleLoadStatus::InvalidFormat;
+    }
+
+    if (!ctx.chunk_decoded()) {
+      return StyleLoadStatus::Cancelled;
+    }
+  }
+
+  return StyleLoadStatus::Ok;
+}
+
+StyleLoadStatus decode_style_source(const uint8_t* data, size_t size, StyleSource& source, const StyleLoadOptions& options) {
+  LoadContext ctx = {.options = options};
+  source = { };
+  return decode_source(ctx, data, size, source);
+}
+
+// decode_styles decodes and imports the style file in data. file_buffer is
+// the buffer the load read data into, if it allocated one.
+static StyleLoadStatus decode_styles(Styles& styles, LoadContext& ctx, const uint8_t* data, size_t size, const MemoryUsage& file_buffer) {
+  // The previous contents stay alive until the new ones replace them.
+  ctx.allocated(memory_stats(styles).total.allocated);
+
+  StyleSource source;
+  auto status = decode_source(ctx, data, size, source);
+  if (status != StyleLoadStatus::Ok) {
+    return status;
+  }
+
+  // The importers trust the offsets and indices of the decoded chunks.
+  if (!check_style_source(source)) {
+    return StyleLoadStatus::InvalidFormat;
+  }
+  ctx.allocated(source_memory(source).allocated);
+
+  ctx.progress.items_total = source.sprites.size() + source.tiles.size();
+  for (auto& set : source.deltas) {
+    ctx.progress.items_total += set.sizes.size();
+  }
+
+  auto imported_sprites = import_sprites(ctx, source);
+  if (ctx.cancelled()) return StyleLoadStatus::Cancelled;
+  ctx.allocated(image_memory(imported_sprites).allocated);
+
+  auto imported_tiles = import_tiles(ctx, source);
+  if (ctx.cancelled()) return StyleLoadStatus::Cancelled;
+  ctx.allocated(image_memory(imported_tiles).allocated);
+
+  auto imported_deltas = import_deltas(ctx, source);
+  if (ctx.cancelled()) return StyleLoadStatus::Cancelled;
+  ctx.allocated(image_memory(imported_deltas).allocated);
+
+  styles.sprites = std::move(imported_sprites);
+  styles.tiles = std::move(imported_tiles);
+  styles.deltas = std::move(imported_deltas);
+  styles.delta_sprites = import_delta_sprites(source.deltas);
+  styles.sprite_catalog = build_sprite_catalog(source);
+  styles.map_objects = build_map_object_catalog(source);
+  styles.source = std::move(source);
+  styles.file_buffer = file_buffer;
+
+  styles.import_options = ctx.options.import;
+
+  styles.sprite_masks.clear();
+  styles.delta_masks.clear();
+  if (styles.import_options.collision_masks) {
+    styles.build_collision_masks();
+  }
+
+  styles.sprite_mips.clear();
+  styles.tile_mips.clear();
+  if (styles.import_options.mipmaps) {
+    styles.build_mipmaps(styles.import_options.mip_filter, ctx.options.pool);
+  }
+
+  styles.sprite_hashes.clear();
+  styles.tile_hashes.clear();
+  if (styles.import_options.perceptual_hashes) {
+    styles.build_perceptual_hashes(ctx.options.pool);
+  }
+
+  // The previous contents are released by now, the new ones and the caches
+  // built for them remain.
+  ctx.released(ctx.resident);
+  ctx.allocated(file_buffer.allocated + memory_stats(styles).total.allocated);
+  styles.peak_load_bytes = ctx.peak;
+
+  ctx.report();
+  return StyleLoadStatus::Ok;
+}
+
+static StyleLoadStatus read_style_file(LoadContext& ctx, const char* filename, std::vector<uint8_t>& buf) {
+  TRACE_SCOPE("read_style_file");
+
+  File f;
+  if (!f.open(filename)) {
+    return StyleLoadStatus::FileNotFound;
+  }
+
   auto fsize = f.size();
-  std::vector<uint8_t> buf(fsize);
-  if (!f.read(buf.data(), fsize)) {
-    return false;
+  buf.resize(fsize);
+  ctx.progress.bytes_total = fsize;
+
+  for (size_t offset = 0; offset < fsize; offset += kReadBlockSize) {
+    size_t block = std::min(kReadBlockSize, fsize - offset);
+    if (!f.read(buf.data() + offset, block)) {
+      return StyleLoadStatus::ReadError;
+    }
+    if (!ctx.block_read(block)) {
+      return StyleLoadStatus::Cancelled;
+    }
   }
-  f.close();
 
-  Reader r(buf.data(), buf.size());
+  return StyleLoadStatus::Ok;
+}
+
+StyleLoadStatus read_style_file(const char* filename, std::vector<uint8_t>& buf, const StyleLoadOptions& options) {
+  LoadContext ctx = {.options = options};
+  return read_style_file(ctx, filename, buf);
+}
+
+StyleLoadStatus Styles::load(const char* filename, const StyleLoadOptions& options) {
+  LoadContext ctx = {.options = options};
+
+  std::vector<uint8_t> buf;
+  auto status = read_style_file(ctx, filename, buf);
+  if (status != StyleLoadStatus::Ok) {
+    return status;
+  }
+
+  MemoryUsage file_buffer = {.logical = buf.size(), .allocated = allocated_size(buf.data(), buf.capacity())};
+  ctx.allocated(file_buffer.allocated);
+  return decode_styles(*this, ctx, buf.data(), buf.size(), file_buffer);
+}
+
+StyleLoadStatus Styles::load_from_memory(const uint8_t* data, size_t size, const StyleLoadOptions& options) {
+  LoadContext ctx = {.options = options};
+  ctx.progress.bytes_read = size;
+  ctx.progress.bytes_total = size;
+
+  return decode_styles(*this, ctx, data, size, {.logical = size, .allocated = 0});
+}
+
+static const StyleChunk* find_chunk(const std::vector<StyleChunk>& chunks, ChunkType type) {
+  for (auto& chunk : chunks) {
+    if (chunk.type == type) return &chunk;
+  }
+  return nullptr;
+}
 
-  char magic[4];
-  r.read_many<char>(magic, 4);
-  if (memcmp(magic, "GBST", 4) != 0) {
-    // @TODO: Error not a valid GBH style file.
+static bool contains_chunk(const std::vector<ChunkType>& types, const char* name) {
+  for (auto& type : types) {
+    if (memcmp(type.name, name, 4) == 0) return true;
+  }
+  return false;
+}
+
+static bool same_palette(const PhysicalPalette& a, const PhysicalPalette& b) {
+  return memcmp(a.colors, b.colors, sizeof(a.colors)) == 0;
+}
+
+static bool same_sprite_pixels(const GTASprite& sa, const SpriteStore& a, const GTASprite& sb, const SpriteStore& b) {
+  if (sa.width != sb.width || sa.height != sb.height) {
     return false;
   }
 
-  r.skip(sizeof(uint16_t)); // skip version
+  for (size_t y = 0; y < sa.height; ++y) {
+    size_t ra = sa.offset + y * kSpritePageSize;
+    size_t rb = sb.offset + y * kSpritePageSize;
+    if (memcmp(a.data() + ra, b.data() + rb, sa.width) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
 
-  VirtualPaletteTable vtable;
-  PhysicalPalettes palettes;
-  PaletteBases palette_bases;
-  SpriteBases sprite_bases;
-  SpriteStore sprite_store;
-  GTASprites sprites;
-  DeltaStore delta_store;
-  Deltas deltas;
-  Tiles tiles;
-  FontBases font_bases;
-  MapObjects map_objects;
-  Surfaces surfaces;
-  std::vector<CarModelNumber> recyclable_cars;
-  Cars cars;
+// swap_chunk_members swaps the members of a and b that chunk type decodes
+// into, chunks without a decoder have none.
+static void swap_chunk_members(StyleSource& a, StyleSource& b, ChunkType type) {
+  auto is = [&](const char* name) { return memcmp(type.name, name, 4) == 0; };
+
+  if (is("PALX")) std::swap(a.vtable, b.vtable);
+  else if (is("PPAL")) std::swap(a.palettes, b.palettes);
+  else if (is("PALB")) std::swap(a.palette_bases, b.palette_bases);
+  else if (is("SPRB")) std::swap(a.sprite_bases, b.sprite_bases);
+  else if (is("SPRG")) std::swap(a.sprite_store, b.sprite_store);
+  else if (is("SPRX")) std::swap(a.sprites, b.sprites);
+  else if (is("DELS")) std::swap(a.delta_store, b.delta_store);
+  else if (is("DELX")) std::swap(a.deltas, b.deltas);
+  else if (is("TILE")) std::swap(a.tiles, b.tiles);
+  else if (is("FONB")) std::swap(a.font_bases, b.font_bases);
+  else if (is("OBJI")) std::swap(a.map_objects, b.map_objects);
+  else if (is("SPEC")) std::swap(a.surfaces, b.surfaces);
+  else if (is("RECY")) std::swap(a.recyclable_cars, b.recyclable_cars);
+  else if (is("CARI")) std::swap(a.cars, b.cars);
+}
 
-  while (!r.done()) {
-    auto chunk_type = r.read<ChunkType>();
-    auto chunk_size = r.read<uint32_t>();
+// reimport_items re-imports the flagged sprites and tiles of styles from
+// next, and the deltas when they may be affected, then updates the masks,
+// mip chains and hashes that were built for them.
+static void reimport_items(Styles& styles, const StyleSource& next, const std::vector<bool>& sprite_changed, const std::vector<bool>& tile_changed, bool deltas_changed, StyleChanges& changes) {
+  styles.sprites.resize(next.sprites.size());
+  for (size_t i = 0; i < styles.sprites.size(); ++i) {
+    if (!sprite_changed[i]) continue;
+    import_sprite(next, i, styles.import_options, styles.import_options.trim, styles.sprites[i]);
+    changes.sprites.push_back(static_cast<uint32_t>(i));
+  }
 
-    switch (shash(chunk_type.name, 4).value()) {
-      case shash("PALX").value():
-        vtable = read_virtual_palette_table(r, chunk_size);
-        break;
+  styles.tiles.resize(next.tiles.size());
+  for (size_t i = 0; i < styles.tiles.size(); ++i) {
+    if (!tile_changed[i]) continue;
+    import_tile(next, i, styles.import_options, styles.tiles[i]);
+    changes.tiles.push_back(static_cast<uint32_t>(i));
+  }
 
-      case shash("PPAL").value():
-        palettes = read_physical_palettes(r, chunk_size);
-        break;
+  // Deltas are small, when any of them may be affected they are all
+  // re-imported and compared against the previous ones.
+  bool reimport_deltas = deltas_changed;
+  for (auto& set : next.deltas) {
+    reimport_deltas |= set.sprite < sprite_changed.size() && sprite_changed[set.sprite];
+  }
 
-      case shash("PALB").value():
-        palette_bases = read_palette_bases(r, chunk_size);
-        break;
+  if (reimport_deltas) {
+    StyleLoadOptions options;
+    options.import = styles.import_options;
+    LoadContext ctx = {.options = options};
+    auto reimported = import_deltas(ctx, next);
+
+    for (size_t i = 0; i < reimported.size(); ++i) {
+      bool changed = i >= styles.deltas.size() ||
+        styles.deltas[i].width != reimported[i].width ||
+        styles.deltas[i].height != reimported[i].height ||
+        memcmp(styles.deltas[i].pixels.data(), reimported[i].pixels.data(), reimported[i].pixels.size() * sizeof(Color)) != 0;
+      if (changed) {
+        changes.deltas.push_back(static_cast<uint32_t>(i));
+      }
+    }
 
-      case shash("SPRB").value():
-        sprite_bases = read_sprite_bases(r, chunk_size);
-        break;
+    styles.deltas = std::move(reimported);
+    styles.delta_sprites = import_delta_sprites(next.deltas);
+  }
 
-      case shash("TILE").value():
-        tiles = read_tiles(r, chunk_size);
-        break;
+  if (styles.import_options.collision_masks) {
+    styles.sprite_masks.resize(next.sprites.size());
+    for (auto i : changes.sprites) {
+      styles.sprite_masks[i] = sprite_collision_mask(next, i, styles.sprites[i]);
+    }
+    if (reimport_deltas) {
+      styles.delta_masks = delta_collision_masks(next, styles.deltas);
+    }
+  }
 
-      case shash("SPRG").value():
-        sprite_store = read_sprite_store(r, chunk_size);
-        break;
+  if (styles.import_options.mipmaps) {
+    styles.sprite_mips.resize(styles.sprites.size());
+    for (auto i : changes.sprites) {
+      styles.sprite_mips[i] = build_mip_chain(styles.sprites[i], styles.import_options.mip_filter, styles.import_options.premultiplied_alpha);
+    }
+    styles.tile_mips.resize(styles.tiles.size());
+    for (auto i : changes.tiles) {
+      styles.tile_mips[i] = build_mip_chain(styles.tiles[i], styles.import_options.mip_filter, styles.import_options.premultiplied_alpha);
+    }
+  }
 
-      case shash("SPRX").value():
-        sprites = read_sprites(r, chunk_size);
-        break;
+  if (styles.import_options.perceptual_hashes) {
+    styles.sprite_hashes.resize(styles.sprites.size());
+    for (auto i : changes.sprites) {
+      styles.sprite_hashes[i] = perceptual_hash(styles.sprites[i], styles.import_options.premultiplied_alpha);
+    }
+    styles.tile_hashes.resize(styles.tiles.size());
+    for (auto i : changes.tiles) {
+      styles.tile_hashes[i] = perceptual_hash(styles.tiles[i], styles.import_options.premultiplied_alpha);
+    }
+  }
+}
 
-      case shash("DELS").value():
-        delta_store = read_delta_store(r, chunk_size);
-        break;
+StyleLoadStatus Styles::reload(const char* filename, StyleChanges& changes) {
+  std::vector<uint8_t> buf;
+  auto status = read_style_file(filename, buf);
+  if (status != StyleLoadStatus::Ok) {
+    return status;
+  }
 
-      case shash("DELX").value():
-        deltas = read_deltas(r, chunk_size);
-        break;
+  return reload_from_memory(buf.data(), buf.size(), changes);
+}
 
-      case shash("FONB").value():
-        font_bases = read_font_bases(r, chunk_size);
-        break;
+StyleLoadStatus Styles::reload_from_memory(const uint8_t* data, size_t size, StyleChanges& changes) {
+  TRACE_SCOPE("reload");
 
-      case shash("CARI").value():
-        cars = read_cars(r, chunk_size);
-        break;
+  changes = { };
 
-      case shash("OBJI").value():
-        map_objects = read_map_objects(r, chunk_size);
-        break;
+  std::vector<StyleChunk> chunks;
+  if (!read_chunk_directory(data, size, chunks)) {
+    return StyleLoadStatus::InvalidFormat;
+  }
 
-      case shash("PSXT").value(): // PSX tiles
-        assert(!"TODO");
-        r.skip(chunk_size);
-        break;
+  // A chunk that disappeared has no decoder to reset it, start over.
+  bool layout_changed = false;
+  for (auto& old_chunk : source.chunks) {
+    layout_changed |= find_chunk(chunks, old_chunk.type) == nullptr;
+  }
 
-      case shash("RECY").value():
-        recyclable_cars = read_recyclable_cars(r, chunk_size);
-        break;
+  if (layout_changed) {
+    StyleLoadOptions options;
+    options.import = import_options;
 
-      case shash("SPEC").value():
-        surfaces = read_surface_tiles(r, chunk_size);
-        break;
+    auto status = load_from_memory(data, size, options);
+    if (status != StyleLoadStatus::Ok) {
+      return status;
+    }
 
-      default:
-        // @TODO: Error unknown chunk type...
-        break;
+    changes.full_reload = true;
+    for (auto& chunk : source.chunks) changes.chunks.push_back(chunk.type);
+    for (uint32_t i = 0; i < sprites.size(); ++i) changes.sprites.push_back(i);
+    for (uint32_t i = 0; i < tiles.size(); ++i) changes.tiles.push_back(i);
+    for (uint32_t i = 0; i < deltas.size(); ++i) changes.deltas.push_back(i);
+    return StyleLoadStatus::Ok;
+  }
+
+  for (auto& chunk : chunks) {
+    auto old_chunk = find_chunk(source.chunks, chunk.type);
+    bool same = old_chunk && old_chunk->hash == chunk.hash && old_chunk->size == chunk.size;
+    if (!same && !contains_chunk(changes.chunks, chunk.type.name)) {
+      changes.chunks.push_back(chunk.type);
     }
   }
 
-  this->sprites = import_sprites(sprite_store, sprites, palette_bases, vtable, palettes);
-  this->tiles = import_tiles(tiles, palette_bases, vtable, palettes);
-  this->deltas = import_deltas(this->sprites, delta_store, deltas, palette_bases, vtable, palettes);
-  this->delta_sprites = import_delta_sprites(deltas);
+  if (changes.chunks.empty()) {
+    source.chunks = std::move(chunks);
+    return StyleLoadStatus::Ok;
+  }
 
-  return true;
+  // The members of the changed chunks move to previous and are decoded in
+  // place, the rest of the source isn't copied. On failure they are moved
+  // back.
+  StyleSource previous;
+  auto swap_changed = [&]() {
+    for (auto& type : changes.chunks) swap_chunk_members(source, previous, type);
+  };
+  swap_changed();
+
+  bool ok = true;
+  for (auto& chunk : chunks) {
+    if (ok && contains_chunk(changes.chunks, chunk.type.name)) {
+      ok = decode_chunk(source, chunk, data) != schema::ChunkStatus::Invalid;
+    }
+  }
+  if (!ok || !check_style_source(source)) {
+    swap_changed();
+    return StyleLoadStatus::InvalidFormat;
+  }
+  source.chunks = std::move(chunks);
+
+  // What the source held before: the previous members of changed chunks,
+  // the current ones of the others.
+  auto before = [&](const char* name, auto member) -> decltype(auto) {
+    return contains_chunk(changes.chunks, name) ? previous.*member : source.*member;
+  };
+  const VirtualPaletteTable& old_vtable = before("PALX", &StyleSource::vtable);
+  const PhysicalPalettes& old_palettes = before("PPAL", &StyleSource::palettes);
+  const PaletteBases& old_palette_bases = before("PALB", &StyleSource::palette_bases);
+  const SpriteStore& old_sprite_store = before("SPRG", &StyleSource::sprite_store);
+  const GTASprites& old_sprites = before("SPRX", &StyleSource::sprites);
+  const Tiles& old_tiles = before("TILE", &StyleSource::tiles);
+  auto old_palette = [&](size_t virtual_palette) -> const PhysicalPalette& {
+    return old_palettes[old_vtable.map[virtual_palette]];
+  };
+
+  const bool palettes_changed = contains_chunk(changes.chunks, "PPAL") || contains_chunk(changes.chunks, "PALX") || contains_chunk(changes.chunks, "PALB");
+  const bool sprite_pixels_changed = contains_chunk(changes.chunks, "SPRG") || contains_chunk(changes.chunks, "SPRX");
+  const bool tile_pixels_changed = contains_chunk(changes.chunks, "TILE");
+  const bool deltas_changed = contains_chunk(changes.chunks, "DELS") || contains_chunk(changes.chunks, "DELX");
+
+  // Only the sprites whose source pixels or palette differ are re-imported.
+  std::vector<bool> sprite_changed(source.sprites.size());
+  for (size_t i = 0; i < source.sprites.size(); ++i) {
+    bool changed = i >= old_sprites.size();
+    if (!changed && sprite_pixels_changed) {
+      changed = !same_sprite_pixels(old_sprites[i], old_sprite_store, source.sprites[i], source.sprite_store);
+    }
+    if (!changed && palettes_changed) {
+      changed = !same_palette(old_palette(old_palette_bases.sprite.offset + i), sprite_palette(source, i));
+    }
+    sprite_changed[i] = changed;
+  }
+
+  std::vector<bool> tile_changed(source.tiles.size());
+  for (size_t i = 0; i < source.tiles.size(); ++i) {
+    bool changed = i >= old_tiles.size();
+    if (!changed && tile_pixels_changed) {
+      changed = memcmp(old_tiles[i].colors, source.tiles[i].colors, sizeof(Tile)) != 0;
+    }
+    if (!changed && palettes_changed) {
+      changed = !same_palette(old_palette(old_palette_bases.tile.offset + i), tile_palette(source, i));
+    }
+    tile_changed[i] = changed;
+  }
+
+  reimport_items(*this, source, sprite_changed, tile_changed, deltas_changed, changes);
+
+  sprite_catalog = build_sprite_catalog(source);
+  map_objects = build_map_object_catalog(source);
+  return StyleLoadStatus::Ok;
+}
+
+// invalidate_chunk makes the next reload decode the chunk again and lists
+// it in changes.
+static void invalidate_chunk(StyleSource& source, const char* name, StyleChanges& changes) {
+  for (auto& chunk : source.chunks) {
+    if (memcmp(chunk.type.name, name, 4) == 0) {
+      chunk.hash = 0;
+      changes.chunks.push_back(chunk.type);
+    }
+  }
+}
+
+StyleLoadStatus Styles::apply_snapshot(const StyleSnapshot& snapshot, const SnapshotDiff& diff, StyleChanges& changes) {
+  TRACE_SCOPE("apply_snapshot");
+
+  changes = { };
+
+  bool ok = snapshot.palettes.size() == source.palettes.size() &&
+    snapshot.tiles.size() == source.tiles.size() &&
+    snapshot.sprites.size() == source.sprites.size();
+
+  for (auto i : diff.virtual_palettes) {
+    ok = ok && snapshot.virtual_palettes[i] < source.palettes.size();
+  }
+  for (auto i : diff.sprites) {
+    auto& sprite = snapshot.sprites[i];
+    ok = ok && (sprite.width == 0 || sprite.height == 0 || (
+      sprite.offset % kSpritePageSize + sprite.width <= kSpritePageSize &&
+      sprite.offset + (sprite.height - 1) * kSpritePageSize + sprite.width <= snapshot.sprite_store.size()));
+  }
+  if (!ok) {
+    return StyleLoadStatus::InvalidFormat;
+  }
+
+  for (auto i : diff.palettes) {
+    source.palettes[i] = snapshot.palettes[i];
+  }
+  for (auto i : diff.virtual_palettes) {
+    source.vtable.map[i] = snapshot.virtual_palettes[i];
+  }
+  for (auto i : diff.tiles) {
+    source.tiles[i] = snapshot.tiles[i];
+  }
+  // A repack may have moved every sprite, diff then lists them all.
+  source.sprite_store.resize(snapshot.sprite_store.size());
+  for (auto i : diff.sprites) {
+    auto& sprite = snapshot.sprites[i];
+    source.sprites[i] = sprite;
+    for (uint32_t y = 0; y < sprite.height; ++y) {
+      memcpy(source.sprite_store.data() + sprite.offset + y * kSpritePageSize, snapshot.sprite_row(i, y), sprite.width);
+    }
+  }
+
+  if (!diff.palettes.empty()) invalidate_chunk(source, "PPAL", changes);
+  if (!diff.virtual_palettes.empty()) invalidate_chunk(source, "PALX", changes);
+  if (!diff.tiles.empty()) invalidate_chunk(source, "TILE", changes);
+  if (!diff.sprites.empty()) {
+    invalidate_chunk(source, "SPRG", changes);
+    invalidate_chunk(source, "SPRX", changes);
+  }
+
+  // Palette edits affect every sprite and tile drawn with them.
+  std::vector<bool> palette_changed(source.palettes.size());
+  for (auto i : diff.palettes) palette_changed[i] = true;
+  std::vector<bool> virtual_palette_changed(kVirtualPaletteTableSize);
+  for (auto i : diff.virtual_palettes) virtual_palette_changed[i] = true;
+
+  auto palette_affected = [&](size_t virtual_palette) {
+    return virtual_palette < kVirtualPaletteTableSize &&
+      (virtual_palette_changed[virtual_palette] || palette_changed[source.vtable.map[virtual_palette]]);
+  };
+
+  std::vector<bool> sprite_changed(source.sprites.size());
+  for (auto i : diff.sprites) sprite_changed[i] = true;
+  for (size_t i = 0; i < sprite_changed.size(); ++i) {
+    sprite_changed[i] = sprite_changed[i] || palette_affected(source.palette_bases.sprite.offset + i);
+  }
+
+  std::vector<bool> tile_changed(source.tiles.size());
+  for (auto i : diff.tiles) tile_changed[i] = true;
+  for (size_t i = 0; i < tile_changed.size(); ++i) {
+    tile_changed[i] = tile_changed[i] || palette_affected(source.palette_bases.tile.offset + i);
+  }
+
+  reimport_items(*this, source, sprite_changed, tile_changed, false, changes);
+  return StyleLoadStatus::Ok;
+}
+
+std::vector<uint8_t> encode_styles(const StyleSource& source) {
+  std::vector<uint8_t> out;
+  out.insert(out.end(), {'G', 'B', 'S', 'T'});
+  schema::append(out, &source.version, 1);
+
+  for (auto& chunk : source.chunks) {
+    if (!StyleSchemas::known(chunk_fourcc(chunk.type))) {
+      continue;
+    }
+
+    size_t header = out.size();
+    schema::append(out, &chunk.type, 1);
+    out.resize(out.size() + sizeof(uint32_t));
+
+    StyleSchemas::encode(chunk_fourcc(chunk.type), source, out);
+
+    uint32_t chunk_size = static_cast<uint32_t>(out.size() - header - sizeof(ChunkType) - sizeof(uint32_t));
+    memcpy(out.data() + header + sizeof(ChunkType), &chunk_size, sizeof(uint32_t));
+  }
+
+  return out;
+}
+
+static_assert(sizeof(PalettePage) == kStylePageBytes && kPalettesPerPage == kPalettesPerStylePage);
+static_assert(sizeof(TilePage) == kStylePageBytes && kTilesPerPage == kTilesPerStylePage);
+static_assert(kSpriteStorePageBytes == kStylePageBytes);
+
+bool encode_snapshot_page(const StyleSnapshot& snapshot, ChunkType type, size_t page, std::vector<uint8_t>& out) {
+  out.clear();
+
+  auto is = [&](const char* name) { return memcmp(type.name, name, 4) == 0; };
+
+  if (is("PPAL")) {
+    size_t first = page * kPalettesPerPage;
+    if (first >= snapshot.palettes.size()) return false;
+
+    PalettePage encoded = { };
+    for (size_t idx = first; idx < std::min(first + kPalettesPerPage, snapshot.palettes.size()); ++idx) {
+      PpalChunk::encode_palette(snapshot.palettes[idx], idx, encoded);
+    }
+    schema::append(out, &encoded, 1);
+    return true;
+  }
+
+  if (is("TILE")) {
+    size_t first = page * kTilesPerPage;
+    if (first >= snapshot.tiles.size()) return false;
+
+    TilePage encoded = { };
+    for (size_t idx = first; idx < std::min(first + kTilesPerPage, snapshot.tiles.size()); ++idx) {
+      TileChunk::encode_tile(snapshot.tiles[idx], idx, encoded);
+    }
+    schema::append(out, &encoded, 1);
+    return true;
+  }
+
+  if (is("SPRG")) {
+    if (page >= snapshot.sprite_store.page_count()) return false;
+
+    auto bytes = snapshot.sprite_store.page(page);
+    out.assign(bytes.begin(), bytes.end());
+    return true;
+  }
+
+  if (page != 0) {
+    return false;
+  }
+
+  if (is("PALX")) {
+    VirtualPaletteTable vtable;
+    snapshot.virtual_palettes.copy_to(vtable.map);
+    schema::append(out, &vtable, 1);
+    return true;
+  }
+
+  if (is("SPRX")) {
+    for (size_t i = 0; i < snapshot.sprites.size(); ++i) {
+      auto& sprite = snapshot.sprites[i];
+      GTASpriteTransfer transfer = {
+        .offset = sprite.offset,
+        .width = sprite.width,
+        .height = sprite.height,
+        .pad = 0,
+      };
+      schema::append(out, &transfer, 1);
+    }
+    return true;
+  }
+
+  return false;
+}
+
+void Styles::build_collision_masks() {
+  TRACE_SCOPE("build_collision_masks");
+
+  import_options.collision_masks = true;
+
+  sprite_masks.resize(source.sprites.size());
+  for (size_t i = 0; i < sprite_masks.size(); ++i) {
+    sprite_masks[i] = sprite_collision_mask(source, i, sprites[i]);
+  }
+
+  delta_masks = delta_collision_masks(source, deltas);
+}
+
+void Styles::build_mipmaps(MipFilter filter, ThreadPool* pool) {
+  TRACE_SCOPE("build_mipmaps");
+
+  import_options.mipmaps = true;
+  import_options.mip_filter = filter;
+
+  sprite_mips = build_mip_chains(sprites, filter, import_options.premultiplied_alpha, pool);
+  tile_mips = build_mip_chains(tiles, filter, import_options.premultiplied_alpha, pool);
+}
+
+void Styles::build_perceptual_hashes(ThreadPool* pool) {
+  TRACE_SCOPE("build_perceptual_hashes");
+
+  import_options.perceptual_hashes = true;
+
+  sprite_hashes = perceptual_hashes(sprites, import_options.premultiplied_alpha, pool);
+  tile_hashes = perceptual_hashes(tiles, import_options.premultiplied_alpha, pool);
+}
+
+static const Sprite& mip_level(const std::vector<Sprite>& images, const std::vector<std::vector<Sprite>>& mips, size_t index, uint32_t level) {
+  if (level == 0 || index >= mips.size() || mips[index].empty()) {
+    return images[index];
+  }
+  auto& chain = mips[index];
+  return chain[std::min<size_t>(level, chain.size()) - 1];
+}
+
+const Sprite& Styles::sprite(size_t index, uint32_t level) const {
+  return mip_level(sprites, sprite_mips, index, level);
+}
+
+const Sprite& Styles::sprite(SpriteKind kind, size_t index, uint32_t level) const {
+  auto& range = sprite_catalog[kind];
+  assert(index < range.count);
+  return sprite(range.first + index, level);
+}
+
+const Sprite& Styles::tile(size_t index, uint32_t level) const {
+  return mip_level(tiles, tile_mips, index, level);
+}
+
+size_t Styles::trimmed_bytes() const {
+  size_t result = 0;
+
+  for (size_t i = 0; i < sprites.size(); ++i) {
+    auto& src = source.sprites[i];
+    result += (size_t(src.width) * src.height - size_t(sprites[i].width) * sprites[i].height) * sizeof(Color);
+  }
+
+  for (size_t i = 0; i < deltas.size(); ++i) {
+    auto& src = source.sprites[delta_sprites[i]];
+    result += (size_t(src.width) * src.height - size_t(deltas[i].width) * deltas[i].height) * sizeof(Color);
+  }
+
+  return result;
 }
@@ -1,17 +1,111 @@
 #pragma once
 
+#include "style_format.h"
+#include "collision.h"
+#include "memory_stats.h"
+#include "mipmap.h"
+#include "pixel_store.h"
+#include "schema.h"
+#include "sprite_catalog.h"
 #include <stdint.h>
+#include <atomic>
+#include <functional>
 #include <vector>
 
-struct Color {
-  uint8_t r, g, b, a;
+struct StyleSnapshot;
+struct SnapshotDiff;
+
+enum class Opacity : uint8_t {
+  Opaque,           // every pixel has alpha 255
+  HasTransparency,  // some pixels are (partially) transparent
+  FullyTransparent, // every pixel has alpha 0, or there are no pixels
 };
-static_assert(sizeof(Color) == 4);
 
 struct Sprite {
-  std::vector<Color> pixels;
+  Pixels pixels;
   uint32_t width;
   uint32_t height;
+  uint32_t x = 0; // position of pixels within the untrimmed sprite
+  uint32_t y = 0;
+  Opacity opacity = Opacity::Opaque;
+};
+
+// compute_opacity classifies the alpha of sprite's pixels.
+Opacity compute_opacity(const Sprite& sprite);
+
+enum class StyleLoadStatus {
+  Ok,
+  FileNotFound,
+  ReadError,
+  InvalidFormat,
+  Cancelled,
+};
+
+const char* to_string(StyleLoadStatus status);
+
+// StyleLoadProgress is a snapshot of how far a load has advanced.
+struct StyleLoadProgress {
+  size_t bytes_read;
+  size_t bytes_total;
+  size_t chunks_decoded;
+  size_t items_imported; // sprites, tiles and deltas
+  size_t items_total;
+};
+
+// StyleImportOptions control how sprites and tiles are imported. Reload
+// keeps importing with the options of the load.
+struct StyleImportOptions {
+  // Build Styles::sprite_masks and Styles::delta_masks.
+  bool collision_masks = false;
+
+  // Crop sprites and deltas to the tight bounds of their opaque pixels,
+  // Sprite::x and Sprite::y tell where the crop starts. Fully transparent
+  // sprites become 0x0.
+  bool trim = false;
+
+  // Palette index 0 is transparent in sprites, and in tiles drawn flat on
+  // the lid of a block. Tiles are imported as drawn on the sides of blocks,
+  // with every index opaque, unless transparent_tiles is set.
+  bool transparent_tiles = false;
+
+  // Premultiply colors by alpha, transparent pixels become 0, 0, 0, 0.
+  // Otherwise they keep the palette color of index 0, with alpha 0.
+  bool premultiplied_alpha = false;
+
+  // Share identical sprites and tiles with other styles loaded with the
+  // same store, e.g. &PixelStore::global(), instead of keeping a copy.
+  PixelStore* pixel_store = nullptr;
+
+  // Build Styles::sprite_mips and Styles::tile_mips.
+  bool mipmaps = false;
+  MipFilter mip_filter = MipFilter::Box;
+
+  // Build Styles::sprite_hashes and Styles::tile_hashes.
+  bool perceptual_hashes = false;
+};
+
+struct StyleLoadOptions {
+  // Called on the loading thread after each file block, chunk and import batch.
+  std::function<void(const StyleLoadProgress&)> on_progress;
+
+  // Polled at the same points as on_progress, the load stops with
+  // StyleLoadStatus::Cancelled once this is set.
+  const std::atomic<bool>* cancel = nullptr;
+
+  // Used to build mipmaps and perceptual hashes in parallel when set.
+  ThreadPool* pool = nullptr;
+
+  StyleImportOptions import;
+};
+
+// StyleChanges describes what a reload or an applied snapshot touched. Ids index the reloaded
+// Styles, ids past the end of a shrunk vector are not listed.
+struct StyleChanges {
+  std::vector<ChunkType> chunks; // chunks whose contents changed
+  std::vector<uint32_t> sprites;
+  std::vector<uint32_t> tiles;
+  std::vector<uint32_t> deltas;
+  bool full_reload = false;      // the chunk layout changed, everything was re-imported
 };
 
 struct Styles {
@@ -21,5 +115,107 @@ struct Styles {
   std::vector<Sprite> deltas;
   std::vector<uint16_t> delta_sprites; // @TODO: better name, delta to which sprite the delta applies to
 
+  // One bit per pixel opacity masks of sprites and deltas, only built when
+  // requested, see build_collision_masks.
+  std::vector<CollisionMask> sprite_masks;
+  std::vector<CollisionMask> delta_masks;
+
+  // Mip levels 1..n of every sprite and tile, only built when requested,
+  // see build_mipmaps.
+  std::vector<std::vector<Sprite>> sprite_mips;
+  std::vector<std::vector<Sprite>> tile_mips;
+
+  // Perceptual hashes of every sprite and tile, to find near duplicates,
+  // only built when requested, see build_perceptual_hashes and image_hash.h.
+  std::vector<uint64_t> sprite_hashes;
+  std::vector<uint64_t> tile_hashes;
+
+  // Sprite ranges of each sprite kind and map object model.
+  SpriteCatalog sprite_catalog;
+  MapObjectCatalog map_objects;
+
+  StyleSource source;
+  StyleImportOptions import_options;
+
+  // The style file read into memory by the last load, released once it
+  // finished. Loads from memory didn't allocate it.
+  MemoryUsage file_buffer;
+
+  // Allocated bytes at the peak of the last load, including the file buffer
+  // and the previously loaded styles, see memory_stats.
+  size_t peak_load_bytes = 0;
+
   bool load(const char* filename);
+  StyleLoadStatus load(const char* filename, const StyleLoadOptions& options);
+  StyleLoadStatus load_from_memory(const uint8_t* data, size_t size, const StyleLoadOptions& options = {});
+
+  // reload re-decodes only the chunks whose contents differ from the
+  // currently loaded ones and re-imports only the affected items. The styles
+  // are left untouched if the new file can't be loaded.
+  StyleLoadStatus reload(const char* filename, StyleChanges& changes);
+  StyleLoadStatus reload_from_memory(const uint8_t* data, size_t size, StyleChanges& changes);
+
+  // apply_snapshot brings source up to date with an edited snapshot of it
+  // and re-imports what the edits affect. diff lists how snapshot differs
+  // from source, see diff_snapshots. Edited chunks lose their hash so the
+  // next reload decodes them again. The styles are left untouched if the
+  // snapshot refers to palettes or pixels that don't exist.
+  StyleLoadStatus apply_snapshot(const StyleSnapshot& snapshot, const SnapshotDiff& diff, StyleChanges& changes);
+
+  // build_collision_masks builds the masks of every sprite and delta from
+  // their palette indices, index 0 being transparent. Masks that have been
+  // built are kept up to date by reload.
+  void build_collision_masks();
+
+  // build_mipmaps builds the mip chains of every sprite and tile. Chains
+  // that have been built are kept up to date by reload.
+  void build_mipmaps(MipFilter filter, ThreadPool* pool = nullptr);
+
+  // build_perceptual_hashes hashes every sprite and tile. Hashes that have
+  // been built are kept up to date by reload.
+  void build_perceptual_hashes(ThreadPool* pool = nullptr);
+
+  // sprite and tile return the given mip level, level 0 being the full size
+  // image. Levels past the end of the chain (or any level if mipmaps were
+  // not built) return the smallest level available.
+  const Sprite& sprite(size_t index, uint32_t level = 0) const;
+  const Sprite& tile(size_t index, uint32_t level = 0) const;
+
+  // sprite returns sprite index of the given kind, e.g. the third ped
+  // sprite is sprite(SpriteKind::Ped, 2).
+  const Sprite& sprite(SpriteKind kind, size_t index, uint32_t level = 0) const;
+
+  // trimmed_bytes returns how many RGBA bytes trimming saved.
+  size_t trimmed_bytes() const;
 };
+
+// encode_styles writes source back into the style file format. Chunks
+// are written in the order of source.chunks, chunk types that are not
+// decoded (PSXT) are dropped.
+std::vector<uint8_t> encode_styles(const StyleSource& source);
+
+// kStylePageBytes is the size of the pages PPAL, TILE and SPRG are stored in.
+constexpr size_t kStylePageBytes = 64 * 1024;
+constexpr size_t kPalettesPerStylePage = 64;
+constexpr size_t kTilesPerStylePage = 16;
+
+// encode_snapshot_page encodes page of chunk type from snapshot, as it is
+// stored in a file encoded from it. PPAL, TILE and SPRG are encoded one
+// kStylePageBytes page at a time, PALX and SPRX as a single page. Returns
+// false for other chunk types and for pages past the end.
+bool encode_snapshot_page(const StyleSnapshot& snapshot, ChunkType type, size_t page, std::vector<uint8_t>& out);
+
+// read_chunk_directory lists and hashes the chunks of a style file without
+// decoding them.
+bool read_chunk_directory(const uint8_t* data, size_t size, std::vector<StyleChunk>& chunks);
+
+// decode_style_source decodes the chunks of a style file held in memory
+// without importing any images.
+StyleLoadStatus decode_style_source(const uint8_t* data, size_t size, StyleSource& source, const StyleLoadOptions& options = {});
+
+// validate_style_chunk checks chunk data against the layout of its type
+// without decoding it.
+schema::ChunkStatus validate_style_chunk(ChunkType type, const uint8_t* data, size_t size);
+
+// read_style_file reads a whole style file into buf without decoding it.
+StyleLoadStatus read_style_file(const char* filename, std::vector<uint8_t>& buf, const StyleLoadOptions& options = {});
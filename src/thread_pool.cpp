@@ -0,0 +1,57 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(size_t threads) {
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  m_threads.reserve(threads);
+  for (size_t i = 0; i < threads; ++i) {
+    m_threads.emplace_back([this] { worker(); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard lock(m_mutex);
+    m_stop = true;
+  }
+  m_task_ready.notify_all();
+
+  for (auto& t : m_threads) {
+    t.join();
+  }
+}
+
+size_t ThreadPool::size() const {
+  return m_threads.size();
+}
+
+std::future<void> ThreadPool::submit(std::function<void()> task) {
+  std::packaged_task<void()> packaged(std::move(task));
+  auto result = packaged.get_future();
+  {
+    std::lock_guard lock(m_mutex);
+    m_tasks.push_back(std::move(packaged));
+  }
+  m_task_ready.notify_one();
+  return result;
+}
+
+void ThreadPool::worker() {
+  for (;;) {
+    std::packaged_task<void()> task;
+    {
+      std::unique_lock lock(m_mutex);
+      m_task_ready.wait(lock, [this] { return m_stop || !m_tasks.empty(); });
+      if (m_stop && m_tasks.empty()) {
+        return;
+      }
+
+      task = std::move(m_tasks.front());
+      m_tasks.pop_front();
+    }
+    task();
+  }
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// ThreadPool runs submitted tasks on a fixed number of worker threads.
+class ThreadPool {
+  private:
+    std::vector<std::thread> m_threads;
+    std::deque<std::packaged_task<void()>> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_task_ready;
+    bool m_stop = false;
+
+    void worker();
+
+  public:
+    // threads == 0 uses one thread per hardware thread.
+    explicit ThreadPool(size_t threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const;
+
+    std::future<void> submit(std::function<void()> task);
+};
+
+// parallel_for calls fn(begin, end) for consecutive ranges of at most grain
+// items covering [0, count), on the pool and on the calling thread. It
+// returns once every range is done. The calling thread takes ranges too, so
+// it is safe to call from a task running on the same pool.
+template <typename F>
+void parallel_for(ThreadPool* pool, size_t count, size_t grain, F&& fn) {
+  if (count == 0) {
+    return;
+  }
+
+  grain = grain == 0 ? 1 : grain;
+  size_t ranges = (count + grain - 1) / grain;
+
+  if (!pool || ranges == 1) {
+    for (size_t begin = 0; begin < count; begin += grain) {
+      fn(begin, std::min(count, begin + grain));
+    }
+    return;
+  }
+
+  struct State {
+    std::atomic<size_t> next = 0;
+    std::atomic<size_t> done = 0;
+    std::mutex mutex;
+    std::condition_variable finished;
+  };
+  auto state = std::make_shared<State>();
+
+  // Helpers that only get to run after all ranges were taken return without
+  // touching fn, so fn may go out of scope once every range is done.
+  auto work = [state, count, grain, ranges, &fn] {
+    for (;;) {
+      size_t range = state->next.fetch_add(1);
+      if (range >= ranges) {
+        return;
+      }
+
+      size_t begin = range * grain;
+      fn(begin, std::min(count, begin + grain));
+
+      if (state->done.fetch_add(1) + 1 == ranges) {
+        std::lock_guard lock(state->mutex);
+        state->finished.notify_all();
+      }
+    }
+  };
+
+  size_t helpers = std::min(pool->size(), ranges - 1);
+  for (size_t i = 0; i < helpers; ++i) {
+    pool->submit(work);
+  }
+
+  work();
+
+  std::unique_lock lock(state->mutex);
+  state->finished.wait(lock, [&] { return state->done.load() == ranges; });
+}
@@ -0,0 +1,173 @@
+#include "trace.h"
+#include "json.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Every thread records into its own buffer, the lock is only contended
+// while a trace is being written.
+struct ThreadBuffer {
+  uint32_t tid;
+  std::mutex mutex;
+  std::vector<TraceEvent> events;
+};
+
+struct Registry {
+  std::mutex mutex;
+  std::vector<std::shared_ptr<ThreadBuffer>> threads;
+  uint64_t epoch = 0;
+};
+
+static Registry& registry() {
+  static Registry r;
+  return r;
+}
+
+static ThreadBuffer& thread_buffer() {
+  thread_local std::shared_ptr<ThreadBuffer> buffer = [] {
+    auto& r = registry();
+    std::lock_guard lock(r.mutex);
+    auto b = std::make_shared<ThreadBuffer>();
+    b->tid = uint32_t(r.threads.size() + 1);
+    r.threads.push_back(b);
+    return b;
+  }();
+  return *buffer;
+}
+
+static void record(TraceEvent event) {
+  auto& buffer = thread_buffer();
+  event.tid = buffer.tid;
+  std::lock_guard lock(buffer.mutex);
+  buffer.events.push_back(event);
+}
+
+namespace trace {
+
+  std::atomic<bool> g_enabled = false;
+
+  uint64_t now() {
+    auto t = std::chrono::steady_clock::now().time_since_epoch();
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(t).count());
+  }
+
+  void complete(const char* name, const char* detail, uint64_t begin, uint64_t end) {
+    TraceEvent event = {.name = name, .detail = { }, .counter = false, .tid = 0, .begin = begin, .end = end, .value = 0};
+    if (detail) {
+      strncpy(event.detail, detail, sizeof(event.detail) - 1);
+    }
+    record(event);
+  }
+
+  void counter(const char* name, int64_t value) {
+    uint64_t t = now();
+    record({.name = name, .detail = { }, .counter = true, .tid = 0, .begin = t, .end = t, .value = value});
+  }
+
+} // namespace trace
+
+void trace_start() {
+  auto& r = registry();
+  {
+    std::lock_guard lock(r.mutex);
+    for (auto& thread : r.threads) {
+      std::lock_guard thread_lock(thread->mutex);
+      thread->events.clear();
+    }
+    r.epoch = trace::now();
+  }
+  trace::g_enabled.store(true);
+}
+
+void trace_stop() {
+  trace::g_enabled.store(false);
+}
+
+std::vector<TraceEvent> trace_events() {
+  auto& r = registry();
+  std::vector<TraceEvent> result;
+
+  std::lock_guard lock(r.mutex);
+  for (auto& thread : r.threads) {
+    std::lock_guard thread_lock(thread->mutex);
+    result.insert(result.end(), thread->events.begin(), thread->events.end());
+  }
+
+  return result;
+}
+
+bool write_trace(const char* filename) {
+  auto& r = registry();
+
+  JsonWriter json;
+  json.begin_object();
+  json.key("traceEvents");
+  json.begin_array();
+
+  {
+    std::lock_guard lock(r.mutex);
+
+    for (auto& thread : r.threads) {
+      std::lock_guard thread_lock(thread->mutex);
+      if (thread->events.empty()) continue;
+
+      char thread_name[32];
+      snprintf(thread_name, sizeof(thread_name), "thread %u", thread->tid);
+
+      json.begin_object();
+      json.field("name", "thread_name");
+      json.field("ph", "M");
+      json.field("pid", 1);
+      json.field("tid", thread->tid);
+      json.key("args");
+      json.begin_object();
+      json.field("name", thread_name);
+      json.end_object();
+      json.end_object();
+
+      for (auto& event : thread->events) {
+        double ts = double(event.begin - std::min(event.begin, r.epoch)) / 1000.0;
+
+        json.begin_object();
+        json.field("name", event.name);
+        json.field("pid", 1);
+        json.field("tid", thread->tid);
+        json.field("ts", ts);
+
+        if (!event.counter) {
+          json.field("ph", "X");
+          json.field("dur", double(event.end - event.begin) / 1000.0);
+          if (event.detail[0]) {
+            json.key("args");
+            json.begin_object();
+            json.field("detail", event.detail);
+            json.end_object();
+          }
+        } else {
+          json.field("ph", "C");
+          json.key("args");
+          json.begin_object();
+          json.field("value", event.value);
+          json.end_object();
+        }
+
+        json.end_object();
+      }
+    }
+  }
+
+  json.end_array();
+  json.field("displayTimeUnit", "ms");
+  json.end_object();
+
+  FILE* f = fopen(filename, "wb");
+  if (!f) {
+    return false;
+  }
+  bool ok = fwrite(json.str().data(), json.str().size(), 1, f) == 1;
+  return fclose(f) == 0 && ok;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+// Scoped tracing of the load pipeline, written as Chrome trace event JSON
+// (chrome://tracing, ui.perfetto.dev).
+//
+//   trace_start();
+//   styles.load("wil.sty");
+//   trace_stop();
+//   write_trace("load.json");
+//
+// While tracing is stopped a TRACE_SCOPE costs one relaxed atomic load.
+// Building with FTA2_TRACE=0 removes the instrumentation entirely.
+
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+
+#ifndef FTA2_TRACE
+#define FTA2_TRACE 1
+#endif
+
+namespace trace {
+
+  extern std::atomic<bool> g_enabled;
+
+  inline bool enabled() {
+    return g_enabled.load(std::memory_order_relaxed);
+  }
+
+  uint64_t now();
+
+  // name must be a string literal, detail is copied (up to 7 characters).
+  void complete(const char* name, const char* detail, uint64_t begin, uint64_t end);
+  void counter(const char* name, int64_t value);
+
+  class Scope {
+    private:
+      const char* m_name = nullptr;
+      const char* m_detail = nullptr;
+      uint64_t m_begin = 0;
+
+    public:
+      explicit Scope(const char* name, const char* detail = nullptr) {
+        if (enabled()) {
+          m_name = name;
+          m_detail = detail;
+          m_begin = now();
+        }
+      }
+
+      ~Scope() {
+        if (m_name) {
+          complete(m_name, m_detail, m_begin, now());
+        }
+      }
+
+      Scope(const Scope&) = delete;
+      Scope& operator=(const Scope&) = delete;
+  };
+
+} // namespace trace
+
+struct TraceEvent {
+  const char* name;
+  char detail[8];
+  bool counter;   // a counter sample rather than a complete event
+  uint32_t tid;   // 1-based, in order of the threads' first event
+  uint64_t begin; // ns
+  uint64_t end;
+  int64_t value;  // counter value
+};
+
+// trace_start clears previously recorded events and starts recording.
+void trace_start();
+void trace_stop();
+
+// trace_events returns a copy of the events recorded so far.
+std::vector<TraceEvent> trace_events();
+
+// write_trace writes the recorded events, one track per thread.
+bool write_trace(const char* filename);
+
+#if FTA2_TRACE
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(...) trace::Scope TRACE_CONCAT(trace_scope_, __LINE__)(__VA_ARGS__)
+#define TRACE_COUNTER(name, value) do { if (trace::enabled()) trace::counter(name, int64_t(value)); } while (0)
+#else
+#define TRACE_SCOPE(...) do { } while (0)
+#define TRACE_COUNTER(name, value) do { } while (0)
+#endif
@@ -0,0 +1,114 @@
+#include "trim.h"
+#include "styles.h"
+#include <assert.h>
+#include <algorithm>
+#include <bit>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define FTA2_SSE2 1
+#endif
+
+// accumulate_row ORs row into columns and returns true if any index of row
+// is non-zero.
+static bool accumulate_row(uint8_t* columns, const uint8_t* row, uint32_t width) {
+  uint32_t x = 0;
+  bool any = false;
+
+#if FTA2_SSE2
+  __m128i seen = _mm_setzero_si128();
+  for (; x + 16 <= width; x += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x));
+    __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(columns + x));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(columns + x), _mm_or_si128(c, v));
+    seen = _mm_or_si128(seen, v);
+  }
+  any = _mm_movemask_epi8(_mm_cmpeq_epi8(seen, _mm_setzero_si128())) != 0xffff;
+#endif
+
+  for (; x < width; ++x) {
+    columns[x] |= row[x];
+    any |= row[x] != 0;
+  }
+
+  return any;
+}
+
+// nonzero_mask returns a bit per byte of columns[x..x+16) that is non-zero.
+static uint32_t nonzero_mask(const uint8_t* columns, uint32_t x, uint32_t width) {
+  uint32_t mask = 0;
+  uint32_t count = std::min(16u, width - x);
+
+#if FTA2_SSE2
+  if (count == 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(columns + x));
+    return ~uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128()))) & 0xffff;
+  }
+#endif
+
+  for (uint32_t i = 0; i < count; ++i) {
+    mask |= uint32_t(columns[x + i] != 0) << i;
+  }
+  return mask;
+}
+
+Rect opaque_bounds(const uint8_t* indices, size_t pitch, uint32_t width, uint32_t height) {
+  assert(width <= kMaxTrimWidth);
+
+  uint8_t columns[kMaxTrimWidth] = { };
+  uint32_t top = height;
+  uint32_t bottom = 0;
+
+  for (uint32_t y = 0; y < height; ++y) {
+    if (accumulate_row(columns, indices + y * pitch, width)) {
+      top = std::min(top, y);
+      bottom = y + 1;
+    }
+  }
+
+  if (top == height) {
+    return Rect{0, 0, 0, 0};
+  }
+
+  uint32_t left = width;
+  uint32_t right = 0;
+
+  for (uint32_t x = 0; x < width; x += 16) {
+    uint32_t mask = nonzero_mask(columns, x, width);
+    if (mask == 0) continue;
+
+    left = std::min(left, x + std::countr_zero(mask));
+    right = std::max(right, x + 32 - std::countl_zero(mask));
+  }
+
+  return Rect{left, top, right - left, bottom - top};
+}
+
+Rect union_rect(Rect a, Rect b) {
+  if (a.width == 0 || a.height == 0) return b;
+  if (b.width == 0 || b.height == 0) return a;
+
+  uint32_t x0 = std::min(a.x, b.x);
+  uint32_t y0 = std::min(a.y, b.y);
+  uint32_t x1 = std::max(a.x + a.width, b.x + b.width);
+  uint32_t y1 = std::max(a.y + a.height, b.y + b.height);
+  return Rect{x0, y0, x1 - x0, y1 - y0};
+}
+
+void crop_sprite(Sprite& sprite, Rect rect) {
+  if (rect.x == 0 && rect.y == 0 && rect.width == sprite.width && rect.height == sprite.height) {
+    return;
+  }
+
+  std::vector<Color> pixels(size_t(rect.width) * rect.height);
+  for (uint32_t y = 0; y < rect.height; ++y) {
+    auto row = sprite.pixels.data() + (rect.y + y) * sprite.width + rect.x;
+    std::copy(row, row + rect.width, pixels.data() + y * rect.width);
+  }
+
+  sprite.pixels = std::move(pixels);
+  sprite.width = rect.width;
+  sprite.height = rect.height;
+  sprite.x += rect.x;
+  sprite.y += rect.y;
+}
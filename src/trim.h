@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct Sprite;
+
+struct Rect {
+  uint32_t x;
+  uint32_t y;
+  uint32_t width;
+  uint32_t height;
+};
+
+// opaque_bounds returns the tight bounding box of the non-zero palette
+// indices of a width x height image, or an empty rect if every index is
+// zero. width must not exceed kMaxTrimWidth.
+constexpr uint32_t kMaxTrimWidth = 256;
+Rect opaque_bounds(const uint8_t* indices, size_t pitch, uint32_t width, uint32_t height);
+
+Rect union_rect(Rect a, Rect b);
+
+// crop_sprite keeps the pixels of sprite inside rect and moves the sprite's
+// offset by rect's position.
+void crop_sprite(Sprite& sprite, Rect rect);
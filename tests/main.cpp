@@ -0,0 +1,287 @@
+// tests runs the regression tests and prints the ones that fail.
+//
+//   tests
+//
+// Exits with 1 if any test fails.
+
+#include "synthetic_style.h"
+#include "image_hash.h"
+#include "indexed_import.h"
+#include "sprite_catalog.h"
+#include "style_snapshot.h"
+#include "styles.h"
+#include <stdio.h>
+#include <string.h>
+#include <memory>
+#include <vector>
+
+static int g_failures = 0;
+
+#define CHECK(condition)                                                       \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+      g_failures++;                                                            \
+      return;                                                                  \
+    }                                                                          \
+  } while (0)
+
+static StyleSnapshot synthetic_snapshot() {
+  auto data = generate_style({});
+  auto source = std::make_shared<StyleSource>();
+  if (decode_style_source(data.data(), data.size(), *source) != StyleLoadStatus::Ok) {
+    return {};
+  }
+  return make_snapshot(*source);
+}
+
+static bool has_deltas(const StyleSnapshot& snapshot, size_t sprite) {
+  for (auto& set : snapshot.base->deltas) {
+    if (set.sprite == sprite) return true;
+  }
+  return false;
+}
+
+static std::vector<uint8_t> sprite_pixels(const StyleSnapshot& snapshot, size_t i) {
+  auto& sprite = snapshot.sprites[i];
+  std::vector<uint8_t> pixels(size_t(sprite.width) * sprite.height);
+  for (uint32_t y = 0; y < sprite.height; ++y) {
+    memcpy(pixels.data() + y * sprite.width, snapshot.sprite_row(i, y), sprite.width);
+  }
+  return pixels;
+}
+
+// sprites_in_store checks that every sprite rect lies within one page of the
+// store.
+static bool sprites_in_store(const StyleSnapshot& snapshot) {
+  for (size_t i = 0; i < snapshot.sprites.size(); ++i) {
+    auto& sprite = snapshot.sprites[i];
+    size_t page = sprite.offset / kSpriteStorePageBytes;
+    size_t y = sprite.offset % kSpriteStorePageBytes / kSpriteStorePitch;
+    size_t x = sprite.offset % kSpriteStorePitch;
+    if (page >= snapshot.sprite_store.size() / kSpriteStorePageBytes) return false;
+    if (x + sprite.width > kSpriteStorePitch || y + sprite.height > kSpriteStorePitch) return false;
+  }
+  return true;
+}
+
+// bottom_sprite returns the sprite without deltas that reaches furthest down
+// its page.
+static size_t bottom_sprite(const StyleSnapshot& snapshot) {
+  size_t found = 0, bottom = 0;
+  for (size_t i = 0; i < snapshot.sprites.size(); ++i) {
+    auto& sprite = snapshot.sprites[i];
+    size_t end = sprite.offset % kSpriteStorePageBytes / kSpriteStorePitch + sprite.height;
+    if (end > bottom && sprite.width < 255 && sprite.height < 255 && !has_deltas(snapshot, i)) {
+      found = i;
+      bottom = end;
+    }
+  }
+  return found;
+}
+
+// A sprite on the last rows of a page that grows must not have its old
+// rect read with the new size when the store is repacked.
+static void test_grow_sprite_at_page_end() {
+  auto snapshot = synthetic_snapshot();
+  CHECK(snapshot.base && snapshot.sprites.size() > 0);
+
+  size_t grown = bottom_sprite(snapshot);
+  std::vector<std::vector<uint8_t>> before(snapshot.sprites.size());
+  for (size_t i = 0; i < before.size(); ++i) before[i] = sprite_pixels(snapshot, i);
+
+  std::vector<uint8_t> indices(255 * 255);
+  for (size_t i = 0; i < indices.size(); ++i) indices[i] = uint8_t(i * 7 + 1);
+  CHECK(snapshot.replace_sprite(grown, 255, 255, indices.data()));
+
+  CHECK(snapshot.sprites[grown].width == 255 && snapshot.sprites[grown].height == 255);
+  CHECK(sprites_in_store(snapshot));
+  CHECK(sprite_pixels(snapshot, grown) == indices);
+  for (size_t i = 0; i < before.size(); ++i) {
+    if (i != grown) CHECK(sprite_pixels(snapshot, i) == before[i]);
+  }
+}
+
+// Resizing several sprites repacks once and blanks only those sprites.
+static void test_resize_sprites_batch() {
+  auto snapshot = synthetic_snapshot();
+  CHECK(snapshot.base && snapshot.sprites.size() > 2);
+
+  std::vector<SpriteResize> resizes;
+  for (size_t i = 0; i < snapshot.sprites.size() && resizes.size() < 3; ++i) {
+    if (has_deltas(snapshot, i)) continue;
+    // Two sprites grow, the last one shrinks.
+    uint8_t size = resizes.size() < 2 ? 240 : 1;
+    resizes.push_back({.sprite = i, .width = size, .height = size});
+  }
+  CHECK(resizes.size() == 3);
+
+  std::vector<std::vector<uint8_t>> before(snapshot.sprites.size());
+  for (size_t i = 0; i < before.size(); ++i) before[i] = sprite_pixels(snapshot, i);
+
+  CHECK(snapshot.resize_sprites(resizes));
+  CHECK(sprites_in_store(snapshot));
+  for (auto& resize : resizes) {
+    auto& sprite = snapshot.sprites[resize.sprite];
+    CHECK(sprite.width == resize.width && sprite.height == resize.height);
+    CHECK(sprite_pixels(snapshot, resize.sprite) == std::vector<uint8_t>(size_t(resize.width) * resize.height));
+  }
+  for (size_t i = 0; i < before.size(); ++i) {
+    bool resized = false;
+    for (auto& resize : resizes) resized |= resize.sprite == i;
+    if (!resized) CHECK(sprite_pixels(snapshot, i) == before[i]);
+  }
+}
+
+// Imported sprites that grow are resized together, the last import of a
+// sprite wins.
+static void test_import_sprites_batch() {
+  auto snapshot = synthetic_snapshot();
+  CHECK(snapshot.base && snapshot.sprites.size() > 2);
+
+  std::vector<size_t> items;
+  for (size_t i = 0; i < snapshot.sprites.size() && items.size() < 2; ++i) {
+    if (!has_deltas(snapshot, i)) items.push_back(i);
+  }
+  CHECK(items.size() == 2);
+
+  std::vector<std::vector<uint8_t>> before(snapshot.sprites.size());
+  for (size_t i = 0; i < before.size(); ++i) before[i] = sprite_pixels(snapshot, i);
+
+  std::vector<Color> pixels(255 * 255, Color{255, 255, 255, 255});
+  std::vector<RgbaImport> imports = {
+    {.item = items[0], .image = {pixels.data(), 255, 255}},
+    {.item = items[1], .image = {pixels.data(), 200, 250}},
+    {.item = items[0], .image = {pixels.data(), 100, 120}},
+  };
+  CHECK(import_sprites_rgba(snapshot, imports, {}) == 2);
+
+  CHECK(sprites_in_store(snapshot));
+  CHECK(snapshot.sprites[items[0]].width == 100 && snapshot.sprites[items[0]].height == 120);
+  CHECK(snapshot.sprites[items[1]].width == 200 && snapshot.sprites[items[1]].height == 250);
+  for (auto item : items) {
+    for (auto index : sprite_pixels(snapshot, item)) CHECK(index != 0);
+  }
+  for (size_t i = 0; i < before.size(); ++i) {
+    if (i != items[0] && i != items[1]) CHECK(sprite_pixels(snapshot, i) == before[i]);
+  }
+}
+
+// Near-flat images hash to 0 and stay out of the similarity index, where
+// they would all match each other.
+static void test_low_detail_images_not_indexed() {
+  uint64_t seed = 1;
+  auto noise = [&]() {
+    seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+    return uint8_t(seed >> 61);
+  };
+
+  SimilarityIndex index;
+  for (uint32_t i = 0; i < 1000; ++i) {
+    std::vector<Color> pixels(32 * 32);
+    for (auto& c : pixels) c = Color{uint8_t(100 + noise()), uint8_t(100 + noise()), uint8_t(100 + noise()), 255};
+    Sprite image = {.pixels = Pixels(std::move(pixels)), .width = 32, .height = 32};
+    CHECK(perceptual_hash(image) == 0);
+    index.add(perceptual_hash(image), {.style = 0, .item = i, .kind = ImageKind::Sprite});
+  }
+
+  std::vector<Color> pixels(32 * 32);
+  for (uint32_t y = 0; y < 32; ++y) {
+    for (uint32_t x = 0; x < 32; ++x) {
+      uint8_t l = uint8_t((x * 37 + y * 91) % 256);
+      pixels[y * 32 + x] = Color{l, l, l, 255};
+    }
+  }
+  Sprite image = {.pixels = Pixels(std::move(pixels)), .width = 32, .height = 32};
+  CHECK(perceptual_hash(image) != 0);
+  index.add(perceptual_hash(image), {.style = 0, .item = 1000, .kind = ImageKind::Sprite});
+
+  index.build();
+  CHECK(index.size() == 1);
+  CHECK(index.find_pairs(6).empty());
+}
+
+// Map object ranges stay within the sprites there are when SPRB claims
+// more, and a model listed twice keeps its first range even if it's empty.
+static void test_map_object_ranges_clamped() {
+  StyleSource source;
+  source.sprites.resize(16);
+  source.sprite_bases.map = {.offset = 5, .count = 20};
+  source.map_objects = {{.model = 1, .sprites = 3}, {.model = 2, .sprites = 0}, {.model = 2, .sprites = 4}, {.model = 3, .sprites = 10}, {.model = 4, .sprites = 1}};
+
+  auto catalog = build_map_object_catalog(source);
+  CHECK(catalog[1].first == 5 && catalog[1].count == 3);
+  CHECK(catalog[2].first == 8 && catalog[2].count == 0);
+  CHECK(catalog[3].first == 12 && catalog[3].count == 4);
+  CHECK(catalog[4].first == 16 && catalog[4].count == 0);
+  for (auto& range : catalog.models) {
+    CHECK(size_t(range.first) + range.count <= source.sprites.size());
+  }
+}
+
+static bool same_pixels(const std::vector<Sprite>& a, const std::vector<Sprite>& b) {
+  if (a.size() != b.size()) return false;
+  for (size_t i = 0; i < a.size(); ++i) {
+    if (a[i].width != b[i].width || a[i].height != b[i].height || a[i].pixels.size() != b[i].pixels.size()) return false;
+    if (memcmp(a[i].pixels.data(), b[i].pixels.data(), a[i].pixels.size() * sizeof(Color)) != 0) return false;
+  }
+  return true;
+}
+
+// Reloads decode only the changed chunks, end up as a fresh load would and
+// leave the styles as they were when a chunk is broken.
+static void test_reload_changed_chunks() {
+  auto data = generate_style({});
+  Styles styles;
+  CHECK(styles.load_from_memory(data.data(), data.size()) == StyleLoadStatus::Ok);
+
+  StyleChanges changes;
+  CHECK(styles.reload_from_memory(data.data(), data.size(), changes) == StyleLoadStatus::Ok);
+  CHECK(changes.chunks.empty() && changes.sprites.empty());
+
+  std::vector<StyleChunk> chunks;
+  CHECK(read_chunk_directory(data.data(), data.size(), chunks));
+  const StyleChunk* sprg = nullptr;
+  const StyleChunk* sprx = nullptr;
+  for (auto& chunk : chunks) {
+    if (memcmp(chunk.type.name, "SPRG", 4) == 0) sprg = &chunk;
+    if (memcmp(chunk.type.name, "SPRX", 4) == 0) sprx = &chunk;
+  }
+  CHECK(sprg && sprx);
+
+  auto& sprite = styles.source.sprites[0];
+  CHECK(sprite.width > 0 && sprite.height > 0);
+  data[sprg->offset + sprite.offset] ^= 0x5a;
+  CHECK(styles.reload_from_memory(data.data(), data.size(), changes) == StyleLoadStatus::Ok);
+  CHECK(changes.chunks.size() == 1 && !changes.sprites.empty() && changes.sprites[0] == 0);
+
+  Styles fresh;
+  CHECK(fresh.load_from_memory(data.data(), data.size()) == StyleLoadStatus::Ok);
+  CHECK(same_pixels(styles.sprites, fresh.sprites));
+  CHECK(same_pixels(styles.tiles, fresh.tiles));
+
+  // A sprite far past the end of the store fails the checks.
+  auto offset = styles.source.sprites[0].offset;
+  auto store = styles.source.sprite_store.size();
+  memset(data.data() + sprx->offset, 0xff, 4);
+  data[sprg->offset + sprite.offset] ^= 0x5a;
+  CHECK(styles.reload_from_memory(data.data(), data.size(), changes) == StyleLoadStatus::InvalidFormat);
+  CHECK(styles.source.sprites[0].offset == offset && styles.source.sprite_store.size() == store);
+  CHECK(same_pixels(styles.sprites, fresh.sprites));
+}
+
+int main() {
+  test_grow_sprite_at_page_end();
+  test_resize_sprites_batch();
+  test_import_sprites_batch();
+  test_low_detail_images_not_indexed();
+  test_map_object_ranges_clamped();
+  test_reload_changed_chunks();
+
+  if (g_failures > 0) {
+    fprintf(stderr, "%d test(s) failed\n", g_failures);
+    return 1;
+  }
+  printf("all tests passed\n");
+  return 0;
+}
@@ -0,0 +1,316 @@
+// sty is a command line tool for inspecting style files.
+//
+//   sty diff [--json] [--threads N] a.sty b.sty
+//   sty mem [--json] [--trim] [--mipmaps] [--masks] file.sty
+//   sty similar [--json] [--threads N] [--distance K] file.sty...
+//   sty trace [-o trace.json] [--threads N] [--trim] [--mipmaps] [--masks] file.sty...
+//   sty validate [--json] [--threads N] file.sty...
+
+#include "image_hash.h"
+#include "json.h"
+#include "memory_stats.h"
+#include "style_diff.h"
+#include "style_loader.h"
+#include "style_validate.h"
+#include "thread_pool.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// Exit codes follow diff(1).
+constexpr int kExitSame = 0;
+constexpr int kExitDifferent = 1;
+constexpr int kExitError = 2;
+
+struct Args {
+  bool json = false;
+  size_t threads = 0; // 0 = one per core
+  StyleImportOptions import;
+  const char* output = nullptr;
+  uint32_t distance = 6;
+  std::vector<const char*> files;
+};
+
+static bool parse_args(int argc, char** argv, Args& args) {
+  for (int i = 0; i < argc; ++i) {
+    if (strcmp(argv[i], "--json") == 0) {
+      args.json = true;
+    } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+      args.threads = size_t(strtoul(argv[++i], nullptr, 10));
+    } else if (strcmp(argv[i], "--distance") == 0 && i + 1 < argc) {
+      args.distance = uint32_t(strtoul(argv[++i], nullptr, 10));
+    } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      args.output = argv[++i];
+    } else if (strcmp(argv[i], "--trim") == 0) {
+      args.import.trim = true;
+    } else if (strcmp(argv[i], "--mipmaps") == 0) {
+      args.import.mipmaps = true;
+    } else if (strcmp(argv[i], "--masks") == 0) {
+      args.import.collision_masks = true;
+    } else if (argv[i][0] == '-') {
+      fprintf(stderr, "sty: unknown option %s\n", argv[i]);
+      return false;
+    } else {
+      args.files.push_back(argv[i]);
+    }
+  }
+  return true;
+}
+
+static void print_items(const char* name, const std::vector<ItemDiff>& items) {
+  for (auto& item : items) {
+    printf("%s %u %s\n", name, item.id, to_string(item.kind));
+  }
+}
+
+static int diff_command(const Args& args) {
+  if (args.files.size() != 2) {
+    fprintf(stderr, "usage: sty diff [--json] [--threads N] a.sty b.sty\n");
+    return kExitError;
+  }
+
+  ThreadPool pool(args.threads);
+
+  StyleDiff diff;
+  auto status = diff_style_files(args.files[0], args.files[1], diff, &pool);
+  if (status != StyleLoadStatus::Ok) {
+    fprintf(stderr, "sty: %s\n", to_string(status));
+    return kExitError;
+  }
+
+  if (args.json) {
+    printf("%s\n", to_json(diff).c_str());
+  } else {
+    for (auto& chunk : diff.chunks) {
+      printf("chunk %.4s %s %u -> %u bytes\n", chunk.type.name, to_string(chunk.kind), chunk.old_size, chunk.new_size);
+    }
+    print_items("palette", diff.palettes);
+    print_items("sprite", diff.sprites);
+    print_items("tile", diff.tiles);
+    print_items("delta", diff.deltas);
+    print_items("car", diff.cars);
+  }
+
+  return diff.empty() ? kExitSame : kExitDifferent;
+}
+
+static int mem_command(const Args& args) {
+  if (args.files.size() != 1) {
+    fprintf(stderr, "usage: sty mem [--json] [--trim] [--mipmaps] [--masks] file.sty\n");
+    return kExitError;
+  }
+
+  StyleLoadOptions options;
+  options.import = args.import;
+
+  Styles styles;
+  auto status = styles.load(args.files[0], options);
+  if (status != StyleLoadStatus::Ok) {
+    fprintf(stderr, "sty: %s\n", to_string(status));
+    return kExitError;
+  }
+
+  auto stats = memory_stats(styles);
+  if (args.json) {
+    printf("%s\n", to_json(stats).c_str());
+    return kExitSame;
+  }
+
+  printf("%-18s %12s %12s\n", "category", "logical", "allocated");
+  for (size_t i = 0; i < size_t(MemoryCategory::Count); ++i) {
+    printf("%-18s %12zu %12zu\n", to_string(MemoryCategory(i)), stats.categories[i].logical, stats.categories[i].allocated);
+  }
+  printf("%-18s %12zu %12zu\n", "total", stats.total.logical, stats.total.allocated);
+  printf("%-18s %25zu\n", "peak during load", stats.peak_load_bytes);
+
+  return kExitSame;
+}
+
+// similar_command lists the sprites and tiles whose perceptual hashes are
+// within --distance bits of each other, in the same or in different files.
+// Flat and low-detail images aren't compared, see perceptual_hash.
+// Files are loaded a batch at a time and dropped once hashed. It exits with
+// 1 if any pair is found.
+static int similar_command(const Args& args) {
+  if (args.files.empty()) {
+    fprintf(stderr, "usage: sty similar [--json] [--threads N] [--distance K] file.sty...\n");
+    return kExitError;
+  }
+
+  ThreadPool pool(args.threads);
+  SimilarityIndex index;
+
+  size_t batch = std::max<size_t>(pool.size() * 2, 1);
+  for (size_t first = 0; first < args.files.size(); first += batch) {
+    size_t last = std::min(first + batch, args.files.size());
+    auto results = load_styles(std::vector<std::string>(args.files.begin() + first, args.files.begin() + last), pool);
+
+    for (size_t i = 0; i < results.size(); ++i) {
+      auto& result = results[i];
+      if (result.status != StyleLoadStatus::Ok) {
+        fprintf(stderr, "sty: %s: %s\n", result.path.c_str(), to_string(result.status));
+        return kExitError;
+      }
+      result.styles.build_perceptual_hashes(&pool);
+      index.add(result.styles, uint32_t(first + i));
+    }
+  }
+
+  index.build();
+  auto pairs = index.find_pairs(args.distance, &pool);
+
+  if (args.json) {
+    JsonWriter json;
+    json.begin_array();
+    for (auto& pair : pairs) {
+      json.begin_object();
+      for (auto [name, entry] : {std::pair{"a", pair.a}, std::pair{"b", pair.b}}) {
+        auto& ref = index.ref(entry);
+        json.key(name);
+        json.begin_object();
+        json.field("file", args.files[ref.style]);
+        json.field("kind", to_string(ref.kind));
+        json.field("item", ref.item);
+        json.end_object();
+      }
+      json.field("distance", pair.distance);
+      json.end_object();
+    }
+    json.end_array();
+    printf("%s\n", json.str().c_str());
+  } else {
+    for (auto& pair : pairs) {
+      auto& a = index.ref(pair.a);
+      auto& b = index.ref(pair.b);
+      printf("%s %s %u ~ %s %s %u distance %u\n", args.files[a.style], to_string(a.kind), a.item, args.files[b.style], to_string(b.kind), b.item, pair.distance);
+    }
+  }
+
+  return pairs.empty() ? kExitSame : kExitDifferent;
+}
+
+// trace_command loads the files, concurrently if there are several, and
+// writes a trace of the load.
+static int trace_command(const Args& args) {
+  if (args.files.empty()) {
+    fprintf(stderr, "usage: sty trace [-o trace.json] [--threads N] [--trim] [--mipmaps] [--masks] file.sty...\n");
+    return kExitError;
+  }
+
+  ThreadPool pool(args.threads);
+  StyleLoadOptions options;
+  options.import = args.import;
+  options.pool = &pool;
+
+  bool ok = true;
+  trace_start();
+
+  if (args.files.size() == 1) {
+    Styles styles;
+    auto status = styles.load(args.files[0], options);
+    if (status != StyleLoadStatus::Ok) {
+      fprintf(stderr, "sty: %s: %s\n", args.files[0], to_string(status));
+      ok = false;
+    }
+  } else {
+    auto results = load_styles(std::vector<std::string>(args.files.begin(), args.files.end()), pool);
+    for (auto& result : results) {
+      if (result.status != StyleLoadStatus::Ok) {
+        fprintf(stderr, "sty: %s: %s\n", result.path.c_str(), to_string(result.status));
+        ok = false;
+      }
+    }
+  }
+
+  trace_stop();
+
+  const char* output = args.output ? args.output : "trace.json";
+  if (!write_trace(output)) {
+    fprintf(stderr, "sty: can't write %s\n", output);
+    return kExitError;
+  }
+
+  return ok ? kExitSame : kExitError;
+}
+
+// validate_command checks the files without importing them. It exits with
+// 1 if any file has errors.
+static int validate_command(const Args& args) {
+  if (args.files.empty()) {
+    fprintf(stderr, "usage: sty validate [--json] [--threads N] file.sty...\n");
+    return kExitError;
+  }
+
+  ThreadPool pool(args.threads);
+  bool ok = true;
+
+  for (auto file : args.files) {
+    StyleValidation validation;
+    auto status = validate_style_file(file, validation, &pool);
+    if (status != StyleLoadStatus::Ok) {
+      fprintf(stderr, "sty: %s: %s\n", file, to_string(status));
+      return kExitError;
+    }
+    ok &= validation.ok();
+
+    if (args.json) {
+      printf("%s\n", to_json(validation).c_str());
+      continue;
+    }
+
+    for (auto& issue : validation.issues) {
+      if (issue.chunk == ChunkType{ }) {
+        printf("%s: %s: %s\n", file, to_string(issue.severity), issue.message.c_str());
+      } else if (issue.item < 0) {
+        printf("%s: %s: %.4s: %s\n", file, to_string(issue.severity), issue.chunk.name, issue.message.c_str());
+      } else {
+        printf("%s: %s: %.4s[%lld]: %s\n", file, to_string(issue.severity), issue.chunk.name, (long long)issue.item, issue.message.c_str());
+      }
+    }
+    for (auto& chunk : validation.checksums) {
+      printf("%s: chunk %.4s offset %u size %u crc32c %08x\n", file, chunk.type.name, chunk.offset, chunk.size, chunk.crc32c);
+    }
+    printf("%s: %s, %zu errors\n", file, validation.ok() ? "ok" : "invalid", validation.errors());
+  }
+
+  return ok ? kExitSame : kExitDifferent;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: sty <command> [options]\n\ncommands:\n  diff      compare two style files\n  mem       report the memory a loaded style file takes\n  similar   find near duplicate sprites and tiles across style files\n  trace     write a Chrome trace of loading style files\n  validate  check style files for broken chunks and references\n");
+    return kExitError;
+  }
+
+  Args args;
+  if (!parse_args(argc - 2, argv + 2, args)) {
+    return kExitError;
+  }
+
+  if (strcmp(argv[1], "diff") == 0) {
+    return diff_command(args);
+  }
+
+  if (strcmp(argv[1], "mem") == 0) {
+    return mem_command(args);
+  }
+
+  if (strcmp(argv[1], "similar") == 0) {
+    return similar_command(args);
+  }
+
+  if (strcmp(argv[1], "trace") == 0) {
+    return trace_command(args);
+  }
+
+  if (strcmp(argv[1], "validate") == 0) {
+    return validate_command(args);
+  }
+
+  fprintf(stderr, "sty: unknown command %s\n", argv[1]);
+  return kExitError;
+}
@@ -0,0 +1,99 @@
+#include "client.h"
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static bool send_all(int fd, const void* data, size_t size) {
+  auto p = static_cast<const uint8_t*>(data);
+  while (size > 0) {
+    ssize_t n = send(fd, p, size, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    p += n;
+    size -= size_t(n);
+  }
+  return true;
+}
+
+static bool receive_all(int fd, void* data, size_t size) {
+  auto p = static_cast<uint8_t*>(data);
+  while (size > 0) {
+    ssize_t n = recv(fd, p, size, MSG_WAITALL);
+    if (n <= 0) {
+      if (n < 0 && errno == EINTR) continue;
+      return false;
+    }
+    p += n;
+    size -= size_t(n);
+  }
+  return true;
+}
+
+AssetClient::~AssetClient() {
+  close();
+}
+
+bool AssetClient::connect(const char* path) {
+  close();
+
+  sockaddr_un address = { };
+  address.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(address.sun_path)) {
+    return false;
+  }
+  strcpy(address.sun_path, path);
+
+  m_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (m_fd < 0) {
+    return false;
+  }
+  if (::connect(m_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+    close();
+    return false;
+  }
+  return true;
+}
+
+void AssetClient::close() {
+  if (m_fd >= 0) {
+    ::close(m_fd);
+    m_fd = -1;
+  }
+}
+
+bool AssetClient::fetch(const std::vector<AssetRequest>& requests, std::vector<AssetResponse>& responses, std::vector<uint8_t>& payload) {
+  if (m_fd < 0 || requests.size() > kMaxAssetBatch) {
+    return false;
+  }
+
+  AssetRequestHeader header = {
+    .magic = kAssetRequestMagic,
+    .version = kAssetProtocolVersion,
+    .count = uint16_t(requests.size()),
+    .id = m_next_id++,
+  };
+
+  std::vector<uint8_t> message(sizeof(header) + requests.size() * sizeof(AssetRequest));
+  memcpy(message.data(), &header, sizeof(header));
+  memcpy(message.data() + sizeof(header), requests.data(), requests.size() * sizeof(AssetRequest));
+  if (!send_all(m_fd, message.data(), message.size())) {
+    return false;
+  }
+
+  AssetResponseHeader response_header;
+  if (!receive_all(m_fd, &response_header, sizeof(response_header))) {
+    return false;
+  }
+  if (response_header.magic != kAssetResponseMagic || response_header.id != header.id || response_header.count != header.count) {
+    return false;
+  }
+
+  responses.resize(response_header.count);
+  payload.resize(response_header.payload_size);
+  return receive_all(m_fd, responses.data(), responses.size() * sizeof(AssetResponse)) &&
+    receive_all(m_fd, payload.data(), payload.size());
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "protocol.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// AssetClient is a blocking client of AssetServer.
+class AssetClient {
+  private:
+    int m_fd = -1;
+    uint32_t m_next_id = 1;
+
+  public:
+    AssetClient() = default;
+    AssetClient(const AssetClient&) = delete;
+    AssetClient& operator=(const AssetClient&) = delete;
+    ~AssetClient();
+
+    bool connect(const char* path);
+    void close();
+
+    // fetch sends a batch of at most kMaxAssetBatch requests and waits for
+    // the answer. payload receives the payloads back to back, responses[i].size
+    // bytes each.
+    bool fetch(const std::vector<AssetRequest>& requests, std::vector<AssetResponse>& responses, std::vector<uint8_t>& payload);
+};
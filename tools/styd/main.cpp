@@ -0,0 +1,187 @@
+// styd serves the sprites, tiles and palettes of style files to local
+// processes over a Unix domain socket, so the styles are loaded once per
+// machine instead of once per process.
+//
+//   styd serve [--socket path] [--cache-dir dir] [--trim] [--transparent-tiles] [--premultiplied] file.sty...
+//   styd fetch [--socket path] [--style n] <info|sprite|tile|delta|palette|vpalettes> [index...]
+
+#include "client.h"
+#include "server.h"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+constexpr const char* kDefaultSocket = "/tmp/styd.sock";
+
+struct Args {
+  const char* socket = kDefaultSocket;
+  const char* cache_dir = nullptr;
+  uint8_t style = 0;
+  StyleImportOptions import;
+  std::vector<const char*> positional;
+};
+
+static bool parse_args(int argc, char** argv, Args& args) {
+  for (int i = 0; i < argc; ++i) {
+    if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc) {
+      args.socket = argv[++i];
+    } else if (strcmp(argv[i], "--cache-dir") == 0 && i + 1 < argc) {
+      args.cache_dir = argv[++i];
+    } else if (strcmp(argv[i], "--style") == 0 && i + 1 < argc) {
+      args.style = uint8_t(strtoul(argv[++i], nullptr, 10));
+    } else if (strcmp(argv[i], "--trim") == 0) {
+      args.import.trim = true;
+    } else if (strcmp(argv[i], "--transparent-tiles") == 0) {
+      args.import.transparent_tiles = true;
+    } else if (strcmp(argv[i], "--premultiplied") == 0) {
+      args.import.premultiplied_alpha = true;
+    } else if (argv[i][0] == '-') {
+      fprintf(stderr, "styd: unknown option %s\n", argv[i]);
+      return false;
+    } else {
+      args.positional.push_back(argv[i]);
+    }
+  }
+  return true;
+}
+
+// cache_filename puts the cooked cache next to the style file, or into
+// cache_dir when set.
+static std::string cache_filename(const char* filename, const char* cache_dir) {
+  std::filesystem::path path(filename);
+  if (cache_dir) {
+    path = std::filesystem::path(cache_dir) / path.filename();
+  }
+  path += ".cooked";
+  return path.string();
+}
+
+static AssetServer* g_server;
+
+static void handle_signal(int) {
+  if (g_server) {
+    g_server->stop();
+  }
+}
+
+static int serve_command(const Args& args) {
+  if (args.positional.empty()) {
+    fprintf(stderr, "usage: styd serve [--socket path] [--cache-dir dir] [--trim] [--transparent-tiles] [--premultiplied] file.sty...\n");
+    return 1;
+  }
+
+  AssetServer server;
+  for (auto file : args.positional) {
+    auto status = server.add_style(file, cache_filename(file, args.cache_dir).c_str(), args.import);
+    if (status != StyleLoadStatus::Ok) {
+      fprintf(stderr, "styd: %s: %s\n", file, to_string(status));
+      return 1;
+    }
+    fprintf(stderr, "styd: style %zu is %s\n", server.style_count() - 1, file);
+  }
+
+  if (!server.listen(args.socket)) {
+    fprintf(stderr, "styd: can't listen on %s\n", args.socket);
+    return 1;
+  }
+
+  g_server = &server;
+  signal(SIGINT, handle_signal);
+  signal(SIGTERM, handle_signal);
+
+  fprintf(stderr, "styd: listening on %s\n", args.socket);
+  bool ok = server.run();
+  g_server = nullptr;
+  return ok ? 0 : 1;
+}
+
+static bool parse_type(const char* name, AssetType& type) {
+  static const struct { const char* name; AssetType type; } kTypes[] = {
+    {"info", AssetType::Info},
+    {"sprite", AssetType::Sprite},
+    {"tile", AssetType::Tile},
+    {"delta", AssetType::Delta},
+    {"palette", AssetType::Palette},
+    {"vpalettes", AssetType::VirtualPalettes},
+  };
+
+  for (auto& t : kTypes) {
+    if (strcmp(name, t.name) == 0) {
+      type = t.type;
+      return true;
+    }
+  }
+  return false;
+}
+
+// fetch_command requests a batch and prints what came back, one line per
+// asset.
+static int fetch_command(const Args& args) {
+  AssetType type;
+  if (args.positional.empty() || !parse_type(args.positional[0], type)) {
+    fprintf(stderr, "usage: styd fetch [--socket path] [--style n] <info|sprite|tile|delta|palette|vpalettes> [index...]\n");
+    return 1;
+  }
+
+  std::vector<AssetRequest> requests;
+  for (size_t i = 1; i < args.positional.size(); ++i) {
+    requests.push_back({.type = type, .style = args.style, .index = uint32_t(strtoul(args.positional[i], nullptr, 10))});
+  }
+  if (requests.empty()) {
+    requests.push_back({.type = type, .style = args.style});
+  }
+
+  AssetClient client;
+  if (!client.connect(args.socket)) {
+    fprintf(stderr, "styd: can't connect to %s\n", args.socket);
+    return 1;
+  }
+
+  std::vector<AssetResponse> responses;
+  std::vector<uint8_t> payload;
+  if (!client.fetch(requests, responses, payload)) {
+    fprintf(stderr, "styd: request failed\n");
+    return 1;
+  }
+
+  size_t offset = 0;
+  for (auto& response : responses) {
+    if (response.type == AssetType::Info && response.status == AssetStatus::Ok) {
+      AssetInfo info;
+      memcpy(&info, payload.data() + offset, sizeof(info));
+      printf("sprites %u tiles %u deltas %u palettes %u\n", info.sprites, info.tiles, info.deltas, info.palettes);
+    } else {
+      printf("%u status %u %ux%u at %u,%u %u bytes\n", response.index, unsigned(response.status), response.width, response.height, response.x, response.y, response.size);
+    }
+    offset += response.size;
+  }
+
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: styd <command> [options]\n\ncommands:\n  serve  serve style files over a Unix domain socket\n  fetch  request assets from a running server\n");
+    return 1;
+  }
+
+  Args args;
+  if (!parse_args(argc - 2, argv + 2, args)) {
+    return 1;
+  }
+
+  if (strcmp(argv[1], "serve") == 0) {
+    return serve_command(args);
+  }
+
+  if (strcmp(argv[1], "fetch") == 0) {
+    return fetch_command(args);
+  }
+
+  fprintf(stderr, "styd: unknown command %s\n", argv[1]);
+  return 1;
+}
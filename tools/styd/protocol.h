@@ -0,0 +1,81 @@
+#pragma once
+
+// Wire format of the style asset server. Every integer is little-endian,
+// every struct is sent as is.
+//
+// A client sends requests, each an AssetRequestHeader followed by count
+// AssetRequests. The server answers each request in order with an
+// AssetResponseHeader, count AssetResponses, then the payload of every
+// response back to back in the same order. A client may send further
+// requests before the previous answers arrive.
+
+#include <stdint.h>
+
+constexpr uint32_t kAssetRequestMagic = 0x51595453;  // "STYQ"
+constexpr uint32_t kAssetResponseMagic = 0x52595453; // "STYR"
+constexpr uint16_t kAssetProtocolVersion = 1;
+
+// kMaxAssetBatch is the most assets a single request may ask for.
+constexpr uint16_t kMaxAssetBatch = 4096;
+
+enum class AssetType : uint8_t {
+  Info = 0,            // AssetInfo of a style, index is ignored
+  Sprite = 1,          // RGBA pixels
+  Tile = 2,            // RGBA pixels
+  Delta = 3,           // RGBA pixels
+  Palette = 4,         // 256 RGBA colors
+  VirtualPalettes = 5, // 16384 uint16_t physical palette numbers, index is ignored
+};
+
+enum class AssetStatus : uint8_t {
+  Ok = 0,
+  NoSuchStyle = 1,
+  NoSuchAsset = 2,  // index out of range
+  BadType = 3,
+};
+
+struct AssetRequestHeader {
+  uint32_t magic;   // kAssetRequestMagic
+  uint16_t version; // kAssetProtocolVersion
+  uint16_t count;   // number of AssetRequests that follow
+  uint32_t id;      // echoed in the response
+};
+static_assert(sizeof(AssetRequestHeader) == 12);
+
+struct AssetRequest {
+  AssetType type;
+  uint8_t style;    // index of the style in the order the server loaded them
+  uint16_t pad;
+  uint32_t index;
+};
+static_assert(sizeof(AssetRequest) == 8);
+
+struct AssetResponseHeader {
+  uint32_t magic;   // kAssetResponseMagic
+  uint16_t version;
+  uint16_t count;
+  uint32_t id;
+  uint32_t payload_size; // bytes of payload after the AssetResponses
+};
+static_assert(sizeof(AssetResponseHeader) == 16);
+
+struct AssetResponse {
+  AssetType type;
+  AssetStatus status;
+  uint16_t pad;
+  uint32_t index;
+  uint16_t width;   // images only
+  uint16_t height;
+  uint16_t x;       // images only, see Sprite::x
+  uint16_t y;
+  uint32_t size;    // payload bytes, 0 unless status is Ok
+};
+static_assert(sizeof(AssetResponse) == 20);
+
+struct AssetInfo {
+  uint32_t sprites;
+  uint32_t tiles;
+  uint32_t deltas;
+  uint32_t palettes;
+};
+static_assert(sizeof(AssetInfo) == 16);
@@ -0,0 +1,411 @@
+#include "server.h"
+#include "trace.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+
+constexpr int kMaxEvents = 64;
+constexpr size_t kReceiveSize = 64 * 1024;
+
+// A connection that has queued this much output isn't read from until the
+// client has taken all of it, so a client that doesn't read its responses
+// can't make the server queue without bound.
+constexpr size_t kMaxQueuedBytes = 32 * 1024 * 1024;
+constexpr size_t kMaxQueuedIovecs = 4 * kMaxAssetBatch;
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+AssetServer::~AssetServer() {
+  for (auto& [fd, connection] : m_connections) {
+    ::close(fd);
+  }
+  if (m_listen >= 0) {
+    ::close(m_listen);
+    unlink(m_socket_path.c_str());
+  }
+  if (m_epoll >= 0) ::close(m_epoll);
+  if (m_wake >= 0) ::close(m_wake);
+}
+
+StyleLoadStatus AssetServer::add_style(const char* filename, const char* cache_filename, const StyleImportOptions& import) {
+  if (m_styles.size() > UINT8_MAX) {
+    return StyleLoadStatus::InvalidFormat;
+  }
+
+  auto style = std::make_unique<Style>();
+  auto status = load_cooked_styles(filename, cache_filename, style->cooked, import);
+  if (status != StyleLoadStatus::Ok) {
+    return status;
+  }
+
+  auto& cooked = style->cooked;
+  style->info = {
+    .sprites = uint32_t(cooked.sprites().size()),
+    .tiles = uint32_t(cooked.tiles().size()),
+    .deltas = uint32_t(cooked.deltas().size()),
+    .palettes = uint32_t(cooked.palettes().size()),
+  };
+
+  m_styles.push_back(std::move(style));
+  return StyleLoadStatus::Ok;
+}
+
+bool AssetServer::listen(const char* path) {
+  sockaddr_un address = { };
+  address.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(address.sun_path)) {
+    return false;
+  }
+  strcpy(address.sun_path, path);
+
+  m_listen = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (m_listen < 0) {
+    return false;
+  }
+
+  unlink(path);
+  if (bind(m_listen, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || ::listen(m_listen, SOMAXCONN) < 0) {
+    ::close(m_listen);
+    m_listen = -1;
+    return false;
+  }
+  m_socket_path = path;
+
+  m_epoll = epoll_create1(EPOLL_CLOEXEC);
+  m_wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (m_epoll < 0 || m_wake < 0) {
+    return false;
+  }
+
+  epoll_event event = {.events = EPOLLIN, .data = {.fd = m_listen}};
+  epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_listen, &event);
+  event.data.fd = m_wake;
+  epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wake, &event);
+  return true;
+}
+
+void AssetServer::stop() {
+  uint64_t one = 1;
+  if (m_wake >= 0) {
+    (void)!write(m_wake, &one, sizeof(one));
+  }
+}
+
+bool AssetServer::run() {
+  if (m_epoll < 0) {
+    return false;
+  }
+
+  epoll_event events[kMaxEvents];
+
+  for (;;) {
+    int n = epoll_wait(m_epoll, events, kMaxEvents, -1);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+
+    for (int i = 0; i < n; ++i) {
+      int fd = events[i].data.fd;
+
+      if (fd == m_wake) {
+        return true;
+      }
+      if (fd == m_listen) {
+        accept_connections();
+        continue;
+      }
+
+      auto it = m_connections.find(fd);
+      if (it == m_connections.end()) continue;
+      auto& connection = *it->second;
+
+      bool ok = !(events[i].events & EPOLLERR);
+      if (ok && connection.reading && (events[i].events & (EPOLLIN | EPOLLHUP))) {
+        ok = receive(connection);
+      } else if (ok && (events[i].events & (EPOLLOUT | EPOLLHUP))) {
+        ok = serve(connection);
+      }
+      if (!ok) {
+        close_connection(connection);
+      }
+    }
+  }
+}
+
+void AssetServer::accept_connections() {
+  for (;;) {
+    int fd = accept4(m_listen, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+      return;
+    }
+
+    auto connection = std::make_unique<Connection>();
+    connection->fd = fd;
+
+    epoll_event event = {.events = EPOLLIN, .data = {.fd = fd}};
+    if (epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &event) < 0) {
+      ::close(fd);
+      continue;
+    }
+    m_connections[fd] = std::move(connection);
+  }
+}
+
+void AssetServer::close_connection(Connection& connection) {
+  int fd = connection.fd;
+  epoll_ctl(m_epoll, EPOLL_CTL_DEL, fd, nullptr);
+  ::close(fd);
+  m_connections.erase(fd);
+}
+
+// receive reads what is available and answers the complete requests.
+// Returns false if the connection should be closed.
+bool AssetServer::receive(Connection& connection) {
+  auto& in = connection.in;
+
+  size_t old_size = in.size();
+  in.resize(old_size + kReceiveSize);
+  ssize_t n = recv(connection.fd, in.data() + old_size, kReceiveSize, 0);
+  in.resize(old_size + size_t(std::max<ssize_t>(n, 0)));
+  if (n < 0) {
+    return errno == EAGAIN || errno == EINTR;
+  }
+
+  // The client may have shut down its side after its last request, it still
+  // gets the responses.
+  connection.eof = n == 0;
+  return serve(connection);
+}
+
+static bool output_full(const std::vector<iovec>& out, size_t bytes) {
+  return bytes >= kMaxQueuedBytes || out.size() >= kMaxQueuedIovecs;
+}
+
+// request_size returns the size of the request at offset of in, 0 if it
+// hasn't been received completely.
+static size_t request_size(const std::vector<uint8_t>& in, size_t offset) {
+  size_t available = in.size() - offset;
+  if (available < sizeof(AssetRequestHeader)) {
+    return 0;
+  }
+
+  AssetRequestHeader header;
+  memcpy(&header, in.data() + offset, sizeof(header));
+  size_t size = sizeof(header) + size_t(header.count) * sizeof(AssetRequest);
+  return available < size ? 0 : size;
+}
+
+// parse answers the complete requests received, until the output queue is
+// full. Returns false if the connection sent garbage.
+bool AssetServer::parse(Connection& connection) {
+  auto& in = connection.in;
+
+  while (!output_full(connection.out, connection.out_bytes)) {
+    if (in.size() - connection.in_offset < sizeof(AssetRequestHeader)) break;
+
+    AssetRequestHeader header;
+    memcpy(&header, in.data() + connection.in_offset, sizeof(header));
+    if (header.magic != kAssetRequestMagic || header.version != kAssetProtocolVersion || header.count > kMaxAssetBatch) {
+      return false;
+    }
+
+    size_t size = request_size(in, connection.in_offset);
+    if (size == 0) break;
+
+    std::vector<AssetRequest> requests(header.count);
+    memcpy(requests.data(), in.data() + connection.in_offset + sizeof(header), requests.size() * sizeof(AssetRequest));
+    connection.in_offset += size;
+
+    if (!handle(connection, header, requests.data())) {
+      return false;
+    }
+  }
+
+  // Drop the parsed bytes once in a while rather than after every request.
+  if (connection.in_offset == in.size()) {
+    in.clear();
+    connection.in_offset = 0;
+  } else if (connection.in_offset > kReceiveSize) {
+    in.erase(in.begin(), in.begin() + ptrdiff_t(connection.in_offset));
+    connection.in_offset = 0;
+  }
+
+  return true;
+}
+
+// serve answers the requests received and sends what the socket takes.
+// Returns false if the connection failed, or if the client is done and has
+// been sent everything.
+bool AssetServer::serve(Connection& connection) {
+  // Requests held back by a full queue are answered once the socket took
+  // everything queued before them.
+  do {
+    if (!parse(connection) || !flush(connection)) {
+      return false;
+    }
+  } while (connection.out.empty() && request_size(connection.in, connection.in_offset) > 0);
+
+  if (connection.eof && connection.out.empty()) {
+    return false;
+  }
+
+  watch(connection);
+  return true;
+}
+
+// handle queues the response to a request.
+bool AssetServer::handle(Connection& connection, const AssetRequestHeader& header, const AssetRequest* requests) {
+  TRACE_SCOPE("asset_request");
+
+  size_t head_size = sizeof(AssetResponseHeader) + size_t(header.count) * sizeof(AssetResponse);
+  auto& head = connection.heads.emplace_back(head_size);
+  auto responses = reinterpret_cast<AssetResponse*>(head.data() + sizeof(AssetResponseHeader));
+
+  // The header goes first, it is filled in once the payload size is known.
+  size_t head_iov = connection.out.size();
+  connection.out.push_back({});
+  uint64_t payload_size = 0;
+
+  for (size_t i = 0; i < header.count; ++i) {
+    auto& request = requests[i];
+    auto& response = responses[i];
+    response = {.type = request.type, .status = AssetStatus::Ok, .index = request.index};
+
+    const void* payload = nullptr;
+    size_t size = 0;
+
+    if (request.style >= m_styles.size()) {
+      response.status = AssetStatus::NoSuchStyle;
+    } else {
+      auto& style = *m_styles[request.style];
+      auto& cooked = style.cooked;
+
+      auto image = [&](std::span<const CookedImage> images) {
+        if (request.index >= images.size()) {
+          response.status = AssetStatus::NoSuchAsset;
+          return;
+        }
+        auto& image = images[request.index];
+        response.width = image.width;
+        response.height = image.height;
+        response.x = image.x;
+        response.y = image.y;
+        payload = cooked.pixels(image);
+        size = size_t(image.width) * image.height * sizeof(Color);
+      };
+
+      switch (request.type) {
+        case AssetType::Info:
+          payload = &style.info;
+          size = sizeof(style.info);
+          break;
+        case AssetType::Sprite: image(cooked.sprites()); break;
+        case AssetType::Tile: image(cooked.tiles()); break;
+        case AssetType::Delta: image(cooked.deltas()); break;
+        case AssetType::Palette:
+          if (request.index >= cooked.palettes().size()) {
+            response.status = AssetStatus::NoSuchAsset;
+          } else {
+            payload = &cooked.palettes()[request.index];
+            size = sizeof(PhysicalPalette);
+          }
+          break;
+        case AssetType::VirtualPalettes:
+          payload = cooked.virtual_palettes().data();
+          size = cooked.virtual_palettes().size_bytes();
+          break;
+        default:
+          response.status = AssetStatus::BadType;
+          break;
+      }
+    }
+
+    response.size = uint32_t(size);
+    payload_size += size;
+    connection.out_bytes += size;
+    if (size > 0) {
+      connection.out.push_back({const_cast<void*>(payload), size});
+    }
+  }
+
+  if (payload_size > UINT32_MAX) {
+    return false;
+  }
+
+  AssetResponseHeader response_header = {
+    .magic = kAssetResponseMagic,
+    .version = kAssetProtocolVersion,
+    .count = header.count,
+    .id = header.id,
+    .payload_size = uint32_t(payload_size),
+  };
+  memcpy(head.data(), &response_header, sizeof(response_header));
+  connection.out[head_iov] = {head.data(), head.size()};
+  connection.out_bytes += head.size();
+  return true;
+}
+
+// flush sends as much of the queued output as the socket takes. Returns
+// false if the connection failed.
+bool AssetServer::flush(Connection& connection) {
+  auto& out = connection.out;
+
+  while (connection.out_index < out.size()) {
+    msghdr message = { };
+    message.msg_iov = out.data() + connection.out_index;
+    message.msg_iovlen = std::min<size_t>(out.size() - connection.out_index, IOV_MAX);
+
+    ssize_t n = sendmsg(connection.fd, &message, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      if (errno != EAGAIN) return false;
+      break;
+    }
+
+    // Skip the fully sent iovecs, advance into a partially sent one.
+    size_t sent = size_t(n);
+    connection.out_bytes -= sent;
+    while (sent > 0) {
+      auto& iov = out[connection.out_index];
+      size_t step = std::min(sent, iov.iov_len);
+      iov.iov_base = static_cast<uint8_t*>(iov.iov_base) + step;
+      iov.iov_len -= step;
+      sent -= step;
+      if (iov.iov_len == 0) ++connection.out_index;
+    }
+  }
+
+  if (connection.out_index == out.size()) {
+    out.clear();
+    connection.heads.clear();
+    connection.out_index = 0;
+  }
+
+  return true;
+}
+
+// watch waits for room in the socket while output is pending, and for more
+// requests unless the client is done. Once the output queue is full it
+// isn't read from again until the queue drained.
+void AssetServer::watch(Connection& connection) {
+  bool writing = !connection.out.empty();
+  bool reading = !connection.eof && (connection.reading ? !output_full(connection.out, connection.out_bytes) : !writing);
+
+  if (reading != connection.reading || writing != connection.writing) {
+    epoll_event event = {.events = (reading ? uint32_t(EPOLLIN) : 0u) | (writing ? uint32_t(EPOLLOUT) : 0u), .data = {.fd = connection.fd}};
+    epoll_ctl(m_epoll, EPOLL_CTL_MOD, connection.fd, &event);
+    connection.reading = reading;
+    connection.writing = writing;
+  }
+}
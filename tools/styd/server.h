@@ -0,0 +1,76 @@
+#pragma once
+
+#include "cooked_styles.h"
+#include "protocol.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// AssetServer serves the cooked images and palettes of a set of styles over
+// a Unix domain socket, see protocol.h. Connections are multiplexed with
+// epoll on a single thread. Payloads are sent straight from the mapped
+// cooked caches, nothing is copied into the socket besides the headers.
+class AssetServer {
+  private:
+    struct Style {
+      CookedStyles cooked;
+      AssetInfo info;
+    };
+
+    struct Connection {
+      int fd = -1;
+      std::vector<uint8_t> in;   // received bytes not parsed yet
+      size_t in_offset = 0;
+
+      // Queued output, iovecs point into heads and the mapped caches.
+      std::vector<std::vector<uint8_t>> heads;
+      std::vector<iovec> out;
+      size_t out_index = 0;      // first iovec not fully sent
+      size_t out_bytes = 0;      // queued bytes not sent yet
+
+      bool reading = true;       // EPOLLIN is enabled
+      bool writing = false;      // EPOLLOUT is enabled
+      bool eof = false;          // the client won't send anything more
+    };
+
+    std::vector<std::unique_ptr<Style>> m_styles;
+    std::unordered_map<int, std::unique_ptr<Connection>> m_connections;
+    std::string m_socket_path;
+    int m_listen = -1;
+    int m_epoll = -1;
+    int m_wake = -1; // eventfd written by stop
+
+    void accept_connections();
+    void close_connection(Connection& connection);
+    bool receive(Connection& connection);
+    bool parse(Connection& connection);
+    bool serve(Connection& connection);
+    bool handle(Connection& connection, const AssetRequestHeader& header, const AssetRequest* requests);
+    bool flush(Connection& connection);
+    void watch(Connection& connection);
+
+  public:
+    AssetServer() = default;
+    AssetServer(const AssetServer&) = delete;
+    AssetServer& operator=(const AssetServer&) = delete;
+    ~AssetServer();
+
+    // add_style maps the cooked cache of a style file, cooking it first if
+    // needed, see load_cooked_styles. Styles are numbered in the order they
+    // are added.
+    StyleLoadStatus add_style(const char* filename, const char* cache_filename, const StyleImportOptions& import = {});
+    size_t style_count() const { return m_styles.size(); }
+
+    // listen binds the socket, replacing a stale socket file at path.
+    bool listen(const char* path);
+
+    // run serves connections until stop is called.
+    bool run();
+
+    // stop makes run return, it is safe to call from a signal handler.
+    void stop();
+};